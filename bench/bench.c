@@ -0,0 +1,2291 @@
+/*
+ * ---------------------------------------------------------------------------
+ *
+ * Act : Auto-Completion Tree -- Implmentation d'un arbre d'auto-compltion
+ * Copyright (c) 2004 Benjamin Gaillard
+ *
+ * ---------------------------------------------------------------------------
+ *
+ * Fichier     : bench.c
+ *
+ * Description : Programme de mesure des performances des modules d'Act.
+ *
+ * Commentaire : Lancer `bench' sans paramtre pour obtenir la liste des
+ *               mesures disponibles. Chaque mesure prend en paramtre un ou
+ *               plusieurs fichiers texte dont les mots servent de donnes.
+ *
+ * ---------------------------------------------------------------------------
+ *
+ * Ce programme est un logiciel libre ; vous pouvez le redistribuer et/ou le
+ * modifier conformment aux dispositions de la Licence Publique Gnrale GNU,
+ * telle que publie par la Free Software Foundation ; version 2 de la
+ * licence, ou encore ( votre convenance) toute version ultrieure.
+ *
+ * Ce programme est distribu dans l'espoir qu'il sera utile, mais SANS AUCUNE
+ * GARANTIE ; sans mme la garantie implicite de COMMERCIALISATION ou
+ * D'ADAPTATION  UN OBJET PARTICULIER. Pour plus de dtail, voir la Licence
+ * Publique Gnrale GNU.
+ *
+ * Vous devez avoir reu un exemplaire de la Licence Publique Gnrale GNU en
+ * mme temps que ce programme ; si ce n'est pas le cas, crivez  la Free
+ * Software Foundation Inc., 675 Mass Ave, Cambridge, MA 02139, tats-Unis.
+ *
+ * ---------------------------------------------------------------------------
+ */
+
+
+/* Options de compilation (pour clock_gettime()) */
+#define _POSIX_C_SOURCE 200112L
+
+/* En-ttes standard */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+/* En-ttes locaux */
+#include "bool.h"
+#include "alpha.h"
+#include "tstree.h"
+#include "dict.h"
+#include "shard.h"
+#include "huffman.h"
+#include "pool.h"
+
+
+/*****************************************************************************
+ *
+ * CONSTANTES
+ *
+ */
+
+/* Dure minimale d'une mesure en secondes */
+#define MIN_TIME 0.5
+
+/* Nombre de propositions demandes, comme dans l'interface graphique */
+#define NUM_WORDS 10
+
+/* Fichier temporaire utilis pour les mesures de compression */
+#define TEMP_FILE "bench.tmp.hdc"
+
+/* Taille minimale des donnes compresses par blocs (le fichier mesur est
+ * rpt jusqu' l'atteindre) et nombre maximal de threads essays */
+#define BLOCKS_SIZE    (32 << 20) /* 32 Mo */
+#define BLOCKS_THREADS 8
+
+/* Nombre d'ajouts de chaque mot et nombre maximal de threads essays lors
+ * des ajouts concurrents */
+#define FEED_REPEAT  4
+#define FEED_THREADS 8
+
+/* Nombre de threads lecteurs, de dures de recherche conserves par chacun
+ * et nombre maximal d'ajouts de l'crivain lors des lectures concurrentes */
+#define READ_THREADS 2
+#define READ_SAMPLES (1 << 18)
+#define READ_WRITES  2000
+
+/* Nombre de partitions du dictionnaire partitionn et nombre maximal de
+ * threads essays lors de son remplissage */
+#define SHARD_PARTS   16
+#define SHARD_THREADS 8
+
+/* Nombre maximal de threads essays lors du dcoupage d'une chane */
+#define CHUNKS_THREADS 8
+
+
+/*****************************************************************************
+ *
+ * TYPES DE DONNES
+ *
+ */
+
+/* Liste de mots extraits d'un fichier */
+typedef struct bench_words
+{
+    char         *buffer; /* Contenu du fichier */
+    char         **words; /* Mots               */
+    unsigned int count;   /* Nombre de mots     */
+}
+bench_words_s_t, *bench_words_t;
+
+/* Part des ajouts concurrents confie  un thread : les mots `first',
+ * `first + step'... de la liste rpte FEED_REPEAT fois */
+typedef struct bench_feed
+{
+    tstree_t     tree;    /* Arbre complt     */
+    char         **words; /* Mots  ajouter     */
+    unsigned int count;   /* Nombre de mots     */
+    unsigned int first;   /* Premier ajout      */
+    unsigned int step;    /* cart entre ajouts */
+    bool_t       ok;      /* Pas d'erreur       */
+}
+bench_feed_s_t, *bench_feed_t;
+
+/* Thread lecteur : recherches rptes des prfixes `first', `first + 1'...
+ * jusqu' l'arrt demand, sous le verrou `lock' s'il est donn */
+typedef struct bench_read
+{
+    dict_t          dict;   /* Dictionnaire consult         */
+    pthread_mutex_t *lock;  /* Verrou global (NULL : aucun)  */
+    char            **keys; /* Prfixes  rechercher         */
+    unsigned int    number; /* Nombre de prfixes            */
+    unsigned int    first;  /* Premier prfixe               */
+    bool_t          *stop;  /* Arrt demand                 */
+    double          *times; /* Dernires dures de recherche */
+    unsigned long   count;  /* Nombre de recherches          */
+}
+bench_read_s_t, *bench_read_t;
+
+/* Description d'une mesure */
+typedef struct bench_test
+{
+    const char *name;                          /* Nom        */
+    const char *description;                   /* Description */
+    bool_t     (*func)( const char *filename ); /* Fonction   */
+}
+bench_test_s_t;
+
+
+/*****************************************************************************
+ *
+ * PROTOTYPES DES FONCTIONS STATIQUES
+ *
+ */
+
+/* Outils */
+static double bench_time( void );
+static char   *bench_load_file( const char *filename, unsigned int *size );
+static bool_t bench_get_words( const char *filename, bench_words_t words );
+static void   bench_free_words( bench_words_t words );
+static void   bench_shuffle( char **words, unsigned int count );
+static int    bench_compare( const void *first, const void *second );
+static bool_t bench_token_callback( char *word, unsigned int length,
+				    void *data );
+static bool_t bench_count_callback( const tstree_node_t node,
+				    unsigned long *count );
+static char   **bench_get_prefixes( const bench_words_t words,
+				    unsigned int length,
+				    unsigned int *number );
+static void   bench_free_prefixes( char **prefixes, unsigned int number );
+static double bench_queries( const dict_t dict, char **prefixes,
+			     unsigned int number, unsigned int words );
+static double bench_searches( const tstree_t tree, char **words,
+			      unsigned int count );
+static double bench_walks( const tstree_t tree );
+static double bench_lookups( const tstree_t tree, char **keys,
+			     unsigned int count );
+static void   bench_feed( void *data );
+static bool_t bench_same_keys( const tstree_t first, const tstree_t second );
+static void   bench_read( void *data );
+static int    bench_compare_times( const void *first, const void *second );
+static bool_t bench_same_words( const dict_t dict, const dict_t other,
+				const shard_t shard, char **keys,
+				unsigned int number );
+static bool_t bench_read_phase( const char *label, dict_t dict,
+				pthread_mutex_t *lock, char **keys,
+				unsigned int number, char **words,
+				unsigned int count );
+static dict_t bench_dict_from_text( const char *text, unsigned int size );
+static bool_t bench_merge_case( const char *label, const char *text,
+				unsigned int size, const dict_t other,
+				char **keys, unsigned int number );
+static bool_t bench_codec( const char *buffer, unsigned int size,
+			   double *compress, double *decompress );
+
+/* Mesures */
+static bool_t bench_walk( const char *filename );
+static bool_t bench_build( const char *filename );
+static bool_t bench_rebalance( const char *filename );
+static bool_t bench_compact( const char *filename );
+static bool_t bench_direct( const char *filename );
+static bool_t bench_wide( const char *filename );
+static bool_t bench_concurrent( const char *filename );
+static bool_t bench_readers( const char *filename );
+static bool_t bench_shards( const char *filename );
+static bool_t bench_chunks( const char *filename );
+static bool_t bench_merge( const char *filename );
+static bool_t bench_tokens( const char *filename );
+static bool_t bench_topk( const char *filename );
+static bool_t bench_cache( const char *filename );
+static bool_t bench_huffman( const char *filename );
+static bool_t bench_blocks( const char *filename );
+
+
+/*****************************************************************************
+ *
+ * VARIABLES STATIQUES
+ *
+ */
+
+/* Liste des mesures disponibles */
+static const bench_test_s_t tests[] = {
+    { "walk", "parcours complet d'un arbre (entre trie et mlange)",
+      bench_walk },
+    { "build", "construction d'un arbre et recherche de chaque mot",
+      bench_build },
+    { "rebalance", "rquilibrage des frres selon la frquence des mots",
+      bench_rebalance },
+    { "compact", "parcours et recherches avant et aprs compactage",
+      bench_compact },
+    { "direct", "accs direct aux deux premiers niveaux de l'arbre",
+      bench_direct },
+    { "wide", "recherches selon le seuil des frres larges",
+      bench_wide },
+    { "concurrent", "ajouts concurrents selon le nombre de threads",
+      bench_concurrent },
+    { "readers", "latence des lecteurs pendant les ajouts d'un crivain",
+      bench_readers },
+    { "shards", "remplissage d'un dictionnaire partitionn selon les threads",
+      bench_shards },
+    { "chunks", "ajout des mots d'une chane selon le nombre de threads",
+      bench_chunks },
+    { "merge", "fusion d'un dictionnaire dans un autre",
+      bench_merge },
+    { "tokens", "dcoupage d'un texte en mots selon la mthode",
+      bench_tokens },
+    { "topk", "recherche des mots les plus frquents pour un prfixe",
+      bench_topk },
+    { "cache", "listes de propositions en cache selon leur profondeur",
+      bench_cache },
+    { "huffman", "compression et dcompression d'un fichier",
+      bench_huffman },
+    { "blocks", "compression par blocs selon le nombre de threads",
+      bench_blocks },
+    { NULL, NULL, NULL }
+};
+
+
+/*****************************************************************************
+ *
+ * FONCTION PRINCIPALE
+ *
+ */
+
+/**
+ * Fonction principale du programme, appele par le systme.
+ */
+int main( int argc, char **argv )
+{
+    /* Variables locales */
+    int          i;      /* Compteur de fichiers */
+    unsigned int j;      /* Compteur de mesures  */
+    bool_t       all;    /* Toutes les mesures   */
+    bool_t       found;  /* Mesure trouve       */
+    bool_t       result; /* Rsultat             */
+
+    /* Affichage de l'aide */
+    if (argc < 3) {
+	fprintf( stderr, "Utilisation : %s <mesure|all> <fichier>...\n"
+		 "Mesures disponibles :\n", argv[0] );
+	for (j = 0; tests[j].name; j++)
+	    fprintf( stderr, "    %-8s : %s\n", tests[j].name,
+		     tests[j].description );
+	return 1;
+    }
+
+    /* Excution des mesures demandes sur chaque fichier */
+    all    = strcmp( argv[1], "all" ) == 0;
+    found  = FALSE;
+    result = TRUE;
+
+    for (j = 0; tests[j].name; j++)
+	if (all || strcmp( argv[1], tests[j].name ) == 0) {
+	    found = TRUE;
+	    for (i = 2; i < argc; i++) {
+		printf( "=== %s : %s ===\n", tests[j].name, argv[i] );
+		if (!tests[j].func( argv[i] )) {
+		    fprintf( stderr, "chec de la mesure `%s' sur `%s' !\n",
+			     tests[j].name, argv[i] );
+		    result = FALSE;
+		}
+	    }
+	}
+
+    if (!found) {
+	fprintf( stderr, "Mesure inconnue : `%s'\n", argv[1] );
+	return 1;
+    }
+
+    /* Fin du programme */
+    return result ? 0 : 1;
+}
+
+
+/*****************************************************************************
+ *
+ * OUTILS
+ *
+ */
+
+/**
+ * Retourne le temps coul en secondes depuis une origine arbitraire.
+ */
+static double bench_time( void )
+{
+    /* Variables locales */
+    struct timespec now; /* Temps courant */
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/**
+ * Charge un fichier entier en mmoire, termin par un zro.
+ */
+static char *bench_load_file( const char *filename, unsigned int *size )
+{
+    /* Variables locales */
+    FILE *file;   /* Fichier          */
+    long length;  /* Taille du fichier */
+    char *buffer; /* Contenu          */
+
+    /* Ouverture du fichier et calcul de sa taille */
+    if (!(file = fopen( filename, "rb" )))
+	return NULL;
+    if (fseek( file, 0, SEEK_END ) != 0 || (length = ftell( file )) < 0 ||
+	fseek( file, 0, SEEK_SET ) != 0) {
+	fclose( file );
+	return NULL;
+    }
+
+    /* Lecture du contenu */
+    if ((buffer = malloc( length + 1 ))) {
+	if (fread( buffer, 1, length, file ) == (size_t) length) {
+	    buffer[length] = '\0';
+	    if (size)
+		*size = (unsigned int) length;
+	} else {
+	    free( buffer );
+	    buffer = NULL;
+	}
+    }
+
+    fclose( file );
+    return buffer;
+}
+
+/**
+ * Extrait les mots (d'au moins deux lettres, en minuscules) d'un fichier.
+ */
+static bool_t bench_get_words( const char *filename, bench_words_t words )
+{
+    /* Variables locales */
+    char         *pos;  /* Position dans le tampon */
+    char         *end;  /* Fin du mot courant      */
+    unsigned int size;  /* Taille du fichier       */
+
+    /* Chargement du fichier */
+    if (!(words->buffer = bench_load_file( filename, &size )))
+	return FALSE;
+
+    /* Il y a au plus un mot pour deux caractres */
+    if (!(words->words = malloc( (size / 2 + 1) * sizeof (char *) ))) {
+	free( words->buffer );
+	return FALSE;
+    }
+
+    /* Dcoupage en mots */
+    words->count = 0;
+    for (pos = words->buffer; *pos != '\0'; pos = end) {
+	if (!IS_ALPHA( *pos )) {
+	    end = pos + 1;
+	    continue;
+	}
+
+	for (end = pos; IS_ALPHA( *end ); end++)
+	    if (IS_UPPER_CASE( *end ))
+		*end = UPPER_TO_LOWER_CASE( *end );
+
+	if (end > pos + 1)
+	    words->words[words->count++] = pos;
+	if (*end != '\0')
+	    *(end++) = '\0';
+    }
+
+    /* Pas d'erreur */
+    return TRUE;
+}
+
+/**
+ * Libre une liste de mots.
+ */
+static void bench_free_words( bench_words_t words )
+{
+    free( words->words );
+    free( words->buffer );
+}
+
+/**
+ * Mlange une liste de mots (de faon reproductible).
+ */
+static void bench_shuffle( char **words, unsigned int count )
+{
+    /* Variables locales */
+    unsigned int i, j; /* Compteurs           */
+    char         *tmp; /* Pour la permutation */
+
+    srand( 1 );
+    for (i = count; i > 1; i--) {
+	j = (unsigned int) rand() % i;
+	tmp = words[i - 1];
+	words[i - 1] = words[j];
+	words[j] = tmp;
+    }
+}
+
+/**
+ * Compare deux mots pour le tri, dans l'ordre de l'arbre (caractres de
+ * type char, prfixe avant les mots qui le prolongent).
+ */
+static int bench_compare( const void *first, const void *second )
+{
+    /* Variables locales */
+    const char *a = *(char *const *) first;  /* Premier mot */
+    const char *b = *(char *const *) second; /* Second mot  */
+
+    while (*a != '\0' && *a == *b) {
+	a++;
+	b++;
+    }
+
+    if (*a == *b)
+	return 0;
+    if (*a == '\0' || *b == '\0')
+	return *a == '\0' ? -1 : 1;
+    return *a < *b ? -1 : 1;
+}
+
+/**
+ * Callback comptant les mots trouvs par alpha_split() et leurs lettres.
+ */
+static bool_t bench_token_callback( char *word, unsigned int length,
+				    void *data )
+{
+    (void) word;
+    ((unsigned long *) data)[0]++;
+    ((unsigned long *) data)[1] += length;
+    return TRUE;
+}
+
+/**
+ * Callback comptant les cls parcourues.
+ */
+static bool_t bench_count_callback( const tstree_node_t node,
+				    unsigned long *count )
+{
+    (void) node;
+    (*count)++;
+    return TRUE;
+}
+
+
+/**
+ * Construit la liste des diffrents prfixes d'une longueur donne des mots
+ * d'une liste.
+ */
+static char **bench_get_prefixes( const bench_words_t words,
+				  unsigned int length, unsigned int *number )
+{
+    /* Variables locales */
+    unsigned int    i;          /* Compteur                 */
+    char            prefix[8];  /* Prfixe                  */
+    char            **result;   /* Prfixes trouvs         */
+    bool_t          ok;         /* Pas d'erreur             */
+    tstree_t        prefixes;   /* Ensemble des prfixes    */
+    tstree_cursor_t cursor;     /* Curseur sur les prfixes */
+    tstree_node_t   node;       /* Prfixe courant          */
+
+    /* Ensemble des prfixes de la longueur voulue */
+    if (length >= sizeof (prefix) || !(prefixes = tstree_new()))
+	return NULL;
+
+    ok = TRUE;
+    for (i = 0; ok && i < words->count; i++)
+	if (strlen( words->words[i] ) >= length) {
+	    memcpy( prefix, words->words[i], length );
+	    prefix[length] = '\0';
+	    ok = tstree_add_key( prefixes, prefix ) != NULL;
+	}
+
+    /* Extraction des prfixes */
+    result = NULL;
+    if (ok && (result = malloc( (tstree_get_key_number( prefixes ) + 1) *
+				sizeof (char *) )) &&
+	(cursor = tstree_cursor_new( prefixes, NULL ))) {
+	*number = 0;
+	while ((node = tstree_cursor_next( cursor )))
+	    result[(*number)++] = tstree_node_get_key( node );
+	tstree_cursor_delete( cursor );
+    } else {
+	free( result );
+	result = NULL;
+    }
+
+    tstree_delete( prefixes );
+    return result;
+}
+
+/**
+ * Libre une liste de prfixes.
+ */
+static void bench_free_prefixes( char **prefixes, unsigned int number )
+{
+    /* Variables locales */
+    unsigned int i; /* Compteur */
+
+    for (i = 0; i < number; i++)
+	free( prefixes[i] );
+    free( prefixes );
+}
+
+/**
+ * Recherche les `words' mots les plus frquents (tous si `words' est nul) de
+ * chaque prfixe d'une liste pendant au moins MIN_TIME secondes et retourne
+ * la dure moyenne d'une recherche en microsecondes.
+ */
+static double bench_queries( const dict_t dict, char **prefixes,
+			     unsigned int number, unsigned int words )
+{
+    /* Variables locales */
+    unsigned int  i;       /* Compteur             */
+    unsigned long queries; /* Nombre de recherches */
+    double        start;   /* Dbut de la mesure   */
+    double        time;    /* Dure de la mesure   */
+    char          **result; /* Rsultat            */
+
+    queries = 0;
+    time    = 0.0;
+    start   = bench_time();
+    do {
+	for (i = 0; i < number; i++) {
+	    if ((result = dict_get_most_used( dict, prefixes[i], words )))
+		free( result );
+	    queries++;
+	}
+    } while ((time = bench_time() - start) < MIN_TIME);
+
+    return queries ? time * 1e6 / queries : 0.0;
+}
+
+
+/*****************************************************************************
+ *
+ * MESURES
+ *
+ */
+
+/**
+ * Mesure le dbit du parcours complet d'un arbre construit  partir de mots
+ * tris (frres dgnrs en listes) puis mlangs.
+ */
+static bool_t bench_walk( const char *filename )
+{
+    /* Variables locales */
+    unsigned int    i;      /* Compteur                */
+    unsigned int    order;  /* Ordre d'insertion       */
+    tstree_t        tree;   /* Arbre                   */
+    bench_words_s_t words;  /* Mots du fichier         */
+
+    /* Lecture des mots */
+    if (!bench_get_words( filename, &words ))
+	return FALSE;
+
+    for (order = 0; order < 2; order++) {
+	/* Tri ou mlange des mots */
+	if (order == 0)
+	    qsort( words.words, words.count, sizeof (char *), bench_compare );
+	else
+	    bench_shuffle( words.words, words.count );
+
+	/* Construction de l'arbre */
+	if (!(tree = tstree_new())) {
+	    bench_free_words( &words );
+	    return FALSE;
+	}
+	for (i = 0; i < words.count; i++)
+	    if (!tstree_add_key( tree, words.words[i] )) {
+		tstree_delete( tree );
+		bench_free_words( &words );
+		return FALSE;
+	    }
+
+	/* Parcours rpts */
+	printf( "%-9s : %u noeuds, %u cls, %.1f Mnoeuds/s\n",
+		order == 0 ? "tri" : "mlang",
+		tstree_get_node_number( tree ), tstree_get_key_number( tree ),
+		bench_walks( tree ) );
+
+	tstree_delete( tree );
+    }
+
+    /* Libration de la mmoire */
+    bench_free_words( &words );
+    return TRUE;
+}
+
+/**
+ * Compare la construction d'un arbre par ajout des mots un par un (tris
+ * puis mlangs) et  partir des mots tris (frres coups au mdian, puis
+ * selon les frquences), ainsi que le temps de recherche de chaque mot.
+ */
+static bool_t bench_build( const char *filename )
+{
+    /* Variables locales */
+    unsigned int    i;         /* Compteur                  */
+    unsigned int    method;    /* Mthode de construction   */
+    unsigned long   builds;    /* Nombre de constructions   */
+    double          start;     /* Dbut de la mesure        */
+    double          time[2];   /* Dures des mesures        */
+    char            **sorted;  /* Mots tris                */
+    bool_t          ok;        /* Pas d'erreur              */
+    tstree_t        tree;      /* Arbre                     */
+    bench_words_s_t words;     /* Mots du fichier (mlangs) */
+    static const char *const methods[] = {
+	"ajouts tris", "ajouts mlangs", "mdian", "frquences"
+    };
+
+    /* Lecture des mots, tris et mlangs */
+    if (!bench_get_words( filename, &words ))
+	return FALSE;
+    if (!(sorted = malloc( (words.count + 1) * sizeof (char *) ))) {
+	bench_free_words( &words );
+	return FALSE;
+    }
+    memcpy( sorted, words.words, words.count * sizeof (char *) );
+    qsort( sorted, words.count, sizeof (char *), bench_compare );
+    bench_shuffle( words.words, words.count );
+
+    ok = TRUE;
+    for (method = 0; ok && method < 4; method++) {
+	/* Constructions rptes */
+	builds   = 0;
+	time[0]  = 0.0;
+	start    = bench_time();
+	tree     = NULL;
+	do {
+	    if (tree)
+		tstree_delete( tree );
+	    if (!(tree = tstree_new())) {
+		ok = FALSE;
+		break;
+	    }
+	    if (method >= 2)
+		ok = tstree_build_from_sorted( tree, sorted, NULL,
+					       words.count, method == 3 );
+	    else
+		for (i = 0; ok && i < words.count; i++)
+		    ok = tstree_add_key( tree, method == 0 ? sorted[i] :
+					 words.words[i] ) != NULL;
+	    builds++;
+	} while (ok && (time[0] = bench_time() - start) < MIN_TIME);
+	if (!ok)
+	    break;
+
+	/* Recherches de chaque mot, dans un ordre alatoire */
+	if ((time[1] = bench_searches( tree, words.words,
+				       words.count )) < 0.0)
+	    ok = FALSE;
+	else
+	    printf( "%-15s : %u noeuds, %.2f ms/construction, "
+		    "%.1f ns/recherche\n", methods[method],
+		    tstree_get_node_number( tree ), time[0] * 1e3 / builds,
+		    time[1] );
+
+	tstree_delete( tree );
+    }
+
+    /* Libration de la mmoire */
+    free( sorted );
+    bench_free_words( &words );
+    return ok;
+}
+
+/**
+ * Compare, pour un arbre construit  partir de mots tris puis mlangs,
+ * le nombre de comparaisons entre frres et le temps de recherche de chaque
+ * mot du texte (les plus frquents tant les plus recherchs) avant et
+ * aprs rquilibrage.
+ */
+static bool_t bench_rebalance( const char *filename )
+{
+    /* Variables locales */
+    unsigned int    i;        /* Compteur                 */
+    unsigned int    order;    /* Ordre d'insertion        */
+    unsigned int    step;     /* Avant ou aprs           */
+    unsigned int    maximum;  /* Comparaisons maximales   */
+    double          average;  /* Comparaisons moyennes    */
+    double          time;     /* Dure du rquilibrage   */
+    double          search;   /* Dure d'une recherche    */
+    char            **sorted; /* Mots tris               */
+    bool_t          ok;       /* Pas d'erreur             */
+    tstree_t        tree;     /* Arbre                    */
+    bench_words_s_t words;    /* Mots du fichier          */
+
+    /* Lecture des mots, tris et mlangs */
+    if (!bench_get_words( filename, &words ))
+	return FALSE;
+    if (!(sorted = malloc( (words.count + 1) * sizeof (char *) ))) {
+	bench_free_words( &words );
+	return FALSE;
+    }
+    memcpy( sorted, words.words, words.count * sizeof (char *) );
+    qsort( sorted, words.count, sizeof (char *), bench_compare );
+    bench_shuffle( words.words, words.count );
+
+    ok = TRUE;
+    for (order = 0; ok && order < 2; order++) {
+	/* Construction de l'arbre par ajouts successifs */
+	if (!(tree = tstree_new())) {
+	    ok = FALSE;
+	    break;
+	}
+	for (i = 0; ok && i < words.count; i++)
+	    ok = tstree_add_key( tree, order == 0 ? sorted[i] :
+				 words.words[i] ) != NULL;
+
+	/* Mesures avant puis aprs rquilibrage */
+	time = 0.0;
+	for (step = 0; ok && step < 2; step++) {
+	    if (step == 1) {
+		time = bench_time();
+		ok   = tstree_rebalance( tree );
+		time = bench_time() - time;
+	    }
+	    if (!ok || !tstree_get_balance( tree, &average, &maximum ) ||
+		(search = bench_searches( tree, words.words,
+					  words.count )) < 0.0) {
+		ok = FALSE;
+		break;
+	    }
+
+	    if (step == 0)
+		printf( "%-7s, avant     : ", order == 0 ? "tri" : "mlang" );
+	    else
+		printf( "%-7s, %6.2f ms : ", order == 0 ? "tri" : "mlang",
+			time * 1e3 );
+	    printf( "%.2f comparaisons en moyenne, %u au plus, "
+		    "%.1f ns/recherche\n", average, maximum, search );
+	}
+
+	tstree_delete( tree );
+    }
+
+    /* Libration de la mmoire */
+    free( sorted );
+    bench_free_words( &words );
+    return ok;
+}
+
+/**
+ * Compare, pour un arbre construit  partir de mots mlangs, le dbit des
+ * parcours complets et le temps de recherche de chaque mot avant et aprs
+ * compactage, puis aprs rquilibrage et compactage.
+ */
+static bool_t bench_compact( const char *filename )
+{
+    /* Variables locales */
+    unsigned int    i;      /* Compteur                  */
+    unsigned int    step;   /* tape                     */
+    double          time;   /* Dure de la rorganisation */
+    double          walk;   /* Dbit des parcours        */
+    double          search; /* Dure d'une recherche     */
+    bool_t          ok;     /* Pas d'erreur              */
+    tstree_t        tree;   /* Arbre                     */
+    bench_words_s_t words;  /* Mots du fichier           */
+    static const char *const steps[] = {
+	"avant", "compact", "rquilibr et compact"
+    };
+
+    /* Lecture des mots et construction de l'arbre */
+    if (!bench_get_words( filename, &words ))
+	return FALSE;
+    bench_shuffle( words.words, words.count );
+    if (!(tree = tstree_new())) {
+	bench_free_words( &words );
+	return FALSE;
+    }
+    ok = TRUE;
+    for (i = 0; ok && i < words.count; i++)
+	ok = tstree_add_key( tree, words.words[i] ) != NULL;
+
+    /* Mesures aprs chaque tape */
+    for (step = 0; ok && step < 3; step++) {
+	time = bench_time();
+	if (step == 2)
+	    ok = tstree_rebalance( tree );
+	if (ok && step != 0)
+	    ok = tstree_compact( tree );
+	time = bench_time() - time;
+
+	if (!ok || (walk = bench_walks( tree )) < 0.0 ||
+	    (search = bench_searches( tree, words.words,
+				      words.count )) < 0.0) {
+	    ok = FALSE;
+	    break;
+	}
+	printf( "%-23s : %6.2f ms, %.1f Mnoeuds/s, %.1f ns/recherche\n",
+		steps[step], time * 1e3, walk, search );
+    }
+
+    /* Libration de la mmoire */
+    tstree_delete( tree );
+    bench_free_words( &words );
+    return ok;
+}
+
+/**
+ * Compare, avec et sans les tables d'accs direct aux deux premiers niveaux
+ * de l'arbre, le temps de recherche des mots les plus frquents (listes en
+ * cache) pour les prfixes d'une  trois lettres puis pour chaque mot, et
+ * indique la mmoire occupe par les tables.
+ */
+static bool_t bench_direct( const char *filename )
+{
+    /* Variables locales */
+    unsigned int    i;         /* Compteur                       */
+    unsigned int    length;    /* Longueur des prfixes          */
+    unsigned int    number[3]; /* Nombre de prfixes             */
+    unsigned long   tables;    /* Mmoire occupe par les tables */
+    unsigned long   used;      /* Mmoire occupe par l'arbre    */
+    double          time[2];   /* Dures avec et sans les tables */
+    char            **keys[3]; /* Prfixes  rechercher          */
+    bool_t          ok;        /* Pas d'erreur                   */
+    tstree_t        tree;      /* Arbre                          */
+    bench_words_s_t words;     /* Mots du fichier                */
+
+    /* Lecture des mots et des prfixes */
+    if (!bench_get_words( filename, &words ))
+	return FALSE;
+
+    ok = TRUE;
+    for (length = 1; length <= 3; length++) {
+	keys[length - 1] = ok ? bench_get_prefixes( &words, length,
+						    number + length - 1 )
+	    : NULL;
+	ok = keys[length - 1] != NULL;
+    }
+
+    /* Construction de l'arbre, avec les listes en cache de l'interface ; les
+     * tables sont seules  occuper de la mmoire tant qu'il est vide */
+    bench_shuffle( words.words, words.count );
+    if (ok && (ok = (tree = tstree_new()) != NULL)) {
+	tstree_get_memory_usage( tree, NULL, &tables );
+	ok = tstree_set_cache( tree, NUM_WORDS, 0 );
+	for (i = 0; ok && i < words.count; i++)
+	    ok = tstree_add_key( tree, words.words[i] ) != NULL;
+
+	/* Reconstruction des listes avant les mesures */
+	tstree_get_memory_usage( tree, NULL, &used );
+	if (ok)
+	    bench_lookups( tree, keys[0], 1 );
+	if (ok)
+	    printf( "tables : %.1f Kio, soit %.2f %% de l'arbre (%.1f Mio)\n",
+		    tables / 1024.0, tables * 100.0 / used,
+		    used / 1048576.0 );
+
+	/* Recherches avec puis sans les tables */
+	for (length = 1; ok && length <= 4; length++) {
+	    for (i = 0; i < 2; i++) {
+		tstree_set_direct( tree, i == 0 );
+		time[i] = length <= 3 ?
+		    bench_lookups( tree, keys[length - 1],
+				   number[length - 1] ) :
+		    bench_lookups( tree, words.words, words.count );
+	    }
+	    if (length <= 3)
+		printf( "%u lettre%s : %u prfixes, ", length,
+			length > 1 ? "s" : "", number[length - 1] );
+	    else
+		printf( "mots entiers : %u mots, ", words.count );
+	    printf( "%.1f ns/recherche avec les tables, %.1f ns sans\n",
+		    time[0], time[1] );
+	}
+
+	tstree_delete( tree );
+    }
+
+    /* Libration de la mmoire */
+    for (length = 1; length <= 3; length++)
+	if (keys[length - 1])
+	    bench_free_prefixes( keys[length - 1], number[length - 1] );
+    bench_free_words( &words );
+    return ok;
+}
+
+/**
+ * Compare, pour plusieurs seuils de doublement des ensembles de frres par
+ * des frres larges (aucun, puis de plus en plus grands), la mmoire
+ * occupe par ceux-ci et le temps de recherche des mots les plus frquents
+ * (listes en cache) pour les prfixes d'une  trois lettres puis pour
+ * chaque mot.
+ */
+static bool_t bench_wide( const char *filename )
+{
+    /* Variables locales */
+    unsigned int    i;         /* Compteur                     */
+    unsigned int    mode;      /* Seuil mesur                 */
+    unsigned int    length;    /* Longueur des prfixes        */
+    unsigned int    number[3]; /* Nombre de prfixes           */
+    unsigned long   base;      /* Mmoire sans frres larges   */
+    unsigned long   used;      /* Mmoire occupe par l'arbre  */
+    double          time;      /* Dure d'une recherche        */
+    char            **keys[3]; /* Prfixes  rechercher        */
+    bool_t          ok;        /* Pas d'erreur                 */
+    tstree_t        tree;      /* Arbre                        */
+    bench_words_s_t words;     /* Mots du fichier              */
+    static const unsigned int thresholds[] = { 0, 4, 8, 16, 32 };
+
+    /* Lecture des mots et des prfixes */
+    if (!bench_get_words( filename, &words ))
+	return FALSE;
+
+    ok = TRUE;
+    for (length = 1; length <= 3; length++) {
+	keys[length - 1] = ok ? bench_get_prefixes( &words, length,
+						    number + length - 1 )
+	    : NULL;
+	ok = keys[length - 1] != NULL;
+    }
+
+    /* Construction de l'arbre, avec les listes en cache de l'interface */
+    bench_shuffle( words.words, words.count );
+    if (ok && (ok = (tree = tstree_new()) != NULL)) {
+	ok = tstree_set_cache( tree, NUM_WORDS, 0 );
+	for (i = 0; ok && i < words.count; i++)
+	    ok = tstree_add_key( tree, words.words[i] ) != NULL;
+	if (ok)
+	    bench_lookups( tree, keys[0], 1 );
+
+	base = 0;
+	for (mode = 0; ok && mode < sizeof (thresholds) /
+		 sizeof (*thresholds); mode++) {
+	    if (!(ok = tstree_set_wide( tree, thresholds[mode] )))
+		break;
+
+	    tstree_get_memory_usage( tree, NULL, &used );
+	    if (mode == 0) {
+		base = used;
+		printf( "sans frres larges :\n" );
+	    } else
+		printf( "seuil %u : %.1f Kio\n", thresholds[mode],
+			(used - base) / 1024.0 );
+
+	    /* Recherches */
+	    for (length = 1; length <= 4; length++) {
+		time = length <= 3 ?
+		    bench_lookups( tree, keys[length - 1],
+				   number[length - 1] ) :
+		    bench_lookups( tree, words.words, words.count );
+		if (length <= 3)
+		    printf( "    %u lettre%s : %u prfixes, ", length,
+			    length > 1 ? "s" : "", number[length - 1] );
+		else
+		    printf( "    mots entiers : %u mots, ", words.count );
+		printf( "%.1f ns/recherche\n", time );
+	    }
+	}
+
+	tstree_delete( tree );
+    }
+
+    /* Libration de la mmoire */
+    for (length = 1; length <= 3; length++)
+	if (keys[length - 1])
+	    bench_free_prefixes( keys[length - 1], number[length - 1] );
+    bench_free_words( &words );
+    return ok;
+}
+
+/**
+ * Ajoute FEED_REPEAT fois chaque mot  un arbre, d'abord squentiellement
+ * puis en mode d'ajouts concurrents avec 1, 2, 4... threads qui se
+ * partagent les mots en les entrelaant, et compare les dbits ; chaque
+ * arbre obtenu doit contenir les mmes cls avec les mmes frquences que
+ * celui construit squentiellement.
+ */
+static bool_t bench_concurrent( const char *filename )
+{
+    /* Variables locales */
+    unsigned int    i;                   /* Compteur                  */
+    unsigned int    threads;             /* Nombre de threads         */
+    unsigned int    total;               /* Nombre d'ajouts           */
+    double          start;               /* Dbut de la mesure        */
+    double          time;                /* Dure de la mesure        */
+    double          base;                /* Dbit avec un seul thread */
+    bool_t          ok;                  /* Pas d'erreur              */
+    tstree_t        reference;           /* Arbre de rfrence        */
+    tstree_t        tree;                /* Arbre construit en commun */
+    pool_t          pool;                /* Groupe de threads         */
+    bench_words_s_t words;               /* Mots du fichier           */
+    pool_task_s_t   tasks[FEED_THREADS]; /* Tches des threads        */
+    bench_feed_s_t  feeds[FEED_THREADS]; /* Parts des threads         */
+
+    /* Lecture des mots */
+    if (!bench_get_words( filename, &words ))
+	return FALSE;
+    bench_shuffle( words.words, words.count );
+    total = words.count * FEED_REPEAT;
+
+    /* Construction squentielle de l'arbre de rfrence */
+    if (!(reference = tstree_new())) {
+	bench_free_words( &words );
+	return FALSE;
+    }
+    ok    = TRUE;
+    start = bench_time();
+    for (i = 0; ok && i < total; i++)
+	ok = tstree_add_key( reference, words.words[i % words.count] ) !=
+	    NULL;
+    time = bench_time() - start;
+    if (ok)
+	printf( "squentiel  : %u ajouts, %.2f Majouts/s\n", total,
+		total / time / 1e6 );
+
+    /* Ajouts concurrents avec 1, 2, 4... threads */
+    base = 0.0;
+    for (threads = 1; ok && threads <= FEED_THREADS; threads *= 2) {
+	if (!(pool = pool_new( threads ))) {
+	    ok = FALSE;
+	    break;
+	}
+	if (!(tree = tstree_new()) || !tstree_begin_concurrent( tree )) {
+	    if (tree)
+		tstree_delete( tree );
+	    pool_delete( pool );
+	    ok = FALSE;
+	    break;
+	}
+
+	start = bench_time();
+	for (i = 0; i < threads; i++) {
+	    feeds[i].tree  = tree;
+	    feeds[i].words = words.words;
+	    feeds[i].count = words.count;
+	    feeds[i].first = i;
+	    feeds[i].step  = threads;
+	    pool_submit( pool, tasks + i, bench_feed, feeds + i );
+	}
+	for (i = 0; i < threads; i++) {
+	    pool_wait( pool, tasks + i );
+	    ok = ok && feeds[i].ok;
+	}
+	tstree_end_concurrent( tree );
+	time = bench_time() - start;
+
+	/* Vrification de l'arbre obtenu */
+	if (ok && !bench_same_keys( reference, tree )) {
+	    printf( "%u thread(s) : arbre diffrent de la rfrence\n",
+		    threads );
+	    ok = FALSE;
+	}
+	if (ok) {
+	    if (threads == 1)
+		base = total / time;
+	    printf( "%u thread(s) : %.2f Majouts/s (x%.2f)\n", threads,
+		    total / time / 1e6, total / time / base );
+	}
+
+	tstree_delete( tree );
+	pool_delete( pool );
+    }
+
+    /* Libration de la mmoire */
+    tstree_delete( reference );
+    bench_free_words( &words );
+    return ok;
+}
+
+/**
+ * Mesure la latence des recherches de READ_THREADS lecteurs sur un
+ * dictionnaire construit  partir de la premire moiti des mots, seuls puis
+ * pendant qu'un crivain ajoute jusqu' READ_WRITES mots de la seconde
+ * moiti, en lecture concurrente puis sous un verrou global.
+ */
+static bool_t bench_readers( const char *filename )
+{
+    /* Variables locales */
+    unsigned int    i;        /* Compteur                         */
+    unsigned int    half;     /* Mots du dictionnaire de dpart   */
+    unsigned int    writes;   /* Nombre d'ajouts de l'crivain    */
+    unsigned int    number;   /* Nombre de prfixes               */
+    char            **keys;   /* Prfixes  rechercher            */
+    bool_t          ok;       /* Pas d'erreur                     */
+    dict_t          dicts[2]; /* Dictionnaires (lecture, verrou)  */
+    pthread_mutex_t lock;     /* Verrou global                    */
+    bench_words_s_t words;    /* Mots du fichier                  */
+
+    /* Lecture des mots et des prfixes de deux lettres */
+    if (!bench_get_words( filename, &words ))
+	return FALSE;
+    bench_shuffle( words.words, words.count );
+    half   = words.count / 2;
+    writes = words.count - half < READ_WRITES ? words.count - half :
+	READ_WRITES;
+    if (!(keys = bench_get_prefixes( &words, 2, &number ))) {
+	bench_free_words( &words );
+	return FALSE;
+    }
+
+    /* Construction des dictionnaires de dpart */
+    ok = (dicts[0] = dict_new()) != NULL;
+    ok = ok && (dicts[1] = dict_new()) != NULL;
+    for (i = 0; ok && i < half; i++)
+	ok = dict_add( dicts[0], words.words[i] ) &&
+	    dict_add( dicts[1], words.words[i] );
+    ok = ok && dict_begin_readers( dicts[0] );
+    ok = ok && pthread_mutex_init( &lock, NULL ) == 0;
+
+    /* Lecteurs seuls puis avec l'crivain, sans puis avec le verrou */
+    if (ok) {
+	ok = bench_read_phase( "lecteurs seuls", dicts[0], NULL, keys,
+			       number, NULL, 0 ) &&
+	    bench_read_phase( "avec crivain ", dicts[0], NULL, keys, number,
+			      words.words + half, writes ) &&
+	    bench_read_phase( "verrou global ", dicts[1], &lock, keys,
+			      number, words.words + half, writes );
+	pthread_mutex_destroy( &lock );
+    }
+
+    /* Libration de la mmoire */
+    if (dicts[0])
+	dict_delete( dicts[0] );
+    if (dicts[1])
+	dict_delete( dicts[1] );
+    bench_free_prefixes( keys, number );
+    bench_free_words( &words );
+    return ok;
+}
+
+/**
+ * Compare le remplissage d'un dictionnaire depuis le contenu d'un fichier 
+ * celui d'un dictionnaire de SHARD_PARTS partitions avec 1, 2, 4... threads,
+ * dont les mots sont ensuite compars  ceux du premier.
+ */
+static bool_t bench_shards( const char *filename )
+{
+    /* Variables locales */
+    unsigned int    size;    /* Taille du fichier          */
+    unsigned int    runs;    /* Nombre de remplissages     */
+    unsigned int    threads; /* Nombre de threads          */
+    unsigned int    number;  /* Nombre de prfixes         */
+    double          start;   /* Dbut d'un remplissage     */
+    double          time;    /* Dure des remplissages     */
+    double          base;    /* Dbit avec un seul thread  */
+    char            *buffer; /* Contenu du fichier         */
+    char            *copy;   /* Copie modifie par l'ajout */
+    char            **keys;  /* Prfixes d'une lettre      */
+    bool_t          ok;      /* Pas d'erreur               */
+    dict_t          dict;    /* Dictionnaire de rfrence  */
+    shard_t         shard;   /* Dictionnaire partitionn   */
+    bench_words_s_t words;   /* Mots du fichier            */
+
+    /* Lecture du fichier et des prfixes d'une lettre */
+    if (!(buffer = bench_load_file( filename, &size )))
+	return FALSE;
+    if (!(copy = malloc( size + 1 ))) {
+	free( buffer );
+	return FALSE;
+    }
+    keys = NULL;
+    ok   = bench_get_words( filename, &words );
+    if (ok) {
+	keys = bench_get_prefixes( &words, 1, &number );
+	bench_free_words( &words );
+	ok = keys != NULL;
+    }
+
+    /* Dictionnaire de rfrence */
+    dict = NULL;
+    runs = 0;
+    time = 0.0;
+    while (ok && time < MIN_TIME) {
+	if (dict)
+	    dict_delete( dict );
+	memcpy( copy, buffer, size + 1 );
+	if (!(ok = (dict = dict_new()) != NULL))
+	    break;
+	start = bench_time();
+	ok    = dict_add_words_from_string( dict, copy );
+	time += bench_time() - start;
+	runs++;
+    }
+    if (ok)
+	printf( "dictionnaire : %.1f Mo/s\n", size * runs / time / 1e6 );
+
+    /* Dictionnaires partitionns remplis par 1, 2, 4... threads */
+    base = 0.0;
+    for (threads = 1; ok && threads <= SHARD_THREADS; threads *= 2) {
+	shard = NULL;
+	runs  = 0;
+	time  = 0.0;
+	while (ok && time < MIN_TIME) {
+	    if (shard)
+		shard_delete( shard );
+	    memcpy( copy, buffer, size + 1 );
+	    if (!(ok = (shard = shard_new( SHARD_PARTS )) != NULL))
+		break;
+	    shard_set_thread_number( shard, threads );
+	    start = bench_time();
+	    ok    = shard_add_words_from_string( shard, copy );
+	    time += bench_time() - start;
+	    runs++;
+	}
+
+	/* Vrification des mots obtenus */
+	if (ok && !bench_same_words( dict, NULL, shard, keys, number )) {
+	    printf( "%u thread(s)  : mots diffrents de la rfrence\n",
+		    threads );
+	    ok = FALSE;
+	}
+	if (ok) {
+	    if (threads == 1)
+		base = size * runs / time;
+	    printf( "%u thread(s)  : %.1f Mo/s (x%.2f)\n", threads,
+		    size * runs / time / 1e6, size * runs / time / base );
+	}
+	if (shard)
+	    shard_delete( shard );
+    }
+
+    /* Libration de la mmoire */
+    if (dict)
+	dict_delete( dict );
+    if (keys)
+	bench_free_prefixes( keys, number );
+    free( copy );
+    free( buffer );
+    return ok;
+}
+
+/**
+ * Mesure le dbit de l'ajout des mots du contenu d'un fichier  un
+ * dictionnaire, la chane tant dcoupe entre 1, 2, 4... threads, et
+ * compare les mots obtenus  ceux de l'ajout par un seul thread.
+ */
+static bool_t bench_chunks( const char *filename )
+{
+    /* Variables locales */
+    unsigned int    size;      /* Taille du fichier            */
+    unsigned int    runs;      /* Nombre de remplissages       */
+    unsigned int    threads;   /* Nombre de threads            */
+    unsigned int    number;    /* Nombre de prfixes           */
+    double          start;     /* Dbut d'un remplissage       */
+    double          time;      /* Dure des remplissages       */
+    double          base;      /* Dbit avec un seul thread    */
+    char            *buffer;   /* Contenu du fichier           */
+    char            *copy;     /* Copie modifie par l'ajout   */
+    char            **keys;    /* Prfixes d'une lettre        */
+    bool_t          ok;        /* Pas d'erreur                 */
+    dict_t          reference; /* Dictionnaire d'un seul thread */
+    dict_t          dict;      /* Dictionnaire mesur          */
+    bench_words_s_t words;     /* Mots du fichier              */
+
+    /* Lecture du fichier et des prfixes d'une lettre */
+    if (!(buffer = bench_load_file( filename, &size )))
+	return FALSE;
+    if (!(copy = malloc( size + 1 ))) {
+	free( buffer );
+	return FALSE;
+    }
+    keys = NULL;
+    ok   = bench_get_words( filename, &words );
+    if (ok) {
+	keys = bench_get_prefixes( &words, 1, &number );
+	bench_free_words( &words );
+	ok = keys != NULL;
+    }
+
+    /* Remplissages par 1, 2, 4... threads */
+    reference = NULL;
+    base      = 0.0;
+    for (threads = 1; ok && threads <= CHUNKS_THREADS; threads *= 2) {
+	dict = NULL;
+	runs = 0;
+	time = 0.0;
+	while (ok && time < MIN_TIME) {
+	    if (dict)
+		dict_delete( dict );
+	    memcpy( copy, buffer, size + 1 );
+	    if (!(ok = (dict = dict_new()) != NULL))
+		break;
+	    dict_set_thread_number( dict, threads );
+	    start = bench_time();
+	    ok    = dict_add_words_from_string( dict, copy );
+	    time += bench_time() - start;
+	    runs++;
+	}
+
+	/* Vrification des mots obtenus */
+	if (ok && reference &&
+	    !bench_same_words( reference, dict, NULL, keys, number )) {
+	    printf( "%u thread(s) : mots diffrents de la rfrence\n",
+		    threads );
+	    ok = FALSE;
+	}
+	if (ok) {
+	    if (threads == 1)
+		base = size * runs / time;
+	    printf( "%u thread(s) : %.1f Mo/s (x%.2f)\n", threads,
+		    size * runs / time / 1e6, size * runs / time / base );
+	}
+
+	/* Le premier dictionnaire sert de rfrence */
+	if (!reference)
+	    reference = dict;
+	else if (dict)
+	    dict_delete( dict );
+    }
+
+    /* Libration de la mmoire */
+    if (reference)
+	dict_delete( reference );
+    if (keys)
+	bench_free_prefixes( keys, number );
+    free( copy );
+    free( buffer );
+    return ok;
+}
+
+/**
+ * Mesure la fusion dans le dictionnaire de la premire moiti du fichier de
+ * celui de la seconde moiti, puis de celui de la premire moiti mme
+ * (aucun mot  ajouter), en repassant par une chane de caractres ou avec
+ * dict_merge().
+ */
+static bool_t bench_merge( const char *filename )
+{
+    /* Variables locales */
+    unsigned int    size;    /* Taille du fichier            */
+    unsigned int    half;    /* Taille de la premire moiti */
+    unsigned int    number;  /* Nombre de prfixes           */
+    char            *buffer; /* Contenu du fichier           */
+    char            **keys;  /* Prfixes d'une lettre        */
+    bool_t          ok;      /* Pas d'erreur                 */
+    dict_t          other;   /* Dictionnaire fusionn        */
+    bench_words_s_t words;   /* Mots du fichier              */
+
+    /* Lecture du fichier et des prfixes d'une lettre */
+    if (!(buffer = bench_load_file( filename, &size )))
+	return FALSE;
+    keys = NULL;
+    ok   = bench_get_words( filename, &words );
+    if (ok) {
+	keys = bench_get_prefixes( &words, 1, &number );
+	bench_free_words( &words );
+	ok = keys != NULL;
+    }
+
+    /* Premire moiti, termine aprs un sparateur */
+    half = size / 2;
+    while (half < size && IS_ALPHA( buffer[half] ))
+	half++;
+
+    /* Fusion de la seconde moiti, puis de la premire */
+    if (ok) {
+	ok = (other = bench_dict_from_text( buffer + half,
+					    size - half )) != NULL;
+	ok = ok && bench_merge_case( "seconde moiti", buffer, half, other,
+				     keys, number );
+	if (other)
+	    dict_delete( other );
+    }
+    if (ok) {
+	ok = (other = bench_dict_from_text( buffer, half )) != NULL;
+	ok = ok && bench_merge_case( "mme moiti", buffer, half, other,
+				     keys, number );
+	if (other)
+	    dict_delete( other );
+    }
+
+    /* Libration de la mmoire */
+    if (keys)
+	bench_free_prefixes( keys, number );
+    free( buffer );
+    return ok;
+}
+
+/**
+ * Mesure le dbit du dcoupage en mots du contenu d'un fichier par chaque
+ * mthode disponible, seul puis suivi de l'ajout des mots  un
+ * dictionnaire, et vrifie que toutes trouvent les mmes mots.
+ */
+static bool_t bench_tokens( const char *filename )
+{
+    /* Variables locales */
+    unsigned int  size;       /* Taille du fichier                 */
+    unsigned int  runs;       /* Nombre de dcoupages              */
+    unsigned int  method;     /* Mthode mesure                   */
+    unsigned long counts[2];  /* Nombre de mots et de lettres      */
+    unsigned long first[2];   /* Comptes de la premire mthode    */
+    double        start;      /* Dbut d'un dcoupage              */
+    double        time;       /* Dure des mesures                 */
+    double        rate;       /* Dbit du dcoupage seul           */
+    double        base;       /* Dbit de la premire mthode      */
+    char          *buffer;    /* Contenu du fichier                */
+    char          *copy;      /* Copie modifie par le dcoupage   */
+    char          *reference; /* Copie dcoupe par la table       */
+    bool_t        ok;         /* Pas d'erreur                      */
+    dict_t        dict;       /* Dictionnaire rempli               */
+
+    /* Mthodes mesures */
+    static const struct
+    {
+	alpha_method_t method; /* Mthode */
+	const char     *name;  /* Nom     */
+    }
+    methods[] = {
+	{ ALPHA_TABLE, "table" },
+	{ ALPHA_SSE2,  "SSE2"  },
+	{ ALPHA_AVX2,  "AVX2"  }
+    };
+
+    /* Lecture du fichier */
+    if (!(buffer = bench_load_file( filename, &size )))
+	return FALSE;
+    copy      = malloc( size + 1 );
+    reference = malloc( size + 1 );
+    if (!copy || !reference) {
+	free( reference );
+	free( copy );
+	free( buffer );
+	return FALSE;
+    }
+
+    ok   = TRUE;
+    base = 0.0;
+    for (method = 0; ok && method < sizeof methods / sizeof methods[0];
+	 method++) {
+	if (!alpha_set_method( methods[method].method )) {
+	    printf( "%-5s : non disponible\n", methods[method].name );
+	    continue;
+	}
+
+	/* Dcoupage seul */
+	runs = 0;
+	time = 0.0;
+	while (ok && time < MIN_TIME) {
+	    memcpy( copy, buffer, size + 1 );
+	    counts[0] = counts[1] = 0;
+	    start = bench_time();
+	    ok    = alpha_split( copy, copy + size, bench_token_callback,
+				 counts );
+	    time += bench_time() - start;
+	    runs++;
+	}
+
+	/* Vrification des mots trouvs et de leur conversion */
+	if (ok && method == 0) {
+	    memcpy( reference, copy, size + 1 );
+	    first[0] = counts[0];
+	    first[1] = counts[1];
+	} else if (ok && (counts[0] != first[0] || counts[1] != first[1] ||
+			  memcmp( copy, reference, size ) != 0)) {
+	    printf( "%-5s : mots diffrents de la table\n",
+		    methods[method].name );
+	    ok = FALSE;
+	}
+	if (!ok)
+	    break;
+	rate = size * runs / time;
+	if (method == 0)
+	    base = rate;
+
+	/* Dcoupage suivi de l'ajout au dictionnaire */
+	dict = NULL;
+	runs = 0;
+	time = 0.0;
+	while (ok && time < MIN_TIME) {
+	    if (dict)
+		dict_delete( dict );
+	    memcpy( copy, buffer, size + 1 );
+	    if (!(ok = (dict = dict_new()) != NULL))
+		break;
+	    start = bench_time();
+	    ok    = dict_add_words_from_string( dict, copy );
+	    time += bench_time() - start;
+	    runs++;
+	}
+	if (dict)
+	    dict_delete( dict );
+
+	if (ok)
+	    printf( "%-5s : %lu mots, dcoupage %.1f Mo/s (x%.2f), "
+		    "dictionnaire %.1f Mo/s\n", methods[method].name,
+		    counts[0], rate / 1e6, rate / base,
+		    size * runs / time / 1e6 );
+    }
+
+    /* Retour au choix selon le processeur et libration de la mmoire */
+    alpha_set_method( ALPHA_BEST );
+    free( reference );
+    free( copy );
+    free( buffer );
+    return ok;
+}
+
+/**
+ * Mesure le temps de recherche des mots les plus frquents pour tous les
+ * prfixes d'une puis de deux lettres, puis celui du classement de tous les
+ * mots commenant par chaque lettre.
+ */
+static bool_t bench_topk( const char *filename )
+{
+    /* Variables locales */
+    unsigned int    i;        /* Compteur                    */
+    unsigned int    length;   /* Longueur des prfixes       */
+    unsigned int    number;   /* Nombre de prfixes          */
+    char            **keys;   /* Prfixes  rechercher       */
+    bool_t          ok;       /* Pas d'erreur                */
+    dict_t          dict;     /* Dictionnaire                */
+    bench_words_s_t words;    /* Mots du fichier             */
+
+    /* Lecture des mots et construction du dictionnaire */
+    if (!bench_get_words( filename, &words ))
+	return FALSE;
+
+    ok = (dict = dict_new()) != NULL;
+    for (i = 0; ok && i < words.count; i++)
+	ok = dict_add( dict, words.words[i] );
+
+    for (length = 1; ok && length <= 2; length++) {
+	/* Liste des prfixes de la longueur voulue */
+	if (!(keys = bench_get_prefixes( &words, length, &number ))) {
+	    ok = FALSE;
+	    break;
+	}
+
+	/* Recherches rptes */
+	printf( "%u lettre%s : %u prfixes, %.2f s/recherche\n", length,
+		length > 1 ? "s" : "", number,
+		bench_queries( dict, keys, number, NUM_WORDS ) );
+	if (length == 1)
+	    printf( "1 lettre, tous les mots : %.2f s/recherche\n",
+		    bench_queries( dict, keys, number, 0 ) );
+
+	bench_free_prefixes( keys, number );
+    }
+
+    /* Libration de la mmoire */
+    if (dict)
+	dict_delete( dict );
+    bench_free_words( &words );
+    return ok;
+}
+
+/**
+ * Compare, pour plusieurs profondeurs maximales des listes en cache, la
+ * mmoire occupe, le temps de reconstruction des listes, celui de l'ajout
+ * des mots un par un et celui des recherches pour les prfixes d'une  trois
+ * lettres.
+ */
+static bool_t bench_cache( const char *filename )
+{
+    /* Variables locales */
+    unsigned int    i;           /* Compteur                         */
+    unsigned int    mode;        /* Configuration mesure            */
+    unsigned int    length;      /* Longueur des prfixes            */
+    unsigned int    number[3];   /* Nombre de prfixes               */
+    unsigned long   used;        /* Mmoire occupe par les listes   */
+    double          start;       /* Dbut de la mesure               */
+    double          rebuild;     /* Dure de reconstruction          */
+    double          insert;      /* Dure d'ajout d'un mot           */
+    char            **keys[3];   /* Prfixes  rechercher            */
+    char            **result;    /* Rsultat d'une recherche         */
+    bool_t          ok;          /* Pas d'erreur                     */
+    dict_t          dict;        /* Dictionnaire                     */
+    bench_words_s_t words;       /* Mots du fichier                  */
+    static const int depths[] = { -1, 2, 4, 0 }; /* Profondeurs      */
+
+    /* Lecture des mots et des prfixes */
+    if (!bench_get_words( filename, &words ))
+	return FALSE;
+
+    ok = TRUE;
+    for (length = 1; length <= 3; length++) {
+	keys[length - 1] = ok ? bench_get_prefixes( &words, length,
+						    number + length - 1 )
+	    : NULL;
+	ok = keys[length - 1] != NULL;
+    }
+
+    for (mode = 0; ok && mode < sizeof (depths) / sizeof (*depths);
+	 mode++) {
+	/* Construction du dictionnaire avec les listes en cache */
+	if (!(dict = dict_new()) ||
+	    (depths[mode] >= 0 &&
+	     !dict_set_cache( dict, NUM_WORDS, depths[mode] ))) {
+	    ok = FALSE;
+	    break;
+	}
+	for (i = 0; ok && i < words.count; i++)
+	    ok = dict_add( dict, words.words[i] );
+
+	/* Reconstruction des listes lors de la premire recherche */
+	start = bench_time();
+	if ((result = dict_get_most_used( dict, keys[0][0], NUM_WORDS )))
+	    free( result );
+	rebuild = bench_time() - start;
+
+	/* Ajout des mots un par un, les listes tant tenues  jour */
+	start = bench_time();
+	for (i = 0; ok && i < words.count; i++)
+	    ok = dict_add( dict, words.words[i] );
+	insert = (bench_time() - start) * 1e9 / words.count;
+
+	dict_get_cache_memory_usage( dict, NULL, &used );
+	if (depths[mode] < 0)
+	    printf( "sans cache :" );
+	else
+	    printf( "profondeur %c : %lu Kio, reconstruction %.1f ms,",
+		    depths[mode] ? '0' + depths[mode] : '*', used / 1024,
+		    rebuild * 1e3 );
+	printf( " ajout %.0f ns/mot\n", insert );
+
+	/* Recherches */
+	for (length = 1; ok && length <= 3; length++)
+	    printf( "    %u lettre%s : %u prfixes, %.2f s/recherche\n",
+		    length, length > 1 ? "s" : "", number[length - 1],
+		    bench_queries( dict, keys[length - 1],
+				   number[length - 1], NUM_WORDS ) );
+
+	dict_delete( dict );
+    }
+
+    /* Libration de la mmoire */
+    for (length = 1; length <= 3; length++)
+	if (keys[length - 1])
+	    bench_free_prefixes( keys[length - 1], number[length - 1] );
+    bench_free_words( &words );
+    return ok;
+}
+
+/**
+ * Mesure les dbits de compression et de dcompression d'un fichier avec
+ * l'algorithme de Huffman (en Mo de donnes non compresses par seconde).
+ */
+static bool_t bench_huffman( const char *filename )
+{
+    /* Variables locales */
+    unsigned int  size;     /* Taille du fichier          */
+    unsigned int  read;     /* Taille dcompresse        */
+    unsigned long runs;     /* Nombre d'excutions        */
+    double        start;    /* Dbut de la mesure         */
+    double        time;     /* Dure de la mesure         */
+    char          *buffer;  /* Contenu du fichier         */
+    char          *result;  /* Donnes dcompresses      */
+    bool_t        ok;       /* Pas d'erreur               */
+
+    /* Lecture du fichier */
+    if (!(buffer = bench_load_file( filename, &size )))
+	return FALSE;
+
+    /* Compressions rptes */
+    ok    = TRUE;
+    runs  = 0;
+    time  = 0.0;
+    start = bench_time();
+    do {
+	if (!(ok = huffman_write( TEMP_FILE, buffer, size )))
+	    break;
+	runs++;
+    } while ((time = bench_time() - start) < MIN_TIME);
+
+    if (ok)
+	printf( "compression   : %lu excutions en %.3f s, %.1f Mo/s\n", runs,
+		time, size * (double) runs / time / 1e6 );
+
+    /* Dcompressions rptes, avec vrification du rsultat */
+    runs  = 0;
+    start = bench_time();
+    while (ok) {
+	if (!(ok = huffman_read( TEMP_FILE, &result, &read )))
+	    break;
+	ok = read == size && memcmp( result, buffer, size ) == 0;
+	free( result );
+	runs++;
+	if ((time = bench_time() - start) >= MIN_TIME)
+	    break;
+    }
+
+    if (ok)
+	printf( "dcompression : %lu excutions en %.3f s, %.1f Mo/s\n", runs,
+		time, size * (double) runs / time / 1e6 );
+
+    /* Libration de la mmoire */
+    remove( TEMP_FILE );
+    free( buffer );
+    return ok;
+}
+
+/**
+ * Mesure les dbits de compression et de dcompression par blocs selon le
+ * nombre de threads, sur le contenu du fichier rpt pour former assez de
+ * blocs.
+ */
+static bool_t bench_blocks( const char *filename )
+{
+    /* Variables locales */
+    unsigned int i;          /* Compteur                     */
+    unsigned int size;       /* Taille du fichier            */
+    unsigned int total;      /* Taille des donnes rptes  */
+    unsigned int threads;    /* Nombre de threads            */
+    double       compress;   /* Dbit de compression         */
+    double       decompress; /* Dbit de dcompression       */
+    double       base[2];    /* Dbits avec un seul thread   */
+    char         *buffer;    /* Contenu du fichier           */
+    char         *data;      /* Donnes rptes             */
+    bool_t       ok;         /* Pas d'erreur                 */
+
+    /* Lecture du fichier */
+    if (!(buffer = bench_load_file( filename, &size )))
+	return FALSE;
+    if (size == 0) {
+	free( buffer );
+	return FALSE;
+    }
+
+    /* Rptition du contenu */
+    total = (BLOCKS_SIZE + size - 1) / size * size;
+    if (!(data = malloc( total ))) {
+	free( buffer );
+	return FALSE;
+    }
+    for (i = 0; i < total; i += size)
+	memcpy( data + i, buffer, size );
+    free( buffer );
+
+    printf( "donnes       : %.1f Mo\n", total / 1e6 );
+
+    /* Mesures avec 1, 2, 4... threads, compares  la premire */
+    ok      = TRUE;
+    base[0] = base[1] = 0.0;
+    for (threads = 1; ok && threads <= BLOCKS_THREADS; threads *= 2) {
+	huffman_set_thread_number( threads );
+	if (!(ok = bench_codec( data, total, &compress, &decompress )))
+	    break;
+	if (threads == 1) {
+	    base[0] = compress;
+	    base[1] = decompress;
+	}
+	printf( "%u thread(s)   : compression %.1f Mo/s (x%.2f), "
+		"dcompression %.1f Mo/s (x%.2f)\n", threads, compress,
+		compress / base[0], decompress, decompress / base[1] );
+    }
+
+    /* Retour au nombre de threads par dfaut */
+    huffman_set_thread_number( 0 );
+
+    /* Libration de la mmoire */
+    remove( TEMP_FILE );
+    free( data );
+    return ok;
+}
+
+/**
+ * Mesure le temps moyen de recherche d'une liste de cls dans un arbre, en
+ * nanosecondes (ngatif en cas d'erreur).
+ */
+static double bench_searches( const tstree_t tree, char **words,
+			      unsigned int count )
+{
+    /* Variables locales */
+    unsigned int    i;        /* Compteur             */
+    unsigned long   searches; /* Nombre de recherches */
+    double          start;    /* Dbut de la mesure   */
+    double          time;     /* Dure de la mesure   */
+    tstree_cursor_t cursor;   /* Curseur de recherche */
+
+    if (count == 0)
+	return 0.0;
+
+    searches = 0;
+    start    = bench_time();
+    do {
+	for (i = 0; i < count; i++) {
+	    if (!(cursor = tstree_cursor_new( tree, words[i] )))
+		return -1.0;
+	    if (!tstree_cursor_next( cursor )) {
+		tstree_cursor_delete( cursor );
+		return -1.0;
+	    }
+	    tstree_cursor_delete( cursor );
+	}
+	searches += count;
+    } while ((time = bench_time() - start) < MIN_TIME);
+
+    return time * 1e9 / searches;
+}
+
+/**
+ * Mesure le temps moyen de recherche des NUM_WORDS cls les plus frquentes
+ * de chaque prfixe d'une liste dans un arbre, en nanosecondes (un prfixe
+ * absent ou sans suite compte comme une recherche).
+ */
+static double bench_lookups( const tstree_t tree, char **keys,
+			     unsigned int count )
+{
+    /* Variables locales */
+    unsigned int  i;                /* Compteur             */
+    unsigned int  number;           /* Nombre de cls       */
+    unsigned long searches;         /* Nombre de recherches */
+    double        start;            /* Dbut de la mesure   */
+    double        time;             /* Dure de la mesure   */
+    tstree_node_t nodes[NUM_WORDS]; /* Cls trouves        */
+
+    if (count == 0)
+	return 0.0;
+
+    searches = 0;
+    start    = bench_time();
+    do {
+	for (i = 0; i < count; i++) {
+	    number = NUM_WORDS;
+	    tstree_get_most_used( tree, keys[i], nodes, &number );
+	}
+	searches += count;
+    } while ((time = bench_time() - start) < MIN_TIME);
+
+    return time * 1e9 / searches;
+}
+
+/**
+ * Effectue la part des ajouts concurrents confie  un thread.
+ */
+static void bench_feed( void *data )
+{
+    /* Variables locales */
+    bench_feed_t feed = data; /* Part du thread */
+    unsigned int i;           /* Compteur       */
+
+    feed->ok = TRUE;
+    for (i = feed->first; feed->ok && i < feed->count * FEED_REPEAT;
+	 i += feed->step)
+	feed->ok = tstree_add_key_concurrent( feed->tree,
+					      feed->words[i % feed->count],
+					      1 ) != NULL;
+}
+
+/**
+ * Indique si deux arbres contiennent les mmes cls avec les mmes
+ * frquences.
+ */
+static bool_t bench_same_keys( const tstree_t first, const tstree_t second )
+{
+    /* Variables locales */
+    bool_t          same;       /* Arbres identiques       */
+    tstree_cursor_t cursors[2]; /* Curseurs sur les arbres */
+    tstree_node_t   nodes[2];   /* Cls courantes          */
+    char            *keys[2];   /* Chanes des cls        */
+
+    if (tstree_get_key_number( first ) != tstree_get_key_number( second ))
+	return FALSE;
+    if (!(cursors[0] = tstree_cursor_new( first, NULL )))
+	return FALSE;
+    if (!(cursors[1] = tstree_cursor_new( second, NULL ))) {
+	tstree_cursor_delete( cursors[0] );
+	return FALSE;
+    }
+
+    /* Comparaison des cls dans l'ordre de l'arbre */
+    same = TRUE;
+    while (same && (nodes[0] = tstree_cursor_next( cursors[0] ))) {
+	if (!(nodes[1] = tstree_cursor_next( cursors[1] )) ||
+	    tstree_node_get_count( nodes[0] ) !=
+	    tstree_node_get_count( nodes[1] )) {
+	    same = FALSE;
+	    break;
+	}
+	keys[0] = tstree_node_get_key( nodes[0] );
+	keys[1] = tstree_node_get_key( nodes[1] );
+	same    = keys[0] && keys[1] && strcmp( keys[0], keys[1] ) == 0;
+	free( keys[0] );
+	free( keys[1] );
+    }
+    same = same && !tstree_cursor_next( cursors[1] ) &&
+	!tstree_cursor_has_failed( cursors[0] ) &&
+	!tstree_cursor_has_failed( cursors[1] );
+
+    tstree_cursor_delete( cursors[0] );
+    tstree_cursor_delete( cursors[1] );
+    return same;
+}
+
+/**
+ * Indique si un dictionnaire et un autre (ou, s'il est NULL, un dictionnaire
+ * partitionn) contiennent les mmes mots, en tout puis pour chacun des
+ * prfixes donns. Une recherche qui choue d'un seul ct est une
+ * diffrence ; des deux cts, elle n'est admise que si aucun mot ne
+ * prolonge le prfixe.
+ */
+static bool_t bench_same_words( const dict_t dict, const dict_t other,
+				const shard_t shard, char **keys,
+				unsigned int number )
+{
+    /* Variables locales */
+    unsigned int i, j;       /* Compteurs                   */
+    unsigned int counts[2];  /* Nombre de mots trouvs      */
+    unsigned int total;      /* Nombre de mots en tout      */
+    unsigned int low, high;  /* Bornes de la recherche      */
+    char         empty[1];   /* Prfixe vide                */
+    char         *key;       /* Prfixe courant             */
+    char         **all;      /* Tous les mots, tris        */
+    char         **found[2]; /* Mots des deux dictionnaires */
+    bool_t       same;       /* Mmes mots                  */
+
+    empty[0] = '\0';
+    all      = NULL;
+    total    = 0;
+    same     = TRUE;
+    for (i = 0; same && i <= number; i++) {
+	key      = i == 0 ? empty : keys[i - 1];
+	found[0] = dict_get_most_used( dict, key, 0 );
+	found[1] = other ? dict_get_most_used( other, key, 0 ) :
+	    shard_get_most_used( shard, key, 0 );
+
+	/* Tri des mots, dont l'ordre diffre en cas d'galit */
+	for (j = 0; j < 2; j++) {
+	    counts[j] = 0;
+	    if (!found[j])
+		continue;
+	    while (found[j][counts[j]])
+		counts[j]++;
+	    qsort( found[j], counts[j], sizeof (char *), bench_compare );
+	}
+
+	same = (found[0] != NULL) == (found[1] != NULL) &&
+	    counts[0] == counts[1];
+	for (j = 0; same && j < counts[0]; j++)
+	    same = strcmp( found[0][j], found[1][j] ) == 0;
+
+	/* Aucun mot des deux cts : le prfixe vide doit en trouver, les
+	 * autres ne sont prolongs par aucun des mots (le prfixe lui-mme,
+	 * sans suite, n'tant pas retourn par la recherche) */
+	if (same && !found[0]) {
+	    if (i == 0)
+		same = FALSE;
+	    else {
+		low  = 0;
+		high = total;
+		while (low < high)
+		    if (bench_compare( all + (low + high) / 2, &key ) < 0)
+			low = (low + high) / 2 + 1;
+		    else
+			high = (low + high) / 2;
+		if (low < total && strcmp( all[low], key ) == 0)
+		    low++;
+		same = low == total ||
+		    strncmp( all[low], key, strlen( key ) ) != 0;
+	    }
+	}
+
+	/* Tous les mots sont gards pour les prfixes suivants */
+	if (i == 0) {
+	    all   = found[0];
+	    total = counts[0];
+	} else
+	    free( found[0] );
+	free( found[1] );
+    }
+
+    free( all );
+    return same;
+}
+
+/**
+ * Effectue les recherches d'un thread lecteur.
+ */
+static void bench_read( void *data )
+{
+    /* Variables locales */
+    bench_read_t read = data; /* Lecteur               */
+    unsigned int i;           /* Prfixe courant       */
+    double       start;       /* Dbut d'une recherche */
+    char         **result;    /* Rsultat              */
+
+    read->count = 0;
+    i           = read->first % read->number;
+    while (!__atomic_load_n( read->stop, __ATOMIC_ACQUIRE )) {
+	start = bench_time();
+	if (read->lock)
+	    pthread_mutex_lock( read->lock );
+	result = dict_get_most_used( read->dict, read->keys[i], NUM_WORDS );
+	if (read->lock)
+	    pthread_mutex_unlock( read->lock );
+	read->times[read->count++ % READ_SAMPLES] = bench_time() - start;
+	free( result );
+
+	if (++i == read->number)
+	    i = 0;
+    }
+}
+
+/**
+ * Compare deux dures pour le tri.
+ */
+static int bench_compare_times( const void *first, const void *second )
+{
+    /* Variables locales */
+    double a = *(const double *) first;  /* Premire dure */
+    double b = *(const double *) second; /* Seconde dure  */
+
+    return a < b ? -1 : a > b;
+}
+
+/**
+ * Lance READ_THREADS lecteurs sur un dictionnaire, pendant que le thread
+ * courant ajoute une liste de mots (ou attend MIN_TIME secondes si elle est
+ * vide), puis affiche la latence moyenne, au 99e centile et maximale des
+ * dernires recherches de chaque lecteur.
+ */
+static bool_t bench_read_phase( const char *label, dict_t dict,
+				pthread_mutex_t *lock, char **keys,
+				unsigned int number, char **words,
+				unsigned int count )
+{
+    /* Variables locales */
+    unsigned int    i;                   /* Compteur                    */
+    unsigned long   kept;                /* Dures conserves (lecteur) */
+    unsigned long   samples;             /* Dures conserves (total)   */
+    unsigned long   total;               /* Nombre de recherches        */
+    double          start;               /* Dbut des ajouts            */
+    double          time;                /* Dure des ajouts            */
+    double          sum;                 /* Somme des dures            */
+    double          *times;              /* Dures de tous les lecteurs */
+    bool_t          ok;                  /* Pas d'erreur                */
+    bool_t          stop;                /* Arrt demand               */
+    pool_t          pool;                /* Groupe de threads           */
+    pool_task_s_t   tasks[READ_THREADS]; /* Tches des lecteurs         */
+    bench_read_s_t  reads[READ_THREADS]; /* Lecteurs                    */
+    struct timespec delay;               /* Dure sans crivain         */
+
+    if (!(times = malloc( READ_THREADS * READ_SAMPLES * sizeof (double) )))
+	return FALSE;
+    if (!(pool = pool_new( READ_THREADS ))) {
+	free( times );
+	return FALSE;
+    }
+
+    /* Dmarrage des lecteurs */
+    stop = FALSE;
+    for (i = 0; i < READ_THREADS; i++) {
+	reads[i].dict   = dict;
+	reads[i].lock   = lock;
+	reads[i].keys   = keys;
+	reads[i].number = number;
+	reads[i].first  = i * number / READ_THREADS;
+	reads[i].stop   = &stop;
+	reads[i].times  = times + i * READ_SAMPLES;
+	pool_submit( pool, tasks + i, bench_read, reads + i );
+    }
+
+    /* Ajouts de l'crivain */
+    ok    = TRUE;
+    start = bench_time();
+    if (count == 0) {
+	delay.tv_sec  = (time_t) MIN_TIME;
+	delay.tv_nsec = (long) ((MIN_TIME - delay.tv_sec) * 1e9);
+	nanosleep( &delay, NULL );
+    }
+    for (i = 0; ok && i < count; i++) {
+	if (lock)
+	    pthread_mutex_lock( lock );
+	ok = dict_add( dict, words[i] );
+	if (lock)
+	    pthread_mutex_unlock( lock );
+    }
+    time = bench_time() - start;
+
+    /* Arrt des lecteurs */
+    __atomic_store_n( &stop, TRUE, __ATOMIC_RELEASE );
+    samples = 0;
+    total   = 0;
+    for (i = 0; i < READ_THREADS; i++) {
+	pool_wait( pool, tasks + i );
+	total += reads[i].count;
+	kept   = reads[i].count < READ_SAMPLES ? reads[i].count :
+	    READ_SAMPLES;
+	memmove( times + samples, reads[i].times, kept * sizeof (double) );
+	samples += kept;
+    }
+    pool_delete( pool );
+
+    /* Latences des lecteurs */
+    if (ok) {
+	printf( "%s : %lu recherches", label, total );
+	if (samples > 0) {
+	    sum = 0.0;
+	    for (i = 0; i < samples; i++)
+		sum += times[i];
+	    qsort( times, samples, sizeof (double), bench_compare_times );
+	    printf( ", %.2f s en moyenne, %.2f s au 99e centile, %.2f s "
+		    "au plus", sum / samples * 1e6,
+		    times[samples * 99 / 100] * 1e6,
+		    times[samples - 1] * 1e6 );
+	}
+	if (count > 0)
+	    printf( ", %.2f kajouts/s", count / time / 1e3 );
+	putchar( '\n' );
+    }
+
+    free( times );
+    return ok;
+}
+
+/**
+ * Mesure le dbit des parcours complets d'un arbre, en millions de noeuds
+ * par seconde (ngatif en cas d'erreur).
+ */
+static double bench_walks( const tstree_t tree )
+{
+    /* Variables locales */
+    unsigned long walks; /* Nombre de parcours      */
+    unsigned long keys;  /* Nombre de cls trouves */
+    double        start; /* Dbut de la mesure      */
+    double        time;  /* Dure de la mesure      */
+
+    walks = 0;
+    keys  = 0;
+    start = bench_time();
+    do {
+	if (!tstree_get_keys( tree, NULL,
+			      (tstree_callback_t) bench_count_callback,
+			      &keys ))
+	    return -1.0;
+	walks++;
+    } while ((time = bench_time() - start) < MIN_TIME);
+
+    return tstree_get_node_number( tree ) * (double) walks / time / 1e6;
+}
+
+/**
+ * Cre un dictionnaire contenant les mots des `size' premiers caractres
+ * d'un texte.
+ */
+static dict_t bench_dict_from_text( const char *text, unsigned int size )
+{
+    /* Variables locales */
+    char   *copy; /* Copie modifie par l'ajout */
+    dict_t dict;  /* Dictionnaire cr          */
+
+    if (!(copy = malloc( size + 1 )))
+	return NULL;
+    memcpy( copy, text, size );
+    copy[size] = '\0';
+
+    if ((dict = dict_new()) && !dict_add_words_from_string( dict, copy )) {
+	dict_delete( dict );
+	dict = NULL;
+    }
+
+    free( copy );
+    return dict;
+}
+
+/**
+ * Mesure l'ajout des mots d'un dictionnaire  celui d'un texte, d'abord en
+ * repassant par une chane de caractres, puis avec dict_merge(), et vrifie
+ * que les deux mthodes donnent les mmes mots.
+ */
+static bool_t bench_merge_case( const char *label, const char *text,
+				unsigned int size, const dict_t other,
+				char **keys, unsigned int number )
+{
+    /* Variables locales */
+    unsigned int method;   /* Mthode mesure               */
+    unsigned int runs;     /* Nombre de fusions             */
+    double       start;    /* Dbut d'une fusion            */
+    double       times[2]; /* Dure d'une fusion            */
+    char         *string;  /* Mots du dictionnaire fusionn */
+    bool_t       ok;       /* Pas d'erreur                  */
+    dict_t       dicts[2]; /* Dictionnaires complts       */
+
+    ok       = TRUE;
+    dicts[0] = NULL;
+    dicts[1] = NULL;
+    for (method = 0; ok && method < 2; method++) {
+	runs          = 0;
+	times[method] = 0.0;
+	while (ok && times[method] < MIN_TIME) {
+	    if (dicts[method])
+		dict_delete( dicts[method] );
+	    if (!(dicts[method] = bench_dict_from_text( text, size ))) {
+		ok = FALSE;
+		break;
+	    }
+
+	    start = bench_time();
+	    if (method == 0) {
+		ok = (string = dict_get_words_into_string( other )) != NULL &&
+		    dict_add_words_from_string( dicts[method], string );
+		free( string );
+	    } else
+		ok = dict_merge( dicts[method], other );
+	    times[method] += bench_time() - start;
+	    runs++;
+	}
+	if (runs != 0)
+	    times[method] /= runs;
+    }
+
+    /* Vrification des mots obtenus */
+    if (ok && !bench_same_words( dicts[0], dicts[1], NULL, keys, number )) {
+	printf( "%s : mots diffrents selon la mthode\n", label );
+	ok = FALSE;
+    }
+    if (ok)
+	printf( "%s : chane %.2f ms, fusion %.2f ms (x%.1f)\n", label,
+		times[0] * 1e3, times[1] * 1e3, times[0] / times[1] );
+
+    /* Libration de la mmoire */
+    if (dicts[0])
+	dict_delete( dicts[0] );
+    if (dicts[1])
+	dict_delete( dicts[1] );
+    return ok;
+}
+
+/**
+ * Mesure les dbits de compression et de dcompression de donnes (en Mo
+ * de donnes non compresses par seconde), en vrifiant le rsultat.
+ */
+static bool_t bench_codec( const char *buffer, unsigned int size,
+			   double *compress, double *decompress )
+{
+    /* Variables locales */
+    unsigned int  read;    /* Taille dcompresse    */
+    unsigned long runs;    /* Nombre d'excutions    */
+    double        start;   /* Dbut de la mesure     */
+    double        time;    /* Dure de la mesure     */
+    char          *result; /* Donnes dcompresses  */
+
+    /* Compressions rptes */
+    runs  = 0;
+    start = bench_time();
+    do {
+	if (!huffman_write( TEMP_FILE, buffer, size ))
+	    return FALSE;
+	runs++;
+    } while ((time = bench_time() - start) < MIN_TIME);
+    *compress = size * (double) runs / time / 1e6;
+
+    /* Dcompressions rptes */
+    runs  = 0;
+    start = bench_time();
+    do {
+	if (!huffman_read( TEMP_FILE, &result, &read ))
+	    return FALSE;
+	if (read != size || memcmp( result, buffer, size ) != 0) {
+	    free( result );
+	    return FALSE;
+	}
+	free( result );
+	runs++;
+    } while ((time = bench_time() - start) < MIN_TIME);
+    *decompress = size * (double) runs / time / 1e6;
+
+    /* Pas d'erreur */
+    return TRUE;
+}
+
+/* Fin du fichier */
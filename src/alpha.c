@@ -0,0 +1,385 @@
+/*
+ * ---------------------------------------------------------------------------
+ *
+ * Act : Auto-Completion Tree -- Implmentation d'un arbre d'auto-compltion
+ * Copyright (c) 2004 Benjamin Gaillard
+ *
+ * ---------------------------------------------------------------------------
+ *
+ * Fichier     : alpha.c
+ *
+ * Description : Dcoupage d'un texte en mots, convertis en minuscules sur
+ *               place, par blocs de 32 octets.
+ *
+ * Commentaire : Chaque bloc est rduit  un masque de 32 bits indiquant ses
+ *               lettres, obtenu par une table de conversion ou, sur x86-64
+ *               avec GCC, par des instructions SSE2 ou AVX2 (choisies selon
+ *               le processeur) ; les limites des mots sont ensuite trouves
+ *               en parcourant les bits du masque o il change.
+ *
+ * ---------------------------------------------------------------------------
+ *
+ * Ce programme est un logiciel libre ; vous pouvez le redistribuer et/ou le
+ * modifier conformment aux dispositions de la Licence Publique Gnrale GNU,
+ * telle que publie par la Free Software Foundation ; version 2 de la
+ * licence, ou encore ( votre convenance) toute version ultrieure.
+ *
+ * Ce programme est distribu dans l'espoir qu'il sera utile, mais SANS AUCUNE
+ * GARANTIE ; sans mme la garantie implicite de COMMERCIALISATION ou
+ * D'ADAPTATION  UN OBJET PARTICULIER. Pour plus de dtail, voir la Licence
+ * Publique Gnrale GNU.
+ *
+ * Vous devez avoir reu un exemplaire de la Licence Publique Gnrale GNU en
+ * mme temps que ce programme ; si ce n'est pas le cas, crivez  la Free
+ * Software Foundation Inc., 675 Mass Ave, Cambridge, MA 02139, tats-Unis.
+ *
+ * ---------------------------------------------------------------------------
+ */
+
+
+/* En-ttes standard */
+#include <stdint.h>
+#include <assert.h>
+#if defined( __GNUC__ ) && defined( __x86_64__ )
+# define ALPHA_SIMD
+# include <immintrin.h>
+#endif
+
+/* En-ttes locaux */
+#include "alpha.h"
+
+
+/*****************************************************************************
+ *
+ * CONSTANTES ET MACROS
+ *
+ */
+
+/* Taille d'un bloc, un bit du masque par octet */
+#define BLOCK_SIZE 32
+
+/* Minuscule correspondant  un caractre, ou zro si ce n'est pas une
+ * lettre */
+#define LOWER( c )                                                         \
+    ((unsigned char) (IS_UPPER_CASE( (char) (c) ) ?                        \
+		      UPPER_TO_LOWER_CASE( (char) (c) ) :                  \
+		      IS_ALPHA( (char) (c) ) ? (char) (c) : 0))
+
+/* Seize entres conscutives de la table de conversion */
+#define LOWER_ROW( c )                                                     \
+    LOWER( (c) +  0 ), LOWER( (c) +  1 ), LOWER( (c) +  2 ),               \
+    LOWER( (c) +  3 ), LOWER( (c) +  4 ), LOWER( (c) +  5 ),               \
+    LOWER( (c) +  6 ), LOWER( (c) +  7 ), LOWER( (c) +  8 ),               \
+    LOWER( (c) +  9 ), LOWER( (c) + 10 ), LOWER( (c) + 11 ),               \
+    LOWER( (c) + 12 ), LOWER( (c) + 13 ), LOWER( (c) + 14 ),               \
+    LOWER( (c) + 15 )
+
+
+/*****************************************************************************
+ *
+ * TYPES DE DONNES
+ *
+ */
+
+/* Fonction rduisant un bloc entier  son masque de lettres */
+typedef uint32_t (*alpha_block_t)( char *block );
+
+
+/*****************************************************************************
+ *
+ * PROTOTYPES DES FONCTIONS STATIQUES
+ *
+ */
+
+static alpha_block_t alpha_select( void );
+static uint32_t      alpha_block_table( char *block );
+static uint32_t      alpha_table( char *block, unsigned int size );
+#ifdef ALPHA_SIMD
+static uint32_t      alpha_block_sse2( char *block );
+static uint32_t      alpha_block_avx2( char *block )
+    __attribute__ ((__target__ ("avx2")));
+#endif /* ALPHA_SIMD */
+
+
+/*****************************************************************************
+ *
+ * VARIABLES STATIQUES
+ *
+ */
+
+/* Minuscule de chaque caractre (zro : pas une lettre), dduite des macros
+ * de alpha.h */
+static const unsigned char lowers[256] = {
+    LOWER_ROW( 0x00 ), LOWER_ROW( 0x10 ), LOWER_ROW( 0x20 ),
+    LOWER_ROW( 0x30 ), LOWER_ROW( 0x40 ), LOWER_ROW( 0x50 ),
+    LOWER_ROW( 0x60 ), LOWER_ROW( 0x70 ), LOWER_ROW( 0x80 ),
+    LOWER_ROW( 0x90 ), LOWER_ROW( 0xA0 ), LOWER_ROW( 0xB0 ),
+    LOWER_ROW( 0xC0 ), LOWER_ROW( 0xD0 ), LOWER_ROW( 0xE0 ),
+    LOWER_ROW( 0xF0 )
+};
+
+/* Mthode impose par alpha_set_method() */
+static alpha_method_t method = ALPHA_BEST;
+
+
+/*****************************************************************************
+ *
+ * FONCTIONS EXTERNES
+ *
+ */
+
+/**
+ * Impose la mthode de dcoupage utilise par alpha_split() (ALPHA_BEST
+ * rtablit le choix selon le processeur). Retourne FALSE si elle n'est pas
+ * disponible.  appeler avant de lancer des threads.
+ */
+bool_t alpha_set_method( alpha_method_t chosen )
+{
+    switch (chosen) {
+    case ALPHA_BEST:
+    case ALPHA_TABLE:
+	break;
+
+#ifdef ALPHA_SIMD
+    case ALPHA_SSE2:
+	break;
+
+    case ALPHA_AVX2:
+	if (!__builtin_cpu_supports( "avx2" ))
+	    return FALSE;
+	break;
+#endif /* ALPHA_SIMD */
+
+    default:
+	return FALSE;
+    }
+
+    method = chosen;
+    return TRUE;
+}
+
+/**
+ * Dcoupe le texte compris entre `text' et `end' (exclu) en mots, suites
+ * maximales de lettres converties en minuscules sur place, et appelle
+ * `callback' pour chacun d'eux avec sa longueur, tant qu'elle retourne
+ * TRUE. Seuls les octets du texte sont lus et modifis : plusieurs threads
+ * peuvent dcouper en mme temps des parts voisines d'une mme chane.
+ */
+bool_t alpha_split( char *text, const char *end, alpha_callback_t callback,
+		    void *data )
+{
+    /* Variables locales */
+    unsigned int  size;   /* Taille du bloc                     */
+    unsigned int  bit;    /* Position d'une limite              */
+    uint32_t      mask;   /* Lettres du bloc                    */
+    uint32_t      edges;  /* Limites des mots dans le bloc      */
+    uint32_t      carry;  /* Dernier octet du bloc prcdent    */
+    char          *block; /* Bloc courant                       */
+    char          *start; /* Dbut du mot en cours (NULL : aucun) */
+    alpha_block_t reduce; /* Rduction d'un bloc entier         */
+
+    /* Vrification des paramtres */
+    assert( text );
+    assert( end >= text );
+    assert( callback );
+
+    reduce = alpha_select();
+    carry  = 0;
+    start  = NULL;
+    for (block = text; block < end; block += size) {
+	/* Masque des lettres, le dernier bloc tant trait octet par octet */
+	if (end - block >= BLOCK_SIZE) {
+	    size = BLOCK_SIZE;
+	    mask = reduce( block );
+	} else {
+	    size = end - block;
+	    mask = alpha_table( block, size );
+	}
+
+	/* Limites : un bit du masque diffrent du prcdent marque le dbut
+	 * ou la fin d'un mot */
+	edges = mask ^ ((mask << 1) | carry);
+	carry = mask >> (BLOCK_SIZE - 1);
+	while (edges != 0) {
+#ifdef __GNUC__
+	    bit = __builtin_ctz( edges );
+#else /* __GNUC__ */
+	    for (bit = 0; !(edges & (1UL << bit)); bit++)
+		;
+#endif /* !__GNUC__ */
+	    edges &= edges - 1;
+
+	    if (mask & ((uint32_t) 1 << bit))
+		start = block + bit;
+	    else {
+		if (!callback( start, block + bit - start, data ))
+		    return FALSE;
+		start = NULL;
+	    }
+	}
+    }
+
+    /* Mot se terminant avec le texte */
+    return !start || callback( start, end - start, data );
+}
+
+
+/*****************************************************************************
+ *
+ * FONCTIONS STATIQUES
+ *
+ */
+
+/**
+ * Choisit la fonction de rduction des blocs entiers selon la mthode
+ * impose ou,  dfaut, selon le processeur.
+ */
+static alpha_block_t alpha_select( void )
+{
+#ifdef ALPHA_SIMD
+    switch (method) {
+    case ALPHA_TABLE:
+	return alpha_block_table;
+
+    case ALPHA_SSE2:
+	return alpha_block_sse2;
+
+    default:
+	return __builtin_cpu_supports( "avx2" ) ? alpha_block_avx2 :
+	    alpha_block_sse2;
+    }
+#else /* ALPHA_SIMD */
+    return alpha_block_table;
+#endif /* !ALPHA_SIMD */
+}
+
+/**
+ * Rduit un bloc entier  son masque de lettres avec la table.
+ */
+static uint32_t alpha_block_table( char *block )
+{
+    return alpha_table( block, BLOCK_SIZE );
+}
+
+/**
+ * Convertit en minuscules les lettres des `size' premiers octets d'un bloc
+ * et retourne leur masque, un octet  la fois grce  la table.
+ */
+static uint32_t alpha_table( char *block, unsigned int size )
+{
+    /* Variables locales */
+    unsigned int  i;     /* Compteur              */
+    unsigned char lower; /* Minuscule d'un octet  */
+    uint32_t      mask;  /* Lettres du bloc       */
+
+    /* Vrification des paramtres */
+    assert( block );
+    assert( size <= BLOCK_SIZE );
+
+    for (i = 0, mask = 0; i < size; i++)
+	if ((lower = lowers[(unsigned char) block[i]]) != 0) {
+	    mask |= (uint32_t) 1 << i;
+	    if (block[i] != (char) lower)
+		block[i] = (char) lower;
+	}
+
+    return mask;
+}
+
+#ifdef ALPHA_SIMD
+
+/**
+ * Rduit un bloc entier  son masque de lettres, 16 octets  la fois avec
+ * SSE2. Une fois le bit de casse (0x20) forc, les lettres sont les octets
+ * de [a-z] et de [-] sauf  ; les majuscules sont celles dont le bit
+ * tait nul, converties en le forant.
+ */
+static uint32_t alpha_block_sse2( char *block )
+{
+    /* Variables locales */
+    unsigned int i;      /* Moiti du bloc             */
+    uint32_t     mask;   /* Lettres du bloc            */
+    __m128i      chrs;   /* Caractres                 */
+    __m128i      folded; /* Caractres, bit de casse forc */
+    __m128i      latin;  /* Position dans [-]        */
+    __m128i      ascii;  /* Position dans [a-z]        */
+    __m128i      alpha;  /* Lettres                    */
+    __m128i      upper;  /* Majuscules                 */
+    __m128i      flag;   /* Bit de casse               */
+
+    flag = _mm_set1_epi8( 0x20 );
+    mask = 0;
+    for (i = 0; i < BLOCK_SIZE; i += 16) {
+	chrs   = _mm_loadu_si128( (const __m128i *) (block + i) );
+	folded = _mm_or_si128( chrs, flag );
+
+	/* Comparaisons non signes par le minimum : x <= n si min(x, n) = x */
+	ascii = _mm_sub_epi8( folded, _mm_set1_epi8( 'a' ) );
+	latin = _mm_sub_epi8( folded, _mm_set1_epi8( (char) 0xE0 ) );
+	alpha = _mm_or_si128(
+	    _mm_cmpeq_epi8( _mm_min_epu8( ascii, _mm_set1_epi8( 'z' - 'a' ) ),
+			    ascii ),
+	    _mm_andnot_si128(
+		_mm_cmpeq_epi8( folded, _mm_set1_epi8( (char) 0xF7 ) ),
+		_mm_cmpeq_epi8( _mm_min_epu8( latin, _mm_set1_epi8( 0x1E ) ),
+				latin ) ) );
+
+	/* Conversion des majuscules, crites seulement s'il y en a */
+	upper = _mm_andnot_si128( _mm_cmpeq_epi8( _mm_and_si128( chrs, flag ),
+						  flag ), alpha );
+	if (_mm_movemask_epi8( upper ) != 0)
+	    _mm_storeu_si128( (__m128i *) (block + i),
+			      _mm_or_si128( chrs,
+					    _mm_and_si128( upper, flag ) ) );
+
+	mask |= (uint32_t) _mm_movemask_epi8( alpha ) << i;
+    }
+
+    return mask;
+}
+
+/**
+ * Rduit un bloc entier  son masque de lettres en une fois avec AVX2, de
+ * la mme manire qu'avec SSE2.
+ */
+static uint32_t alpha_block_avx2( char *block )
+{
+    /* Variables locales */
+    __m256i chrs;   /* Caractres                     */
+    __m256i folded; /* Caractres, bit de casse forc */
+    __m256i latin;  /* Position dans [-]            */
+    __m256i ascii;  /* Position dans [a-z]            */
+    __m256i alpha;  /* Lettres                        */
+    __m256i upper;  /* Majuscules                     */
+    __m256i flag;   /* Bit de casse                   */
+
+    flag   = _mm256_set1_epi8( 0x20 );
+    chrs   = _mm256_loadu_si256( (const __m256i *) block );
+    folded = _mm256_or_si256( chrs, flag );
+
+    ascii = _mm256_sub_epi8( folded, _mm256_set1_epi8( 'a' ) );
+    latin = _mm256_sub_epi8( folded, _mm256_set1_epi8( (char) 0xE0 ) );
+    alpha = _mm256_or_si256(
+	_mm256_cmpeq_epi8( _mm256_min_epu8( ascii,
+					    _mm256_set1_epi8( 'z' - 'a' ) ),
+			   ascii ),
+	_mm256_andnot_si256(
+	    _mm256_cmpeq_epi8( folded, _mm256_set1_epi8( (char) 0xF7 ) ),
+	    _mm256_cmpeq_epi8( _mm256_min_epu8( latin,
+						_mm256_set1_epi8( 0x1E ) ),
+			       latin ) ) );
+
+    upper = _mm256_andnot_si256(
+	_mm256_cmpeq_epi8( _mm256_and_si256( chrs, flag ), flag ), alpha );
+    if (_mm256_movemask_epi8( upper ) != 0)
+	_mm256_storeu_si256( (__m256i *) block,
+			     _mm256_or_si256( chrs,
+					      _mm256_and_si256( upper,
+								flag ) ) );
+
+    return (uint32_t) _mm256_movemask_epi8( alpha );
+}
+
+#endif /* ALPHA_SIMD */
+
+/* Fin du fichier */
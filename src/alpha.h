@@ -9,7 +9,8 @@
  * Fichier     : alpha.h
  *
  * Description : Ce fichier contient quelques macros bien utiles concernant
- *               l'identification des lettre et de leur casse.
+ *               l'identification des lettre et de leur casse, ainsi que les
+ *               prototypes des fonctions externes du fichier `alpha.c'.
  *
  * Commentaire : Ces macros ne fonctionnent qu'avec le charset ISO-8859-1.
  *
@@ -37,6 +38,15 @@
 #ifndef _ALPHA_H_
 #define _ALPHA_H_
 
+/* En-ttes locaux */
+#include "bool.h"
+
+/* Traitement spcial si utilisation dans un programme C++ (dbut) */
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
 
 /* Macro servant  dterminer si un caractre est une lettre, c'est--dire
  * respectant l'expression rationnelle [A-Za-z----] */
@@ -67,6 +77,30 @@
 /* Macro servant  convertir une minuscule en majuscule */
 #define LOWER_TO_UPPER_CASE( c ) ((c) - ('a' - 'A'))
 
+/* Mthodes de dcoupage d'un texte en mots */
+typedef enum alpha_method
+{
+    ALPHA_BEST,  /* Meilleure mthode disponible           */
+    ALPHA_TABLE, /* Table de conversion, octet par octet   */
+    ALPHA_SSE2,  /* Instructions SSE2, 16 octets  la fois */
+    ALPHA_AVX2   /* Instructions AVX2, 32 octets  la fois */
+}
+alpha_method_t;
+
+/* Fonction appele pour chaque mot d'un texte */
+typedef bool_t (*alpha_callback_t)( char *word, unsigned int length,
+				    void *data );
+
+/* Prototypes des fonctions externes */
+bool_t alpha_set_method( alpha_method_t method );
+bool_t alpha_split( char *text, const char *end, alpha_callback_t callback,
+		    void *data );
+
+
+/* Traitement spcial si utilisation dans un programme C++ (fin) */
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
 
 #endif /* !_ALPHA_H_ */
 
@@ -35,28 +35,105 @@
 
 /* En-ttes standard */
 #include <stdlib.h>
+#include <limits.h>
 #include <string.h>
 #include <assert.h>
+#include <sched.h>
 
 /* En-ttes locaux */
 #include "dict.h"
 #include "tstree.h"
+#include "huffman.h"
+#include "pool.h"
 #include "alpha.h"
 
 
+/*****************************************************************************
+ *
+ * CONSTANTES
+ *
+ */
+
+/* Taille des morceaux de donnes lus ou crits en flux */
+#define CHUNK_SIZE 65536 /* 64 Ko */
+
+/* En-tte des fichiers de dictionnaire, suivi d'un octet de version : sans
+ * lui, un fichier contient du texte o chaque mot est rpt suivant sa
+ * frquence ; en version 1, chaque mot est suivi d'un zro puis de sa
+ * frquence, code par groupes de 7 bits (poids faibles d'abord, bit de
+ * poids fort indiquant qu'un autre groupe suit) ; en version 2, les mots
+ * sont tris et chacun commence par le nombre de caractres communs avec le
+ * prcdent, cod de mme, suivi du reste du mot, d'un zro et de la
+ * frquence */
+#define HEADER           "\0ACT"
+#define HEADER_SIZE      5 /* Avec la version */
+#define VERSION_COUNTS   1
+#define VERSION_PREFIXES 2
+
+/* Taille maximale d'un nombre cod */
+#define MAX_NUMBER_SIZE 5
+
+/* Nombre de threads dcoupant une chane par dfaut : un seul, les mots
+ * tant alors ajouts dans l'ordre de la chane */
+#define DEFAULT_THREADS 1
+
+/* Dfinition utilise pour supprimer les avertissements de paramtres
+ * inutiliss lors de la compilation */
+#ifdef __GNUC__
+#define UNUSED __attribute__ ((__unused__))
+#else /* __GNUC__ */
+#define UNUSED
+#endif /* !__GNUC__ */
+
+
 /*****************************************************************************
  *
  * TYPES DE DONNES
  *
  */
 
+/* Lecture concurrente : les lecteurs parcourent la copie active de l'arbre
+ * pendant que l'crivain modifie l'autre, puis les change ; chaque lecteur
+ * est compt  son entre et  sa sortie dans l'poque, paire ou impaire,
+ * en cours  son arrive */
+typedef struct dict_readers
+{
+    tstree_t      trees[2];      /* Copies de l'arbre                */
+    unsigned int  active;        /* Copie parcourue par les lecteurs */
+    unsigned int  epoch;         /* poque courante                  */
+    unsigned long arrivals[2];   /* Lecteurs entrs, par poque      */
+    unsigned long departures[2]; /* Lecteurs sortis, par poque      */
+    bool_t        stale;         /* Copie inactive  remplacer       */
+}
+dict_readers_s_t, *dict_readers_t;
+
 /* Objet dictionnaire */
 typedef struct dict
 {
-    tstree_t tree; /* Arbre ternaire de recherche */
+    tstree_t       tree;    /* Arbre ternaire de recherche            */
+    dict_readers_t readers; /* Lecture concurrente (NULL : aucune)    */
+    unsigned int   threads; /* Threads dcoupant une chane           */
+    pool_t         pool;    /* Groupe de threads (cr  la demande)  */
+    bool_t         compact; /* Compactage aprs un chargement         */
 }
 dict_s_t;
 
+/* Part d'une chane confie  un thread, dont les mots sont compts dans un
+ * arbre propre au thread */
+typedef struct dict_chunk
+{
+    char          *start; /* Dbut de la part   */
+    char          *end;   /* Fin de la part     */
+    tstree_t      tree;   /* Mots de la part    */
+    bool_t        ok;     /* Pas d'erreur       */
+    pool_task_s_t task;   /* Tche du thread    */
+}
+dict_chunk_s_t, *dict_chunk_t;
+
+/* Modification applique  chacune des copies de l'arbre */
+typedef bool_t (*dict_change_t)( tstree_t tree, const char *word,
+				 unsigned int count );
+
 typedef struct callback_data
 {
     unsigned int  max;    /* Nombre maximum d'lments  */
@@ -65,6 +142,17 @@ typedef struct callback_data
 }
 callback_data_t;
 
+/* tat de la lecture des enregistrements d'un fichier */
+typedef struct dict_records
+{
+    int               version;  /* Version du format                 */
+    unsigned int      length;   /* Longueur du mot prcdent         */
+    unsigned int      size;     /* Taille alloue pour le mot        */
+    char              *word;    /* Mot prcdent, puis mot courant   */
+    tstree_inserter_t inserter; /* Objet d'insertion des mots tris */
+}
+dict_records_t;
+
 
 /*****************************************************************************
  *
@@ -73,11 +161,37 @@ callback_data_t;
  */
 
 /* Callbacks */
-static bool_t dict_used_callback( const tstree_node_t node,
-				  callback_data_t *data );
 static bool_t dict_string_callback( const tstree_node_t node,
 				    callback_data_t *data );
 
+/* Lecture concurrente */
+static bool_t dict_publish( dict_t dict, dict_change_t change,
+			    const char *word, unsigned int count );
+static void   dict_readers_wait( dict_readers_t readers );
+static bool_t dict_change_add( tstree_t tree, const char *word,
+			       unsigned int count );
+static bool_t dict_change_rebalance( tstree_t tree, const char *word,
+				     unsigned int count );
+static bool_t dict_change_compact( tstree_t tree, const char *word,
+				   unsigned int count );
+
+/* Dcoupage d'une chane entre plusieurs threads */
+static bool_t dict_add_chunks( dict_t dict, char *string );
+static void   dict_chunk_add( void *data );
+static bool_t dict_add_word( char *word, unsigned int length, void *data );
+
+/* Lecture et criture en flux */
+static int          dict_read_number( const char *chunk, unsigned int size,
+				      unsigned int *pos, unsigned int *value );
+static unsigned int dict_add_records( dict_t dict, dict_records_t *records,
+				      char *chunk, unsigned int size,
+				      bool_t *result );
+static bool_t       dict_add_prefixed( dict_records_t *records,
+				       const char *suffix, unsigned int shared,
+				       unsigned int count );
+static bool_t       dict_write_words( const dict_t dict,
+				      huffman_writer_t writer, char *chunk );
+
 
 /*****************************************************************************
  *
@@ -95,6 +209,10 @@ dict_t dict_new( void )
 
     /* Initialisation de l'arbre */
     if (dict) {
+	dict->readers = NULL;
+	dict->threads = DEFAULT_THREADS;
+	dict->pool    = NULL;
+	dict->compact = FALSE;
 	if ((dict->tree = tstree_new()))
 	    return dict;
 	free( dict );
@@ -113,6 +231,10 @@ void dict_delete( dict_t dict )
     assert( dict );
 
     /* Libration de la mmoire */
+    if (dict->readers)
+	dict_end_readers( dict );
+    if (dict->pool)
+	pool_delete( dict->pool );
     tstree_delete( dict->tree );
     free( dict );
 }
@@ -121,6 +243,57 @@ void dict_delete( dict_t dict )
  * Ajoute un mot au dictionnaire.
  */
 bool_t dict_add( dict_t dict, char *word )
+{
+    return dict_add_count( dict, word, 1 );
+}
+
+/**
+ * Ajoute `count' occurences d'un mot au dictionnaire.
+ */
+bool_t dict_add_count( dict_t dict, char *word, unsigned int count )
+{
+    /* Variables locales */
+    int i; /* Compteur */
+
+    /* Contrle des paramtres */
+    assert( dict );
+    assert( word );
+    assert( count != 0 );
+
+    /* Il faut un mot d'au moins deux caractres */
+    if (word[0] == '\0' || word[1] == '\0')
+	return FALSE;
+
+    /* Conversion en minuscules */
+    for (i = 0; word[i]; i++)
+	if (IS_UPPER_CASE( word[i] ))
+	    word[i] = UPPER_TO_LOWER_CASE( word[i] );
+
+    /* Ajout du mot,  chaque copie en lecture concurrente */
+    if (dict->readers)
+	return dict_publish( dict, dict_change_add, word, count );
+    return tstree_add_key_count( dict->tree, word, count ) ? TRUE : FALSE;
+}
+
+/**
+ * Passe le dictionnaire en mode d'ajouts concurrents : jusqu' l'appel de
+ * dict_end_concurrent(), seule dict_add_concurrent() peut tre appele,
+ * depuis plusieurs threads  la fois.
+ */
+bool_t dict_begin_concurrent( dict_t dict )
+{
+    /* Contrle des paramtres */
+    assert( dict );
+    assert( !dict->readers );
+
+    return tstree_begin_concurrent( dict->tree );
+}
+
+/**
+ * Ajoute `count' occurences d'un mot au dictionnaire en mode d'ajouts
+ * concurrents.
+ */
+bool_t dict_add_concurrent( dict_t dict, char *word, unsigned int count )
 {
     /* Variables locales */
     int i; /* Compteur */
@@ -128,6 +301,7 @@ bool_t dict_add( dict_t dict, char *word )
     /* Contrle des paramtres */
     assert( dict );
     assert( word );
+    assert( count != 0 );
 
     /* Il faut un mot d'au moins deux caractres */
     if (word[0] == '\0' || word[1] == '\0')
@@ -139,7 +313,76 @@ bool_t dict_add( dict_t dict, char *word )
 	    word[i] = UPPER_TO_LOWER_CASE( word[i] );
 
     /* Ajout du mot */
-    return tstree_add_key( dict->tree, word ) ? TRUE : FALSE;
+    return tstree_add_key_concurrent( dict->tree, word, count ) ? TRUE :
+	FALSE;
+}
+
+/**
+ * Termine le mode d'ajouts concurrents, une fois tous les ajouts achevs.
+ */
+void dict_end_concurrent( dict_t dict )
+{
+    /* Contrle des paramtres */
+    assert( dict );
+
+    tstree_end_concurrent( dict->tree );
+}
+
+/**
+ * Passe le dictionnaire en mode de lecture concurrente : un seul thread,
+ * l'crivain, peut ajouter des mots ou rorganiser le dictionnaire par
+ * dict_add(), dict_add_count(), dict_rebalance() et dict_compact(), tandis
+ * que d'autres appellent dict_get_most_used() sans jamais tre bloqus.
+ * L'arbre est doubl : chaque modification est faite sur la copie que les
+ * lecteurs ne parcourent pas, qui leur est alors livre, puis, une fois
+ * sortis de l'autre tous les lecteurs de l'poque prcdente, sur celle-ci.
+ * La mmoire libre par une rorganisation ne l'est donc qu'une fois
+ * qu'aucun lecteur ne peut plus y accder.
+ */
+bool_t dict_begin_readers( dict_t dict )
+{
+    /* Variables locales */
+    dict_readers_t readers; /* tat de la lecture concurrente */
+
+    /* Contrle des paramtres */
+    assert( dict );
+    assert( !dict->readers );
+
+    /* Les recherches ne doivent plus reconstruire les listes en cache */
+    if (!tstree_update_cache( dict->tree ) ||
+	!(readers = malloc( sizeof (dict_readers_s_t) )))
+	return FALSE;
+    if (!(readers->trees[1] = tstree_clone( dict->tree ))) {
+	free( readers );
+	return FALSE;
+    }
+
+    readers->trees[0]      = dict->tree;
+    readers->active        = 0;
+    readers->epoch         = 0;
+    readers->arrivals[0]   = 0;
+    readers->arrivals[1]   = 0;
+    readers->departures[0] = 0;
+    readers->departures[1] = 0;
+    readers->stale         = FALSE;
+    dict->readers          = readers;
+    return TRUE;
+}
+
+/**
+ * Termine le mode de lecture concurrente, une fois tous les lecteurs
+ * arrts.
+ */
+void dict_end_readers( dict_t dict )
+{
+    /* Contrle des paramtres */
+    assert( dict );
+    assert( dict->readers );
+
+    dict->tree = dict->readers->trees[dict->readers->active];
+    tstree_delete( dict->readers->trees[1 - dict->readers->active] );
+    free( dict->readers );
+    dict->readers = NULL;
 }
 
 /**
@@ -149,10 +392,15 @@ char **dict_get_most_used( const dict_t dict, char *word,
 			   unsigned int number )
 {
     /* Variables locales */
-    unsigned int    i;        /* Compteur                         */
-    char            *pos;     /* Position courante dans le tampon */
-    char            **result; /* Rsultat : tableau de chanes    */
-    callback_data_t data;     /* Donnes pour le callback         */
+    unsigned int   i;        /* Compteur                         */
+    unsigned int   found;    /* Nombre de mots trouvs           */
+    unsigned int   size;     /* Taille totale des mots           */
+    unsigned int   epoch;    /* poque d'arrive du lecteur      */
+    char           *pos;     /* Position courante dans le tampon */
+    char           **result; /* Rsultat : tableau de chanes    */
+    tstree_node_t  *nodes;   /* Noeuds des mots trouvs          */
+    tstree_t       tree;     /* Arbre parcouru                   */
+    dict_readers_t readers;  /* Lecture concurrente              */
 
     /* Contrle des paramtres */
     assert( dict );
@@ -165,39 +413,55 @@ char **dict_get_most_used( const dict_t dict, char *word,
     } else
 	word = "";
 
+    /* En lecture concurrente, entre dans l'poque courante puis choix de
+     * la copie active, que l'crivain ne touchera pas avant la sortie */
+    readers = dict->readers;
+    epoch   = 0;
+    if (readers) {
+	epoch = __atomic_load_n( &readers->epoch, __ATOMIC_SEQ_CST ) & 1;
+	__atomic_fetch_add( readers->arrivals + epoch, 1, __ATOMIC_SEQ_CST );
+	tree = readers->trees[__atomic_load_n( &readers->active,
+					       __ATOMIC_SEQ_CST )];
+    } else
+	tree = dict->tree;
+
     /* Nombre maximal de mots  trouver */
     if (number == 0)
-	number = tstree_get_key_number( dict->tree ) + 1;
+	number = tstree_get_key_number( tree ) + 1;
 
     /* Allocation du tableau de mots */
-    if (!(data.nodes = malloc( number * sizeof (tstree_node_t) )))
+    result = NULL;
+    if (!(nodes = malloc( number * sizeof (tstree_node_t) ))) {
+	if (readers)
+	    __atomic_fetch_add( readers->departures + epoch, 1,
+				__ATOMIC_SEQ_CST );
 	return NULL;
-
-    /* Initialisation des donnes */
-    result        = NULL;
-    data.max      = number;
-    data.size     = 0;
-    data.nodes[0] = NULL;
+    }
 
     /* Recherche des mots */
-    if (tstree_get_keys( dict->tree, word,
-			 (tstree_callback_t) dict_used_callback, &data ) &&
-	(result = malloc( number * sizeof (char *) +
-			  data.size * sizeof (char) ))) {
-	pos = (char *) (result + number);
-
-	/* Copie des mots dans le rsultat */
-	for (i = 0; i < number && data.nodes[i]; i++) {
-	    if (!tstree_node_get_key_in_buffer( data.nodes[i], pos, 0 ))
-		break;
+    found = number;
 
-	    result[i] = pos;
-	    pos += tstree_node_get_depth( data.nodes[i] ) + 1;
-	}
+    if (tstree_get_most_used( tree, word, nodes, &found )) {
+	/* Calcul de la taille ncessaire pour les mots */
+	size = 0;
+	for (i = 0; i < found; i++)
+	    size += tstree_node_get_depth( nodes[i] ) + 1;
+
+	if ((result = malloc( number * sizeof (char *) +
+			      size * sizeof (char) ))) {
+	    pos = (char *) (result + number);
+
+	    /* Copie des mots dans le rsultat */
+	    for (i = 0; i < found; i++) {
+		if (!tstree_node_get_key_in_buffer( nodes[i], pos, 0 ))
+		    break;
+
+		result[i] = pos;
+		pos += strlen( pos ) + 1;
+	    }
 
-	/* Initialisation  zro des rsultats inoccups dans le tampon */
-	if (i < number) {
-	    if (!data.nodes[i])
+	    /* Initialisation  zro des rsultats inoccups dans le tampon */
+	    if (i == found)
 		while (i < number)
 		    result[i++] = NULL;
 	    else {
@@ -207,8 +471,13 @@ char **dict_get_most_used( const dict_t dict, char *word,
 	}
     }
 
+    /* Sortie du lecteur, les mots ayant t copis */
+    if (readers)
+	__atomic_fetch_add( readers->departures + epoch, 1,
+			    __ATOMIC_SEQ_CST );
+
     /* Libration de la mmoire et retour du rsultat */
-    free( data.nodes );
+    free( nodes );
     return result;
 }
 
@@ -290,105 +559,362 @@ char *dict_get_words_into_string( const dict_t dict )
  */
 bool_t dict_add_words_from_string( dict_t dict, char *string )
 {
-    char *pos;   /* Position courante dans la chane                    */
-    char *start; /* Dbut d'un mot                                      */
-    char save;   /* Sauvegarde du caractre prcdent pour le restaurer */
+    /* Variables locales */
+    bool_t result; /* Rsultat */
 
     /* Contrle des paramtres */
     assert( dict );
     assert( string );
+    assert( !dict->readers );
+
+    /* Les listes en cache ne seront reconstruites qu'une fois les mots
+     * ajouts */
+    tstree_invalidate_cache( dict->tree );
+
+    /* Dcoupage de la chane entre plusieurs threads si demand */
+    if (dict->threads != 1) {
+	if (!dict->pool && !(dict->pool = pool_new( dict->threads )))
+	    return FALSE;
+	if (pool_get_thread_number( dict->pool ) > 1)
+	    return dict_add_chunks( dict, string );
+    }
 
-    /* Ajout des mots */
-    pos = string;
-    while (*pos != '\0') {
-	/* Saute les blancs */
-	while (!IS_ALPHA( *pos ))
-	    if (*pos != '\0')
-		pos++;
-	    else
-		return TRUE;
+    /* Ajout des mots, convertis en minuscules par le dcoupage, l'arbre
+     * n'tant rorganis qu'une fois  la fin si ncessaire */
+    tstree_suspend_rebalance( dict->tree );
+    result = alpha_split( string, string + strlen( string ), dict_add_word,
+			  dict->tree );
+    return tstree_resume_rebalance( dict->tree ) && result;
+}
+
+/**
+ * Dfinit le nombre de threads entre lesquels dict_add_words_from_string()
+ * dcoupe une chane (autant que de processeurs si `threads' est nul) :
+ * chacun compte les mots de sa part dans son propre arbre, puis les arbres
+ * sont fusionns dans celui du dictionnaire. Les frquences obtenues sont
+ * les mmes qu'avec un seul thread, mais pas la forme de l'arbre.
+ */
+void dict_set_thread_number( dict_t dict, unsigned int threads )
+{
+    /* Contrle des paramtres */
+    assert( dict );
 
-	/* Parcourt les caractres */
-	start = pos++;
-	while (IS_ALPHA( *pos ))
-	    pos++;
+    /* Le groupe de threads sera recr  la demande */
+    if (dict->pool && threads != dict->threads) {
+	pool_delete( dict->pool );
+	dict->pool = NULL;
+    }
+    dict->threads = threads;
+}
 
-	/* Si on mot a t trouv */
-	if (pos > start + 1) {
-	    save = *pos;
-	    *pos = '\0';
-	    if (!dict_add( dict, start )) {
-		*pos = save;
-		return FALSE;
+/**
+ * Ajoute au dictionnaire les mots d'un fichier compress, lu en flux par
+ * morceaux. Un mot  cheval sur deux morceaux est report au suivant ; dans
+ * un fichier texte (sans en-tte), un mot plus long qu'un morceau est coup,
+ * alors qu'un enregistrement plus long est lu dans un morceau agrandi. Les
+ * mots tris d'un fichier de version 2 sont insrs au fil de la lecture,
+ * puis les frres de chaque noeud quilibrs selon la frquence des mots.
+ * Chaque morceau tant ajout ds sa lecture, un fichier tronqu ou
+ * corrompu laisse dans le dictionnaire les mots des morceaux qui prcdent
+ * l'erreur (jamais ceux dcods au-del de la fin du fichier), et la
+ * fonction retourne FALSE.
+ */
+bool_t dict_add_words_from_file( dict_t dict, const char *filename )
+{
+    /* Variables locales */
+    unsigned int     kept;     /* Caractres reports au morceau suivant */
+    unsigned int     size;     /* Caractres prsents dans le morceau   */
+    unsigned int     end;      /* Fin des mots complets du morceau      */
+    unsigned int     capacity; /* Taille du morceau                     */
+    int              version;  /* Version du format (-1 : inconnue)    */
+    bool_t           full;     /* Morceau rempli par la lecture         */
+    char             save;     /* Caractre remplac par le zro        */
+    char             *chunk;   /* Morceau de donnes dcompresses      */
+    char             *bigger;  /* Morceau agrandi                       */
+    bool_t           result;   /* Rsultat                              */
+    dict_records_t   records;  /* tat de la lecture des enregistrements */
+    huffman_reader_t reader;   /* Objet de dcompression                */
+
+    /* Contrle des paramtres */
+    assert( dict );
+    assert( filename );
+    assert( !dict->readers );
+
+    /* Ouvre le fichier */
+    capacity = CHUNK_SIZE;
+    if (!(chunk = malloc( (capacity + 1) * sizeof (char) )))
+	return FALSE;
+    if (!(reader = huffman_reader_open( filename, NULL ))) {
+	free( chunk );
+	return FALSE;
+    }
+    records.length = 0;
+    records.size   = 0;
+    records.word   = NULL;
+    if (!(records.inserter = tstree_inserter_new( dict->tree ))) {
+	huffman_reader_close( reader );
+	free( chunk );
+	return FALSE;
+    }
+
+    /* L'arbre n'est rorganis qu'une fois tous les mots ajouts */
+    tstree_suspend_rebalance( dict->tree );
+
+    /* Ajout des mots, morceau par morceau, jusqu' ce qu'un morceau ne
+     * puisse plus tre rempli */
+    kept    = 0;
+    version = -1;
+    do {
+	size = capacity - kept;
+	if (!(result = huffman_reader_read( reader, chunk + kept, &size )))
+	    break;
+	full  = size == capacity - kept;
+	size += kept;
+
+	/* Le dbut du fichier indique son format */
+	if (version == -1) {
+	    if (size >= HEADER_SIZE &&
+		memcmp( chunk, HEADER, HEADER_SIZE - 1 ) == 0) {
+		version = (unsigned char) chunk[HEADER_SIZE - 1];
+		size   -= HEADER_SIZE;
+		memmove( chunk, chunk + HEADER_SIZE, size );
+		if (version != VERSION_COUNTS &&
+		    version != VERSION_PREFIXES) {
+		    result = FALSE;
+		    break;
+		}
+	    } else
+		version = 0;
+	}
+
+	if (version == 0) {
+	    /* Les dernires lettres d'un morceau plein peuvent tre le dbut
+	     * d'un mot qui se poursuit dans le suivant */
+	    end = size;
+	    if (full) {
+		while (end > 0 && IS_ALPHA( chunk[end - 1] ))
+		    end--;
+		if (end == 0)
+		    end = size;
 	    }
-	    *pos = save;
+
+	    /* Ajoute les mots complets */
+	    save       = chunk[end];
+	    chunk[end] = '\0';
+	    result     = dict_add_words_from_string( dict, chunk );
+	    chunk[end] = save;
+	} else {
+	    records.version = version;
+	    end = dict_add_records( dict, &records, chunk, size, &result );
 	}
-    }
 
-    /* Pas d'erreur */
-    return TRUE;
-}
+	/* Reporte les autres caractres */
+	kept = size - end;
+	memmove( chunk, chunk + end, kept );
 
+	/* Agrandit le morceau s'il ne contient qu'un dbut d'enregistrement */
+	if (result && full && kept == capacity) {
+	    if (!(bigger = realloc( chunk, (2 * capacity + 1) *
+				    sizeof (char) ))) {
+		result = FALSE;
+		break;
+	    }
+	    chunk     = bigger;
+	    capacity *= 2;
+	}
+    } while (result && full);
 
-/*****************************************************************************
- *
- * FONCTIONS STATIQUES
- *
+    /* Un enregistrement tronqu est une erreur */
+    if (result && kept != 0 && version > 0)
+	result = FALSE;
+
+    /* Les mots tris ont t insrs en chanes de frres */
+    if (result && version == VERSION_PREFIXES)
+	result = tstree_rebalance( dict->tree );
+    if (!tstree_resume_rebalance( dict->tree ))
+	result = FALSE;
+
+    /* Compactage une fois le chargement termin, avec la rorganisation
+     * automatique */
+    if (result && dict->compact)
+	result = tstree_compact( dict->tree );
+
+    /* Libration de la mmoire */
+    huffman_reader_close( reader );
+    tstree_inserter_delete( records.inserter );
+    free( records.word );
+    free( chunk );
+    return result;
+}
+
+/**
+ * Ajoute au dictionnaire tous les mots d'un autre dictionnaire, avec leurs
+ * frquences, sans repasser par une chane de caractres : seules les
+ * lettres absentes du dictionnaire y sont recopies.
  */
+bool_t dict_merge( dict_t dict, const dict_t other )
+{
+    /* Contrle des paramtres */
+    assert( dict );
+    assert( other );
+    assert( !dict->readers );
+
+    return tstree_merge( dict->tree, other->tree );
+}
 
 /**
- * Callback utilis pour la dcouverte des mots.
+ * Enregistre le dictionnaire dans un fichier compress, crit en flux par
+ * morceaux : la mmoire utilise ne dpend pas de la taille du
+ * dictionnaire. Chaque mot n'est crit qu'une fois, suivi de sa frquence,
+ * et seulement  partir de son premier caractre diffrent du prcdent.
  */
-static bool_t dict_used_callback( const tstree_node_t node,
-				  callback_data_t *data )
+bool_t dict_write_words_to_file( const dict_t dict, const char *filename )
 {
     /* Variables locales */
-    unsigned int i, j;  /* Compteurs          */
-    unsigned int count; /* Frquence d'un mot */
+    char             *chunk; /* Morceau de donnes  compresser */
+    bool_t           result; /* Rsultat                        */
+    huffman_writer_t writer; /* Objet de compression            */
 
     /* Contrle des paramtres */
-    assert( node );
-    assert( data );
+    assert( dict );
+    assert( filename );
 
-    /* Calcul du nombre d'occurences du mot courant */
-    count = tstree_node_get_count( node );
+    /* Allocation du morceau et cration du fichier */
+    if (!(chunk = malloc( CHUNK_SIZE * sizeof (char) )))
+	return FALSE;
+    if (!(writer = huffman_writer_open( filename ))) {
+	free( chunk );
+	return FALSE;
+    }
 
-    /* Recherche d'une place pour l'insertion du mot */
-    for (i = 0; i < data->max && data->nodes[i]; i++)
-	if (tstree_node_get_count( data->nodes[i] ) < count)
-	    break;
+    /* Compression des mots */
+    result = dict_write_words( dict, writer, chunk );
+    result = huffman_writer_close( writer ) && result;
 
-    /* Dcalage des propositions suivantes et insertion du mot courant */
-    if (i < data->max) {
-	if (data->nodes[i]) {
-	    j = i + 1;
-	    while (j < data->max && data->nodes[j])
-		j++;
+    /* Libration de la mmoire */
+    free( chunk );
+    return result;
+}
 
-	    if (j == data->max) {
-		data->size -= tstree_node_get_depth( data->nodes[--j] ) + 1;
-		j--;
-	    } else if (j + 1 == data->max)
-		j--;
+/**
+ * Obtient la quantit de mmoire rserve et utilise par le dictionnaire.
+ */
+void dict_get_memory_usage( const dict_t dict, unsigned long *reserved,
+			    unsigned long *used )
+{
+    /* Variables locales */
+    unsigned long copy_reserved; /* Mmoire rserve par l'autre copie */
+    unsigned long copy_used;     /* Mmoire utilise par l'autre copie */
 
-	    do {
-		data->nodes[j + 1] = data->nodes[j];
+    /* Contrle des paramtres */
+    assert( dict );
 
-		if (j == 0)
-		    break;
-		j--;
-	    } while (j >= i);
-	} else if (i + 1 < data->max)
-	    data->nodes[i + 1] = NULL;
+    /* Mmoire occupe par l'arbre */
+    tstree_get_memory_usage( dict->tree, reserved, used );
 
-	data->size += tstree_node_get_depth( node ) + 1;
-	data->nodes[i] = node;
+    /* et par sa copie en lecture concurrente */
+    if (dict->readers) {
+	tstree_get_memory_usage( dict->readers->trees[dict->tree ==
+						      dict->readers->trees[0]],
+				 &copy_reserved, &copy_used );
+	*reserved += copy_reserved;
+	*used     += copy_used;
     }
+}
 
-    /* Pas d'erreur */
-    return TRUE;
+/**
+ * Active la conservation des `size' mots les plus utiliss de chaque dbut
+ * de mot d'au plus `depth' lettres (toutes si `depth' est nul), ou la
+ * dsactive si `size' est nul.
+ */
+bool_t dict_set_cache( dict_t dict, unsigned int size, unsigned int depth )
+{
+    /* Contrle des paramtres */
+    assert( dict );
+    assert( !dict->readers );
+
+    return tstree_set_cache( dict->tree, size, depth );
+}
+
+/**
+ * Obtient la quantit de mmoire rserve et utilise par les listes de
+ * mots en cache.
+ */
+void dict_get_cache_memory_usage( const dict_t dict, unsigned long *reserved,
+				  unsigned long *used )
+{
+    /* Contrle des paramtres */
+    assert( dict );
+
+    /* Mmoire occupe par les listes */
+    tstree_get_cache_memory_usage( dict->tree, reserved, used );
 }
 
+/**
+ * Rquilibre les lettres possibles aprs chaque dbut de mot selon la
+ * frquence des mots qui les suivent.
+ */
+bool_t dict_rebalance( dict_t dict )
+{
+    /* Contrle des paramtres */
+    assert( dict );
+
+    if (dict->readers)
+	return dict_publish( dict, dict_change_rebalance, NULL, 0 );
+    return tstree_rebalance( dict->tree );
+}
+
+/**
+ * Range les lettres du dictionnaire d'un seul tenant, dans l'ordre de leur
+ * parcours, pour acclrer les recherches.
+ */
+bool_t dict_compact( dict_t dict )
+{
+    /* Contrle des paramtres */
+    assert( dict );
+
+    if (dict->readers)
+	return dict_publish( dict, dict_change_compact, NULL, 0 );
+    return tstree_compact( dict->tree );
+}
+
+/**
+ * Active le rquilibrage automatique aprs au moins `interval' mots
+ * ajouts et autant que de mots dans le dictionnaire, ou le dsactive si
+ * `interval' est nul. Les mots d'une chane ou d'un fichier ne le
+ * dclenchent qu'une fois tous ajouts ; le dictionnaire est de plus
+ * compact  la fin de la lecture d'un fichier.
+ */
+void dict_set_rebalance( dict_t dict, unsigned int interval )
+{
+    /* Contrle des paramtres */
+    assert( dict );
+    assert( !dict->readers );
+
+    tstree_set_rebalance( dict->tree, interval );
+    dict->compact = interval != 0;
+}
+
+/**
+ * Obtient le nombre moyen (selon la frquence des mots) et maximal de
+ * lettres compares sans correspondre lors de la recherche d'un mot.
+ */
+bool_t dict_get_balance( const dict_t dict, double *average,
+			 unsigned int *maximum )
+{
+    /* Contrle des paramtres */
+    assert( dict );
+
+    return tstree_get_balance( dict->tree, average, maximum );
+}
+
+
+/*****************************************************************************
+ *
+ * FONCTIONS STATIQUES
+ *
+ */
+
 /**
  * Callback utilis pour la conversion du dictionnaire en chane.
  */
@@ -408,4 +934,480 @@ static bool_t dict_string_callback( const tstree_node_t node,
     return TRUE;
 }
 
+/**
+ * Dcoupe une chane entre les threads du dictionnaire, chaque part se
+ * terminant aprs un sparateur pour que la fin de ses mots ne soit pas lue
+ * par la suivante, puis fusionne les mots compts par chacun.
+ */
+static bool_t dict_add_chunks( dict_t dict, char *string )
+{
+    /* Variables locales */
+    unsigned int i;      /* Compteur                */
+    unsigned int number; /* Nombre de parts         */
+    size_t       length; /* Longueur de la chane   */
+    char         *pos;   /* Limite entre deux parts */
+    bool_t       ok;     /* Pas d'erreur            */
+    dict_chunk_t chunks; /* Parts des threads       */
+
+    /* Contrle des paramtres */
+    assert( dict );
+    assert( dict->pool );
+    assert( string );
+
+    number = pool_get_thread_number( dict->pool );
+    if (!(chunks = malloc( number * sizeof (dict_chunk_s_t) )))
+	return FALSE;
+
+    /* Dcoupage de la chane */
+    length = strlen( string );
+    pos    = string;
+    for (i = 0; i < number; i++) {
+	chunks[i].tree  = NULL;
+	chunks[i].start = pos;
+	if (i + 1 < number) {
+	    if (string + length * (i + 1) / number > pos)
+		pos = string + length * (i + 1) / number;
+	    while (IS_ALPHA( *pos ))
+		pos++;
+	    if (*pos != '\0')
+		pos++;
+	} else
+	    pos = string + length;
+	chunks[i].end = pos;
+	pool_submit( dict->pool, &chunks[i].task, dict_chunk_add,
+		     chunks + i );
+    }
+
+    /* Attente des threads */
+    ok = TRUE;
+    for (i = 0; i < number; i++) {
+	pool_wait( dict->pool, &chunks[i].task );
+	ok = ok && chunks[i].ok;
+    }
+
+    /* Fusion des arbres des parts dans celui du dictionnaire */
+    for (i = 0; ok && i < number; i++)
+	ok = tstree_merge( dict->tree, chunks[i].tree );
+
+    /* Libration de la mmoire */
+    for (i = 0; i < number; i++)
+	if (chunks[i].tree)
+	    tstree_delete( chunks[i].tree );
+    free( chunks );
+    return ok;
+}
+
+/**
+ * Dcoupe en mots la part de chane confie  un thread, les convertit en
+ * minuscules et les compte dans l'arbre du thread.
+ */
+static void dict_chunk_add( void *data )
+{
+    /* Variables locales */
+    dict_chunk_t chunk = data; /* Part du thread */
+
+    chunk->ok = (chunk->tree = tstree_new()) != NULL &&
+	alpha_split( chunk->start, chunk->end, dict_add_word, chunk->tree );
+}
+
+/**
+ * Compte dans l'arbre `data' un mot trouv par alpha_split(), dj en
+ * minuscules, s'il a au moins deux lettres comme l'exige dict_add().
+ */
+static bool_t dict_add_word( char *word, unsigned int length, void *data )
+{
+    /* Variables locales */
+    char   save;   /* Caractre remplac par le zro */
+    bool_t result; /* Rsultat de l'ajout            */
+
+    /* Contrle des paramtres */
+    assert( word );
+    assert( data );
+
+    if (length < 2)
+	return TRUE;
+
+    save         = word[length];
+    word[length] = '\0';
+    result       = tstree_add_key( (tstree_t) data, word ) != NULL;
+    word[length] = save;
+    return result;
+}
+
+/**
+ * Applique une modification  la copie de l'arbre que les lecteurs ne
+ * parcourent pas, la leur livre, attend que les lecteurs de l'autre copie en
+ * soient sortis et applique enfin la mme modification  celle-ci.
+ */
+static bool_t dict_publish( dict_t dict, dict_change_t change,
+			    const char *word, unsigned int count )
+{
+    /* Variables locales */
+    unsigned int   side;    /* Copie modifie en premier */
+    tstree_t       clone;   /* Copie de remplacement     */
+    dict_readers_t readers; /* Lecture concurrente       */
+
+    /* Contrle des paramtres */
+    assert( dict );
+    assert( dict->readers );
+    assert( change );
+
+    /* Une copie inactive reste en retard lors d'une modification
+     * prcdente est d'abord remplace */
+    readers = dict->readers;
+    side    = 1 - readers->active;
+    if (readers->stale) {
+	if (!(clone = tstree_clone( readers->trees[readers->active] )))
+	    return FALSE;
+	tstree_delete( readers->trees[side] );
+	readers->trees[side] = clone;
+	readers->stale       = FALSE;
+    }
+
+    /* Modification de la copie inactive, dont les listes en cache sont
+     * reconstruites avant que les lecteurs ne la voient */
+    if (!change( readers->trees[side], word, count ))
+	return FALSE;
+    if (!tstree_update_cache( readers->trees[side] ))
+	tstree_set_cache( readers->trees[side], 0, 0 );
+
+    /* Livraison aux lecteurs */
+    __atomic_store_n( &readers->active, side, __ATOMIC_SEQ_CST );
+    dict->tree = readers->trees[side];
+    dict_readers_wait( readers );
+
+    /* Plus aucun lecteur ne parcourt l'ancienne copie */
+    side = 1 - side;
+    if (change( readers->trees[side], word, count )) {
+	if (!tstree_update_cache( readers->trees[side] ))
+	    tstree_set_cache( readers->trees[side], 0, 0 );
+	return TRUE;
+    }
+
+    /* En cas d'chec, elle est remplace par une copie de celle livre, ou
+     * le sera avant la prochaine modification : la modification dj vue
+     * par les lecteurs n'est jamais perdue */
+    if (!(clone = tstree_clone( readers->trees[1 - side] ))) {
+	readers->stale = TRUE;
+	return FALSE;
+    }
+    tstree_delete( readers->trees[side] );
+    readers->trees[side] = clone;
+    return TRUE;
+}
+
+/**
+ * Attend que tous les lecteurs entrs avant l'appel en soient sortis : ceux
+ * de l'poque suivante, restants d'un tour prcdent, puis ceux de l'poque
+ * courante une fois celle-ci change.
+ */
+static void dict_readers_wait( dict_readers_t readers )
+{
+    /* Variables locales */
+    unsigned int epoch; /* poque courante */
+
+    /* Contrle des paramtres */
+    assert( readers );
+
+    epoch = readers->epoch & 1;
+
+    /* Les sorties sont lues avant les entres : un lecteur compt sorti a
+     * forcment t compt entr */
+    while (__atomic_load_n( readers->departures + 1 - epoch,
+			    __ATOMIC_SEQ_CST ) !=
+	   __atomic_load_n( readers->arrivals + 1 - epoch, __ATOMIC_SEQ_CST ))
+	sched_yield();
+
+    __atomic_fetch_add( &readers->epoch, 1, __ATOMIC_SEQ_CST );
+
+    while (__atomic_load_n( readers->departures + epoch,
+			    __ATOMIC_SEQ_CST ) !=
+	   __atomic_load_n( readers->arrivals + epoch, __ATOMIC_SEQ_CST ))
+	sched_yield();
+}
+
+/**
+ * Modification : ajout d'un mot.
+ */
+static bool_t dict_change_add( tstree_t tree, const char *word,
+			       unsigned int count )
+{
+    return tstree_add_key_count( tree, word, count ) ? TRUE : FALSE;
+}
+
+/**
+ * Modification : rquilibrage.
+ */
+static bool_t dict_change_rebalance( tstree_t tree, const char *word UNUSED,
+				     unsigned int count UNUSED )
+{
+    return tstree_rebalance( tree );
+}
+
+/**
+ * Modification : compactage.
+ */
+static bool_t dict_change_compact( tstree_t tree, const char *word UNUSED,
+				   unsigned int count UNUSED )
+{
+    return tstree_compact( tree );
+}
+
+/**
+ * Lit un nombre cod par groupes de 7 bits  la position `pos' d'un morceau
+ * et avance celle-ci. Retourne 1 en cas de succs, 0 si le morceau se
+ * termine avant la fin du nombre et -1 si le nombre est trop grand.
+ */
+static int dict_read_number( const char *chunk, unsigned int size,
+			     unsigned int *pos, unsigned int *value )
+{
+    /* Variables locales */
+    unsigned int  i;     /* Position dans le morceau   */
+    unsigned int  shift; /* Dcalage du groupe de bits */
+    unsigned char byte;  /* Octet courant              */
+
+    /* Contrle des paramtres */
+    assert( chunk );
+    assert( pos );
+    assert( value );
+
+    *value = 0;
+    shift  = 0;
+    i      = *pos;
+    do {
+	if (i == size)
+	    return 0;
+	byte    = (unsigned char) chunk[i++];
+	*value |= (unsigned int) (byte & 0x7f) << shift;
+	shift  += 7;
+    } while ((byte & 0x80) && shift < 7 * MAX_NUMBER_SIZE);
+
+    /* Nombre trop grand */
+    if ((byte & 0x80) || (shift == 7 * MAX_NUMBER_SIZE && byte > 0x0f))
+	return -1;
+
+    *pos = i;
+    return 1;
+}
+
+/**
+ * Ajoute au dictionnaire les enregistrements complets d'un morceau, dont le
+ * nombre de caractres est retourn ; `result' est mis  FALSE en cas
+ * d'enregistrement erron.
+ */
+static unsigned int dict_add_records( dict_t dict, dict_records_t *records,
+				      char *chunk, unsigned int size,
+				      bool_t *result )
+{
+    /* Variables locales */
+    unsigned int pos;    /* Dbut de l'enregistrement courant  */
+    unsigned int i;      /* Position dans l'enregistrement     */
+    unsigned int shared; /* Caractres communs avec le prcdent */
+    unsigned int word;   /* Dbut du mot ou de sa fin          */
+    unsigned int count;  /* Frquence du mot                   */
+    int          status; /* Rsultat de la lecture d'un nombre */
+    char         *end;   /* Fin du mot                         */
+
+    /* Contrle des paramtres */
+    assert( dict );
+    assert( records );
+    assert( chunk );
+    assert( result );
+
+    *result = TRUE;
+    for (pos = 0; pos < size; pos = i) {
+	/* Caractres communs avec le mot prcdent */
+	i      = pos;
+	shared = 0;
+	if (records->version == VERSION_PREFIXES &&
+	    (status = dict_read_number( chunk, size, &i, &shared )) != 1) {
+	    *result = status == 0;
+	    return pos;
+	}
+
+	/* Fin du mot */
+	word = i;
+	if (!(end = memchr( chunk + word, '\0', size - word )))
+	    break;
+	i = end - chunk + 1;
+
+	/* Lecture de la frquence */
+	if ((status = dict_read_number( chunk, size, &i, &count )) == 0)
+	    return pos;
+
+	/* Frquence trop grande, nulle, ou mot erron */
+	if (status == -1 || count == 0 ||
+	    !(records->version == VERSION_PREFIXES ?
+	      dict_add_prefixed( records, chunk + word, shared, count ) :
+	      dict_add_count( dict, chunk + word, count ))) {
+	    *result = FALSE;
+	    return pos;
+	}
+    }
+
+    return pos;
+}
+
+/**
+ * Ajoute au dictionnaire un mot form des `shared' premiers caractres du
+ * prcdent suivis de `suffix' ; son insertion reprend le chemin du mot
+ * prcdent.
+ */
+static bool_t dict_add_prefixed( dict_records_t *records, const char *suffix,
+				 unsigned int shared, unsigned int count )
+{
+    /* Variables locales */
+    unsigned int length; /* Longueur du mot    */
+    unsigned int size;   /* Nouvelle taille    */
+    unsigned int i;      /* Compteur           */
+    char         *word;  /* Mot agrandi        */
+
+    /* Contrle des paramtres */
+    assert( records );
+    assert( suffix );
+
+    /* Il faut un mot d'au moins deux caractres, dont le dbut est celui du
+     * prcdent */
+    length = strlen( suffix );
+    if (shared > records->length || length > UINT_MAX - 1 - shared ||
+	shared + length < 2)
+	return FALSE;
+
+    /* Agrandit le mot si ncessaire */
+    if (shared + length >= records->size) {
+	size = 2 * records->size > shared + length ? 2 * records->size :
+	    shared + length + 1;
+	if (!(word = realloc( records->word, size * sizeof (char) )))
+	    return FALSE;
+	records->word = word;
+	records->size = size;
+    }
+
+    /* Remplace la fin du mot prcdent, convertie en minuscules */
+    word = records->word;
+    for (i = 0; i <= length; i++)
+	word[shared + i] = IS_UPPER_CASE( suffix[i] ) ?
+	    UPPER_TO_LOWER_CASE( suffix[i] ) : suffix[i];
+
+    /* Ajout du mot (le mot prcdent est perdu en cas d'erreur) */
+    records->length = 0;
+    if (!tstree_inserter_add( records->inserter, word, shared, count ))
+	return FALSE;
+    records->length = shared + length;
+
+    /* Pas d'erreur */
+    return TRUE;
+}
+
+/**
+ * Parcourt les mots du dictionnaire et les transmet par morceaux  l'objet
+ * de compression aprs l'en-tte, chacun prcd du nombre de caractres
+ * communs avec le prcdent et rduit aux suivants, puis suivi d'un zro et
+ * de sa frquence.
+ */
+static bool_t dict_write_words( const dict_t dict, huffman_writer_t writer,
+				char *chunk )
+{
+    /* Variables locales */
+    unsigned int    len;      /* Longueur d'un mot et de son zro    */
+    unsigned int    shared;   /* Caractres communs avec le prcdent */
+    unsigned int    count;    /* Frquence d'un mot                  */
+    unsigned int    used;     /* Caractres prsents dans le morceau */
+    unsigned int    size[2];  /* Tailles alloues pour les mots      */
+    unsigned int    i;        /* Compteur                            */
+    char            *word[2]; /* Mot courant et mot prcdent        */
+    char            *swap;    /* change des mots                    */
+    bool_t          result;   /* Rsultat                            */
+    tstree_node_t   node;     /* Noeud du mot courant                */
+    tstree_cursor_t cursor;   /* Curseur sur les mots                */
+
+    /* Contrle des paramtres */
+    assert( dict );
+    assert( writer );
+    assert( chunk );
+
+    /* Parcours des mots */
+    if (!(cursor = tstree_cursor_new( dict->tree, NULL )))
+	return FALSE;
+
+    memcpy( chunk, HEADER, HEADER_SIZE - 1 );
+    chunk[HEADER_SIZE - 1] = VERSION_PREFIXES;
+
+    result  = TRUE;
+    used    = HEADER_SIZE;
+    word[0] = word[1] = NULL;
+    size[0] = size[1] = 0;
+    len     = 0;
+    while (result && (node = tstree_cursor_next( cursor ))) {
+	/* Le mot courant devient le prcdent */
+	swap    = word[0];
+	word[0] = word[1];
+	word[1] = swap;
+	i       = size[0];
+	size[0] = size[1];
+	size[1] = i;
+
+	/* Obtient le mot et le compare au prcdent, de longueur `len' */
+	shared = len;
+	len    = tstree_node_get_depth( node ) + 1;
+	count  = tstree_node_get_count( node );
+	if (len > size[1]) {
+	    if (!(swap = realloc( word[1], len * sizeof (char) ))) {
+		result = FALSE;
+		break;
+	    }
+	    word[1] = swap;
+	    size[1] = len;
+	}
+	tstree_node_get_key_in_buffer( node, word[1], len );
+	for (i = 0; i < shared && word[0][i] == word[1][i]; i++)
+	    ;
+	shared = i;
+
+	/* Vide le morceau si l'enregistrement n'y tient pas */
+	if (used + 2 * MAX_NUMBER_SIZE + len - shared > CHUNK_SIZE) {
+	    result = huffman_writer_write( writer, chunk, used );
+	    used   = 0;
+	}
+
+	/* Ajoute le nombre de caractres communs, 7 bits par octet */
+	while (shared >= 0x80) {
+	    chunk[used++] = (char) ((shared & 0x7f) | 0x80);
+	    shared      >>= 7;
+	}
+	chunk[used++] = (char) shared;
+	shared        = i;
+
+	/* Copie la fin du mot et son zro, ou l'crit directement si elle
+	 * est plus longue qu'un morceau (cas trs particulier) */
+	if (2 * MAX_NUMBER_SIZE + len - shared > CHUNK_SIZE) {
+	    result = result && huffman_writer_write( writer, chunk, used ) &&
+		huffman_writer_write( writer, word[1] + shared,
+				      len - shared );
+	    used   = 0;
+	} else {
+	    memcpy( chunk + used, word[1] + shared, len - shared );
+	    used += len - shared;
+	}
+
+	/* Ajoute la frquence, 7 bits par octet */
+	while (count >= 0x80) {
+	    chunk[used++] = (char) ((count & 0x7f) | 0x80);
+	    count       >>= 7;
+	}
+	chunk[used++] = (char) count;
+    }
+
+    /* Vide le dernier morceau */
+    if (result && tstree_cursor_has_failed( cursor ))
+	result = FALSE;
+    if (result && used != 0)
+	result = huffman_writer_write( writer, chunk, used );
+
+    free( word[0] );
+    free( word[1] );
+    tstree_cursor_delete( cursor );
+    return result;
+}
+
 /* Fin du fichier */
@@ -56,10 +56,31 @@ typedef struct dict *dict_t; /* Objet dictionnaire */
 dict_t dict_new( void );
 void   dict_delete( dict_t dict );
 bool_t dict_add( dict_t dict, char *word );
+bool_t dict_add_count( dict_t dict, char *word, unsigned int count );
+bool_t dict_begin_concurrent( dict_t dict );
+bool_t dict_add_concurrent( dict_t dict, char *word, unsigned int count );
+void   dict_end_concurrent( dict_t dict );
+bool_t dict_begin_readers( dict_t dict );
+void   dict_end_readers( dict_t dict );
 char **dict_get_most_used( const dict_t dict, char *word,
 			   unsigned int number );
 char  *dict_get_words_into_string( const dict_t dict );
 bool_t dict_add_words_from_string( dict_t dict, char *string );
+void   dict_set_thread_number( dict_t dict, unsigned int threads );
+bool_t dict_add_words_from_file( dict_t dict, const char *filename );
+bool_t dict_merge( dict_t dict, const dict_t other );
+bool_t dict_write_words_to_file( const dict_t dict, const char *filename );
+void   dict_get_memory_usage( const dict_t dict, unsigned long *reserved,
+			      unsigned long *used );
+bool_t dict_set_cache( dict_t dict, unsigned int size, unsigned int depth );
+void   dict_get_cache_memory_usage( const dict_t dict,
+				    unsigned long *reserved,
+				    unsigned long *used );
+bool_t dict_rebalance( dict_t dict );
+bool_t dict_compact( dict_t dict );
+void   dict_set_rebalance( dict_t dict, unsigned int interval );
+bool_t dict_get_balance( const dict_t dict, double *average,
+			 unsigned int *maximum );
 
 
 /* Traitement spcial si utilisation dans un programme C++ (fin) */
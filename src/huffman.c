@@ -8,8 +8,10 @@
  *
  * Fichier     : huffman.c
  *
- * Description : Deux fonctions permettant la lecture et l'criture de
- *               fichiers compresss avec l'algorithme de Huffman.
+ * Description : Fonctions permettant la lecture et l'criture de fichiers
+ *               compresss avec l'algorithme de Huffman, d'un coup ou en
+ *               flux, morceau par morceau. Les donnes sont dcoupes en
+ *               blocs compresss indpendamment, en parallle.
  *
  * Commentaire : La fonction de compression (criture) utilise trois fonctions
  *               statiques permettant de grer une queue de priorit de faon
@@ -35,8 +37,12 @@
  */
 
 
+/* Options de compilation (pour pread() et pwrite()) */
+#define _XOPEN_SOURCE 500
+
 /* En-ttes standard */
 #include <stdlib.h>
+#include <stdint.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <string.h>
@@ -47,6 +53,7 @@
 /* En-ttes locaux */
 #include "bool.h"
 #include "huffman.h"
+#include "pool.h"
 
 
 /*****************************************************************************
@@ -61,20 +68,67 @@
 /* Nombre maximum de noeuds dans l'arbre de Huffman */
 #define NUM_NODES (2 * NUM_CHARS - 1) /* 511 */
 
-/* Taille du tampon pour les oprations de lecture et criture de fichier */
+/* Taille du tampon pour la lecture de fichier */
 #define BUFFER_SIZE 1024 /* 1 Ko */
 
-/* En-tte du fichier compress */
-#define HEADER0 'H'
-#define HEADER1 'U'
-#define HEADER2 'F'
-#define HEADER3 'F'
+/* Nombre de bits lus d'un coup par la table principale de dcodage, puis
+ * au plus par chacune des tables secondaires (codes plus longs) */
+#define TABLE_BITS    11
+#define SUBTABLE_BITS 6
+
+/* Nombre minimum de bits prsents dans le tampon de lecture aprs son
+ * remplissage (sauf en fin de fichier) */
+#define BIT_BUFFER_FILL 57
+
+/* En-tte du fichier compress, dont le dernier caractre indique la
+ * version du format : codes crits en entier (1), canoniques (2), ou
+ * canoniques et propres  chaque bloc (3) */
+#define HEADER0    'H'
+#define HEADER1    'U'
+#define HEADER2    'F'
+#define HEADER3_V1 'F'
+#define HEADER3_V2 '2'
+#define HEADER3_V3 '3'
+
+/* Taille de l'en-tte de la version 3 : signature, taille des donnes sur
+ * 64 bits, nombre de blocs et position de l'index, qui suit les blocs et
+ * dont chaque lment donne la position, la taille compresse et la taille
+ * d'un bloc */
+#define HEADER_SIZE_V3 24
+#define INDEX_ENTRY    16
+
+/* Taille des blocs compresss indpendamment (tous sauf le dernier) */
+#define BLOCK_SIZE (1 << 20) /* 1 Mo */
+
+/* Taille maximale d'un bloc de `size' octets une fois compress : bornes
+ * des caractres prsents, longueurs de leurs codes, puis les codes */
+#define BLOCK_PACKED_SIZE( size ) (2 + NUM_CHARS + \
+				   ((size) * HUFFMAN_CODE_LIMIT + 7) / 8)
+
+/* Taille maximale d'un code canonique en bits */
+#define MAX_CODE_SIZE 63
+
+/* Taille maximale des codes produits lors de la compression, pour qu'un
+ * code tienne toujours dans un registre et que le dcodage ne passe que
+ * par une table secondaire au plus */
+#ifndef HUFFMAN_CODE_LIMIT
+#define HUFFMAN_CODE_LIMIT 15
+#endif /* !defined(HUFFMAN_CODE_LIMIT) */
+
+/* Deux codes runis doivent tenir dans le tampon d'criture, et tous les
+ * caractres doivent pouvoir recevoir un code */
+#if HUFFMAN_CODE_LIMIT < 8 || HUFFMAN_CODE_LIMIT > 31
+#error "HUFFMAN_CODE_LIMIT doit tre compris entre 8 et 31"
+#endif /* HUFFMAN_CODE_LIMIT < 8 || HUFFMAN_CODE_LIMIT > 31 */
 
 /* Supprime le flag de grand fichier s'il n'est pas support */
 #ifndef O_LARGEFILE
 #define O_LARGEFILE 0
 #endif /* defined(O_LARGEFILE) */
 
+/* Nombre de threads par dfaut (un par processeur) */
+#define DEFAULT_THREADS 0
+
 
 /*****************************************************************************
  *
@@ -85,34 +139,44 @@
 /* Macro permettant d'obtenir simplement la taille de la queue */
 #define PQ_SIZE( pq ) (*((unsigned int *) pq))
 
-/* Les macros suivantes ne fonctionnent que dans huffman_read() */
+/* Les macros suivantes ne fonctionnent que dans huffman_read_tree() */
 
 /* Macro permettant d'assrer la prsence d'un bit dans le tampon */
-#define GET_BIT if (rbuffer.bb_remain == 0 &&         \
-		    !rbuffer_read_byte( &rbuffer )) { \
-		    free( *buffer );                  \
-		    return FALSE;                     \
-		}
+#define GET_BIT if (rbuffer->bb_remain == 0 &&        \
+		    !rbuffer_read_byte( rbuffer )) \
+		    return FALSE;
 
 /* Macro permettant d'accder au premier bit du tampon */
-#define THE_BIT (rbuffer.byte_buffer & 1)
+#define THE_BIT (rbuffer->byte_buffer & 1)
 
 /* Macro dchargeant le premier bit du tampon */
-#define GOT_BIT { rbuffer.byte_buffer >>= 1; rbuffer.bb_remain--; }
+#define GOT_BIT { rbuffer->byte_buffer >>= 1; rbuffer->bb_remain--; }
 
 /* Macro permettant d'assurer la prsence de `number' bits dans le tampon */
-#define GET_BITS( number ) if (rbuffer.bb_remain < (number) &&   \
-			       !rbuffer_read_byte( &rbuffer )) { \
-			       free( *buffer );                  \
-			       return FALSE;                     \
-			   }
+#define GET_BITS( number ) if (rbuffer->bb_remain < (number) && \
+			       !rbuffer_read_byte( rbuffer ))  \
+			       return FALSE;
 
 /* Macro permettant d'accder aux `number' premiers bits du tampon */
-#define THE_BITS( number ) (rbuffer.byte_buffer & ((1 << (number)) - 1))
+#define THE_BITS( number ) ((unsigned int) rbuffer->byte_buffer & \
+			    ((1 << (number)) - 1))
 
 /* Macro dchargeant les `number' premiers bits du tampon */
-#define GOT_BITS( number ) { rbuffer.byte_buffer >>= (number); \
-			     rbuffer.bb_remain -= (number); }
+#define GOT_BITS( number ) { rbuffer->byte_buffer >>= (number); \
+			     rbuffer->bb_remain -= (number); }
+
+/* La macro suivante ne fonctionne que dans huffman_reader_read() */
+
+/* Macro assurant la prsence de `number' bits dans le tampon local, et
+ * sortant de la boucle courante en cas d'erreur de lecture */
+#define FILL_BITS( number ) if (remain < (number)) {          \
+				rbuffer->byte_buffer = bits;   \
+				rbuffer->bb_remain   = remain; \
+				if (!rbuffer_fill( rbuffer ))  \
+				    break;                     \
+				bits   = rbuffer->byte_buffer; \
+				remain = rbuffer->bb_remain;   \
+			    }
 
 
 /*****************************************************************************
@@ -140,41 +204,135 @@ typedef struct huffman_dnode
 }
 huffman_dnode_s_t, *huffman_dnode_t, huffman_dtree_t[NUM_NODES + 1];
 
-/* Tableau des codes associs aux caractres */
+/* lment d'une table de dcodage, associ aux premiers bits lus :
+ * count > 0 : `count' caractres dcods en `bits' bits (`first' pour le
+ *             premier)
+ * count = 0 : `bits' bits lus, la suite est  chercher dans la table
+ *             secondaire `next' de `chars[0]' bits (erreur si `bits' est
+ *             nul) */
+typedef struct huffman_entry
+{
+    unsigned char  bits;     /* Nombre de bits lus           */
+    unsigned char  first;    /* Taille du code du premier    */
+    unsigned char  count;    /* Nombre de caractres dcods */
+    unsigned char  chars[2]; /* Caractres dcods           */
+    unsigned short next;     /* Table secondaire             */
+}
+huffman_entry_s_t, *huffman_entry_t;
+
+/* Tableau des codes associs aux caractres, dont les bits sont rangs dans
+ * l'ordre d'criture (le premier bit est celui de poids faible) */
 typedef struct huffman_code
 {
-    unsigned char size;                /* Taille d'un code en bits  */
-    unsigned char bits[NUM_CHARS / 8]; /* Code, de maximum 256 bits */
+    unsigned char size; /* Taille d'un code en bits */
+    uint64_t      bits; /* Code                     */
 }
 huffman_code_s_t, *huffman_code_t, huffman_codes_t[NUM_CHARS];
 
 /* Type de donne pour la queue de priorit */
 typedef huffman_cnode_t pq_t[NUM_NODES + 1];
 
-/* Tampon de fichier pour la lecture */
+/* Tampon de lecture, d'un fichier ou d'un bloc dj en mmoire (`data'
+ * pointe alors sur le bloc et non sur le tampon de fichier) */
 typedef struct rbuffer
 {
-    int           fd;                       /* Descripteur de fichier     */
-    unsigned int  size;                     /* Taille des donnes         */
-    unsigned int  bb_remain;                /* Bits restants dans l'octet */
-    unsigned int  byte_buffer;              /* Tampon d'octets            */
-    unsigned int  fb_pos;                   /* Position dans le tampon    */
-    unsigned int  fb_size;                  /* Taille des donnes lues    */
-    unsigned char file_buffer[BUFFER_SIZE]; /* Tampon de fichier          */
+    int                 fd;          /* Descripteur de fichier     */
+    uint64_t            size;        /* Taille des donnes         */
+    unsigned int        version;     /* Version du format          */
+    unsigned int        bb_remain;   /* Bits restants dans l'octet */
+    uint64_t            byte_buffer; /* Tampon d'octets            */
+    unsigned int        padding;     /* Bits ajouts aprs la fin  */
+    bool_t              eof;         /* Fin du fichier atteinte    */
+    unsigned int        fb_pos;      /* Position dans le tampon    */
+    unsigned int        fb_size;     /* Taille des donnes lues    */
+    const unsigned char *data;       /* Donnes lues               */
+    unsigned char       file_buffer[BUFFER_SIZE]; /* Tampon de fichier */
 }
 rbuffer_s_t, *rbuffer_t;
 
-/* Tampon de fichier pour l'criture */
+/* Tampon d'criture d'un bloc compress en mmoire */
 typedef struct wbuffer
 {
-    int           fd;                       /* Descripteur de fichier      */
-    unsigned int  bb_size;                  /* Taille du tampon d'octets   */
-    unsigned int  byte_buffer;              /* Tampon de d'octets          */
-    unsigned int  fb_size;                  /* Taille du tampon de fichier */
-    unsigned char file_buffer[BUFFER_SIZE]; /* Tampon de fichier           */
+    unsigned int  bb_size;     /* Taille du tampon d'octets  */
+    uint64_t      byte_buffer; /* Tampon de d'octets         */
+    unsigned int  fb_size;     /* Taille des donnes crites */
+    unsigned int  capacity;    /* Taille de la zone mmoire  */
+    unsigned char *data;       /* Zone mmoire               */
 }
 wbuffer_s_t, *wbuffer_t;
 
+/* lment de l'index des blocs */
+typedef struct huffman_index
+{
+    uint64_t     offset;      /* Position du bloc dans le fichier */
+    unsigned int packed_size; /* Taille du bloc compress         */
+    unsigned int size;        /* Taille des donnes du bloc       */
+}
+huffman_index_s_t, *huffman_index_t;
+
+/* Bloc compress ou dcompress par un thread */
+typedef struct huffman_block
+{
+    pool_task_s_t task;        /* Tche du groupe de threads       */
+    bool_t        pending;     /* Tche soumise, rsultat non lu   */
+    bool_t        error;       /* Erreur de dcompression          */
+    int           fd;          /* Fichier lu                       */
+    uint64_t      offset;      /* Position du bloc dans le fichier */
+    unsigned int  size;        /* Taille des donnes               */
+    unsigned int  packed_size; /* Taille des donnes compresses   */
+    unsigned char *data;       /* Donnes                          */
+    unsigned char *packed;     /* Donnes compresses              */
+}
+huffman_block_s_t, *huffman_block_t;
+
+/* Objet de compression en flux : les donnes sont accumules dans le bloc
+ * courant, dont la compression est confie au groupe de threads ds qu'il
+ * est plein ; les blocs compresss sont crits dans l'ordre */
+typedef struct huffman_writer
+{
+    int             fd;        /* Descripteur de fichier         */
+    uint64_t        size;      /* Taille des donnes reues      */
+    bool_t          error;     /* Erreur rencontre              */
+    uint64_t        offset;    /* Position du prochain bloc      */
+    unsigned int    count;     /* Nombre de blocs crits         */
+    unsigned int    allocated; /* Taille alloue pour l'index    */
+    huffman_index_t index;     /* Index des blocs crits         */
+    pool_t          pool;      /* Groupe de threads              */
+    unsigned int    number;    /* Nombre de blocs en mmoire     */
+    unsigned int    current;   /* Bloc en cours de remplissage   */
+    huffman_block_t blocks;    /* Blocs en mmoire               */
+}
+huffman_writer_s_t;
+
+/* Objet de dcompression en flux : les versions 1 et 2 sont dcodes au
+ * fur et  mesure de la lecture du fichier, les blocs de la version 3 sont
+ * dcompresss  l'avance par le groupe de threads */
+typedef struct huffman_reader
+{
+    uint64_t        read;    /* Taille des donnes dcompresses */
+    huffman_entry_t table;   /* Tables de dcodage               */
+    unsigned int    count;   /* Nombre de blocs                  */
+    huffman_index_t index;   /* Index des blocs                  */
+    pool_t          pool;    /* Groupe de threads                */
+    unsigned int    number;  /* Nombre de blocs en mmoire       */
+    unsigned int    current; /* Bloc en cours de lecture         */
+    unsigned int    pos;     /* Position dans ce bloc            */
+    bool_t          ready;   /* Bloc courant dcompress         */
+    huffman_block_t blocks;  /* Blocs en mmoire                 */
+    rbuffer_s_t     rbuffer; /* Tampon de lecture                */
+}
+huffman_reader_s_t;
+
+
+/*****************************************************************************
+ *
+ * VARIABLES GLOBALES
+ *
+ */
+
+/* Nombre de threads utiliss pour la (d)compression des blocs */
+static unsigned int huffman_threads = DEFAULT_THREADS;
+
 
 /*****************************************************************************
  *
@@ -187,19 +345,76 @@ static void            pq_init( pq_t pq );
 static void            pq_push( pq_t pq, const huffman_cnode_t elem );
 static huffman_cnode_t pq_pop( pq_t pq );
 
+/* Compression et dcompression des blocs */
+static bool_t huffman_writer_submit( huffman_writer_t writer );
+static bool_t huffman_writer_flush( huffman_writer_t writer,
+				    huffman_block_t block );
+static bool_t huffman_reader_open_blocks( huffman_reader_t reader );
+static bool_t huffman_reader_init( huffman_reader_t reader );
+static bool_t huffman_reader_decode( huffman_reader_t reader, char *buffer,
+				     unsigned int *size );
+static void   huffman_reader_submit( huffman_reader_t reader,
+				     huffman_block_t block,
+				     unsigned int number );
+static void   huffman_block_compress( void *data );
+static void   huffman_block_decompress( void *data );
+
+/* Construction des codes */
+static void   huffman_make_codes( unsigned int freqs[4][NUM_CHARS],
+				  huffman_codes_t codes,
+				  unsigned int *first, unsigned int *last );
+static bool_t huffman_read_tree( rbuffer_t rbuffer, huffman_dtree_t tree,
+				 unsigned int *number );
+
+/* Codes canoniques */
+static int    huffman_limit_compare( const void *a, const void *b );
+static void   huffman_limit( huffman_codes_t codes,
+			     const huffman_ctree_t tree,
+			     unsigned int limit );
+static bool_t huffman_canonical( huffman_codes_t codes );
+
+/* Construction des tables de dcodage */
+static void huffman_table_heights( const huffman_dtree_t tree,
+				   unsigned int count,
+				   unsigned char *heights );
+static unsigned int huffman_table_size( const huffman_dtree_t tree,
+					const unsigned char *heights,
+					unsigned int width, int node,
+					unsigned int depth );
+static void huffman_table_build( const huffman_dtree_t tree,
+				 const unsigned char *heights,
+				 huffman_entry_t table, unsigned int *used,
+				 unsigned int base, unsigned int width,
+				 int node, unsigned int depth,
+				 unsigned int bits );
+static void huffman_table_pair( huffman_entry_t table );
+
 /* Gestion du tampon de lecture */
 static bool_t rbuffer_read_byte( rbuffer_t buffer );
+static bool_t rbuffer_fill( rbuffer_t buffer );
 static bool_t rbuffer_init( rbuffer_t buffer, const char *filename );
+static void   rbuffer_init_memory( rbuffer_t buffer,
+				   const unsigned char *data,
+				   unsigned int packed_size,
+				   unsigned int size );
 
 /* Gestion du tampon d'criture */
-static bool_t wbuffer_write( wbuffer_t buffer );
-static bool_t wbuffer_flush( wbuffer_t buffer );
-static bool_t wbuffer_finish( wbuffer_t buffer );
-static bool_t wbuffer_write_bits( wbuffer_t buffer, unsigned int data,
-				  unsigned int size );
-static bool_t wbuffer_write_code( wbuffer_t buffer, huffman_code_t code );
-static bool_t wbuffer_init( wbuffer_t buffer, const char *filename,
-			    unsigned int size );
+static void wbuffer_flush( wbuffer_t buffer );
+static void wbuffer_finish( wbuffer_t buffer );
+static void wbuffer_write_bits( wbuffer_t buffer, uint64_t data,
+				unsigned int size );
+static void wbuffer_write_codes( wbuffer_t buffer,
+				 const huffman_codes_t codes,
+				 const unsigned char *data,
+				 unsigned int size );
+static void wbuffer_init( wbuffer_t buffer, unsigned char *data,
+			  unsigned int capacity );
+
+/* Entiers cods en petit-boutiste */
+static unsigned int get_le32( const unsigned char *bytes );
+static uint64_t     get_le64( const unsigned char *bytes );
+static void         put_le32( unsigned char *bytes, unsigned int value );
+static void         put_le64( unsigned char *bytes, uint64_t value );
 
 
 /*****************************************************************************
@@ -210,157 +425,858 @@ static bool_t wbuffer_init( wbuffer_t buffer, const char *filename,
 
 /**
  * Lit un fichier et dcompresse les donnes qui s'y trouvent selon
- * l'algorithme de Huffman.
+ * l'algorithme de Huffman. Les donnes sont suivies d'un zro terminal, qui
+ * n'est pas compt dans leur taille.
  */
 bool_t huffman_read( const char *filename, char **buffer, unsigned int *size )
 {
     /* Variables locales */
-    unsigned int    i, j;      /* Compteurs                     */
-    unsigned int    code_size; /* Taille du code courant        */
-    int             pos;       /* Position dans l'arbre         */
-    huffman_dtree_t tree;      /* Arbre de Huffman              */
-    unsigned int    count;     /* Nombre de noeuds dans l'arbre */
-    rbuffer_s_t     rbuffer;   /* Tampon de lecture             */
+    uint64_t         length; /* Taille des donnes      */
+    unsigned int     read;   /* Taille des donnes lues */
+    huffman_reader_t reader; /* Objet de dcompression  */
 
     /* Contrle des paramtres */
-    assert( filename || (!buffer && !size) );
+    assert( filename );
 
-    /* Initialise le tampon */
-    if (!rbuffer_init( &rbuffer, filename ))
+    /* Ouvre le fichier, dont les donnes doivent tenir d'un coup en
+     * mmoire */
+    if (!(reader = huffman_reader_open( filename, &length )))
 	return FALSE;
+    if (length >= (unsigned int) -1) {
+	huffman_reader_close( reader );
+	return FALSE;
+    }
 
     if (size)
-	*size = rbuffer.size;
+	*size = length;
 
     /* Si on ne veut pas des donnes, retourne */
-    if (rbuffer.size == 0)
-	return TRUE;
     if (!buffer) {
-	close( rbuffer.fd );
+	huffman_reader_close( reader );
 	return TRUE;
     }
 
     /* Alloue la mmoire ncessaire pour les donnes */
-    if (!(*buffer = malloc( rbuffer.size ))) {
+    if (!(*buffer = malloc( length + 1 ))) {
 	/* Il n'y a pas assez de mmoire disponible */
-	close( rbuffer.fd );
+	huffman_reader_close( reader );
 	return FALSE;
     }
 
-    /* Initialisation de l'arbre */
-    tree[1].children[0] = 1;
-    tree[1].children[1] = 1;
-    count = 2;
+    /* Dcompresse les donnes d'un coup */
+    read = length;
+    if (!huffman_reader_read( reader, *buffer, &read ) || read != length) {
+	huffman_reader_close( reader );
+	free( *buffer );
+	return FALSE;
+    }
+    (*buffer)[length] = '\0';
 
-    /* Construction de l'arbre */
-    for (i = 0; i < NUM_CHARS; i++) {
-	/* Obtient la longueur du code */
-	GET_BITS( 8 );
-	code_size = THE_BITS( 8 );
-	GOT_BITS( 8 );
+    /* Pas d'erreur */
+    huffman_reader_close( reader );
+    return TRUE;
+}
 
-	/* Si le caractre a un code */
-	if (code_size != 0) {
-	    /* Calcule la position dans l'arbre */
-	    pos = 1;
-	    for (j = 1; j < code_size; j++) {
-		GET_BIT;
-		if (tree[pos].children[THE_BIT] <= 1) {
-		    /* Cre un noeud */
-		    tree[pos].children[THE_BIT] = count;
-		    if ((pos = count++) == NUM_NODES + 1) {
-			close( rbuffer.fd );
-			free( *buffer );
-			return FALSE;
-		    }
-		    tree[pos].children[0] = 1;
-		    tree[pos].children[1] = 1;
-		} else
-		    pos = tree[pos].children[THE_BIT];
-		GOT_BIT;
+/**
+ * Compresse des donnes selon l'algorithme de Huffman et les crit dans un
+ * fichier.
+ */
+bool_t huffman_write( const char *filename, const char *buffer,
+		      unsigned int size )
+{
+    /* Variables locales */
+    huffman_writer_t writer; /* Objet de compression */
+
+    /* Contrle des paramtres */
+    assert( filename );
+    assert( buffer );
+
+    /* Si size vaut -1 : cas spcial d'une chane de caractres */
+    if (size == (unsigned int) -1)
+	size = strlen( buffer );
+
+    /* Compresse les donnes d'un coup */
+    if (!(writer = huffman_writer_open( filename )))
+	return FALSE;
+    huffman_writer_write( writer, buffer, size );
+
+    return huffman_writer_close( writer );
+}
+
+/**
+ * Dfinit le nombre de threads utiliss pour compresser et dcompresser les
+ * blocs (autant que de processeurs si `threads' est nul).
+ */
+void huffman_set_thread_number( unsigned int threads )
+{
+    huffman_threads = threads;
+}
+
+/**
+ * Cre un fichier et un objet de compression en flux, auquel les donnes
+ * sont fournies par morceaux de taille quelconque avec
+ * huffman_writer_write().
+ */
+huffman_writer_t huffman_writer_open( const char *filename )
+{
+    /* Variables locales */
+    unsigned char    header[HEADER_SIZE_V3]; /* En-tte provisoire   */
+    huffman_writer_t writer;                 /* Objet de compression */
+
+    /* Contrle des paramtres */
+    assert( filename );
+
+    /* Allocation de l'objet et du premier bloc ; les autres ne le sont
+     * qu'une fois celui-ci rempli */
+    if (!(writer = malloc( sizeof (huffman_writer_s_t) )))
+	return NULL;
+    if (!(writer->blocks = malloc( sizeof (huffman_block_s_t) ))) {
+	free( writer );
+	return NULL;
+    }
+    writer->blocks->pending = FALSE;
+    writer->blocks->size    = 0;
+    writer->blocks->data    = malloc( BLOCK_SIZE );
+    writer->blocks->packed  = malloc( BLOCK_PACKED_SIZE( BLOCK_SIZE ) );
+    if (!writer->blocks->data || !writer->blocks->packed) {
+	free( writer->blocks->packed );
+	free( writer->blocks->data );
+	free( writer->blocks );
+	free( writer );
+	return NULL;
+    }
+
+    writer->size      = 0;
+    writer->error     = FALSE;
+    writer->offset    = HEADER_SIZE_V3;
+    writer->count     = 0;
+    writer->allocated = 0;
+    writer->index     = NULL;
+    writer->pool      = NULL;
+    writer->number    = 1;
+    writer->current   = 0;
+
+    /* Cre le fichier, en rservant la place de l'en-tte qui ne sera
+     * connu qu' la fin */
+    memset( header, 0, HEADER_SIZE_V3 );
+    if ((writer->fd = creat( filename, 0666 )) == -1 ||
+	write( writer->fd, header, HEADER_SIZE_V3 ) != HEADER_SIZE_V3)
+	writer->error = TRUE;
+
+    if (writer->error) {
+	huffman_writer_close( writer );
+	return NULL;
+    }
+
+    return writer;
+}
+
+/**
+ * Transmet un morceau des donnes  compresser.
+ */
+bool_t huffman_writer_write( huffman_writer_t writer, const char *buffer,
+			     unsigned int size )
+{
+    /* Variables locales */
+    unsigned int    length; /* Taille copie dans le bloc courant */
+    huffman_block_t block;  /* Bloc courant                       */
+
+    /* Contrle des paramtres */
+    assert( writer );
+    assert( buffer || size == 0 );
+
+    /* La taille totale doit tenir dans l'en-tte */
+    if (writer->error || writer->size + size < writer->size) {
+	writer->error = TRUE;
+	return FALSE;
+    }
+    writer->size += size;
+
+    /* Remplit les blocs, dont la compression commence ds qu'ils sont
+     * pleins */
+    while (size != 0) {
+	block  = writer->blocks + writer->current;
+	length = BLOCK_SIZE - block->size;
+	if (length > size)
+	    length = size;
+
+	memcpy( block->data + block->size, buffer, length );
+	block->size += length;
+	buffer      += length;
+	size        -= length;
+
+	if (block->size == BLOCK_SIZE && !huffman_writer_submit( writer )) {
+	    writer->error = TRUE;
+	    return FALSE;
+	}
+    }
+
+    /* Pas d'erreur */
+    return TRUE;
+}
+
+/**
+ * Compresse et crit les derniers blocs, puis l'index et l'en-tte, et
+ * dtruit l'objet de compression. Retourne FALSE si une erreur s'est
+ * produite depuis sa cration.
+ */
+bool_t huffman_writer_close( huffman_writer_t writer )
+{
+    /* Variables locales */
+    unsigned int    i;                      /* Compteur              */
+    unsigned char   header[HEADER_SIZE_V3]; /* En-tte               */
+    unsigned char   *index;                 /* Index sous forme brute */
+    huffman_block_t block;                  /* Bloc courant          */
+    bool_t          result;                 /* Rsultat              */
+
+    /* Contrle des paramtres */
+    assert( writer );
+
+    /* Compresse le dernier bloc, sans crer de threads pour lui seul */
+    result = !writer->error;
+    block  = writer->blocks + writer->current;
+    if (result && block->size != 0) {
+	if (writer->pool)
+	    result = huffman_writer_submit( writer );
+	else {
+	    huffman_block_compress( block );
+	    block->pending = TRUE;
+	}
+    }
+
+    /* crit les blocs restants dans l'ordre, en commenant par le plus
+     * ancien */
+    for (i = 0; result && i < writer->number; i++)
+	result = huffman_writer_flush( writer, writer->blocks +
+				       (writer->current + i) %
+				       writer->number );
+
+    /* crit l'index aprs les blocs, puis l'en-tte au dbut */
+    if (result) {
+	if (!(index = malloc( writer->count * INDEX_ENTRY + 1 )))
+	    result = FALSE;
+	else {
+	    for (i = 0; i < writer->count; i++) {
+		put_le64( index + i * INDEX_ENTRY, writer->index[i].offset );
+		put_le32( index + i * INDEX_ENTRY + 8,
+			  writer->index[i].packed_size );
+		put_le32( index + i * INDEX_ENTRY + 12,
+			  writer->index[i].size );
 	    }
+	    result = write( writer->fd, index, writer->count * INDEX_ENTRY ) ==
+		(ssize_t) (writer->count * INDEX_ENTRY);
+	    free( index );
+	}
+    }
+    if (result) {
+	header[0] = HEADER0;
+	header[1] = HEADER1;
+	header[2] = HEADER2;
+	header[3] = HEADER3_V3;
+	put_le64( header + 4, writer->size );
+	put_le32( header + 12, writer->count );
+	put_le64( header + 16, writer->offset );
+	result = pwrite( writer->fd, header, HEADER_SIZE_V3, 0 ) ==
+	    HEADER_SIZE_V3;
+    }
+    if (writer->fd != -1 && close( writer->fd ) != 0)
+	result = FALSE;
+
+    /* Attend la fin des tches en cours avant de librer la mmoire */
+    if (writer->pool)
+	pool_delete( writer->pool );
+    for (i = 0; i < writer->number; i++) {
+	free( writer->blocks[i].data );
+	free( writer->blocks[i].packed );
+    }
+    free( writer->blocks );
+    free( writer->index );
+    free( writer );
+    return result;
+}
 
-	    /* Affectation du caractre  la position courante */
-	    GET_BIT;
-	    tree[pos].children[THE_BIT] = -i;
-	    GOT_BIT;
+/**
+ * Ouvre un fichier compress pour le dcompresser en flux, morceau par
+ * morceau, avec huffman_reader_read(). La taille des donnes est place
+ * dans `size'.
+ */
+huffman_reader_t huffman_reader_open( const char *filename,
+				      uint64_t *size )
+{
+    /* Variables locales */
+    huffman_reader_t reader; /* Objet de dcompression */
+
+    /* Contrle des paramtres */
+    assert( filename );
+
+    /* Initialise le tampon */
+    if (!(reader = malloc( sizeof (huffman_reader_s_t) )))
+	return NULL;
+    if (!rbuffer_init( &reader->rbuffer, filename )) {
+	free( reader );
+	return NULL;
+    }
+    reader->read   = 0;
+    reader->table  = NULL;
+    reader->count  = 0;
+    reader->index  = NULL;
+    reader->pool   = NULL;
+    reader->number = 0;
+    reader->blocks = NULL;
+
+    if (size)
+	*size = reader->rbuffer.size;
+
+    /* Lecture de l'index des blocs, ou construction des tables de
+     * dcodage  partir de l'arbre */
+    if (reader->rbuffer.version == 3 ?
+	!huffman_reader_open_blocks( reader ) :
+	!huffman_reader_init( reader )) {
+	huffman_reader_close( reader );
+	return NULL;
+    }
+
+    return reader;
+}
+
+/**
+ * Dcompresse la suite des donnes dans `buffer', dont la taille est donne
+ * par `size' ; celui-ci reoit le nombre de caractres dcompresss, qui ne
+ * lui est infrieur qu'une fois la fin des donnes atteinte (il est alors
+ * nul). Des donnes qui dpassent la fin du fichier sont une erreur ds le
+ * morceau concern.
+ */
+bool_t huffman_reader_read( huffman_reader_t reader, char *buffer,
+			    unsigned int *size )
+{
+    /* Variables locales */
+    unsigned int    i;      /* Compteur                       */
+    unsigned int    limit;  /* Nombre de caractres  copier  */
+    unsigned int    length; /* Taille copie depuis un bloc   */
+    huffman_block_t block;  /* Bloc courant                   */
+
+    /* Contrle des paramtres */
+    assert( reader );
+    assert( size );
+    assert( buffer || *size == 0 );
+
+    /* Versions 1 et 2 : dcodage direct du fichier */
+    if (reader->rbuffer.version != 3)
+	return huffman_reader_decode( reader, buffer, size );
+
+    /* Nombre de caractres restant, au plus la taille du tampon */
+    limit = *size;
+    if (reader->rbuffer.size - reader->read < limit)
+	limit = reader->rbuffer.size - reader->read;
+
+    /* Copie des blocs dcompresss, chacun tant remplac ds qu'il est
+     * puis par le bloc qui le suit de `number' blocs */
+    for (i = 0; i < limit; ) {
+	block = reader->blocks + reader->current % reader->number;
+	if (!reader->ready) {
+	    pool_wait( reader->pool, &block->task );
+	    if (block->error)
+		break;
+	    reader->ready = TRUE;
+	    reader->pos   = 0;
+	}
+
+	length = block->size - reader->pos;
+	if (length > limit - i)
+	    length = limit - i;
+	memcpy( buffer + i, block->data + reader->pos, length );
+	reader->pos += length;
+	i           += length;
+
+	if (reader->pos == block->size) {
+	    if (reader->current + reader->number < reader->count)
+		huffman_reader_submit( reader, block,
+				       reader->current + reader->number );
+	    reader->current++;
+	    reader->ready = FALSE;
 	}
     }
+    reader->read += i;
+    *size         = i;
+
+    return i == limit;
+}
+
+/**
+ * Ferme le fichier et dtruit l'objet de dcompression.
+ */
+void huffman_reader_close( huffman_reader_t reader )
+{
+    /* Variables locales */
+    unsigned int i; /* Compteur */
+
+    /* Contrle des paramtres */
+    assert( reader );
+
+    /* Attend la fin des tches en cours, qui lisent le fichier */
+    if (reader->pool)
+	pool_delete( reader->pool );
+
+    /* Ferme le fichier (sauf en cas d'erreur de lecture, qui l'a dj
+     * ferm) et libre la mmoire */
+    if (reader->rbuffer.fd != -1)
+	close( reader->rbuffer.fd );
+    for (i = 0; i < reader->number; i++) {
+	free( reader->blocks[i].data );
+	free( reader->blocks[i].packed );
+    }
+    free( reader->blocks );
+    free( reader->index );
+    free( reader->table );
+    free( reader );
+}
 
-    /* Lecture des donnes */
-    for (i = 0; i < rbuffer.size; i++) {
-	/* Initialise la position  la racine de l'arbre */
-	pos = 1;
 
-	/* Calcule la position dans l'arbre */
-	do {
-	    GET_BIT;
-	    pos = tree[pos].children[THE_BIT];
-	    GOT_BIT;
+/*****************************************************************************
+ *
+ * COMPRESSION ET DCOMPRESSION DES BLOCS
+ *
+ */
 
-	    /* Retourne si le fichier est erron */
-	    if (pos == 1) {
-		close( rbuffer.fd );
-		free( *buffer );
+/**
+ * Confie la compression du bloc courant, plein ou dernier, au groupe de
+ * threads (cr au premier bloc plein), puis crit le plus ancien bloc en
+ * cours de compression pour librer sa place.
+ */
+static bool_t huffman_writer_submit( huffman_writer_t writer )
+{
+    /* Variables locales */
+    unsigned int    number; /* Nombre de blocs en mmoire */
+    huffman_block_t blocks; /* Blocs rallous            */
+    huffman_block_t block;  /* Bloc soumis                */
+
+    /* Contrle des paramtres */
+    assert( writer );
+
+    /* Cration des threads, et d'un bloc de plus qu'il n'y a de threads
+     * pour que le remplissage continue pendant la compression */
+    if (!writer->pool) {
+	if (!(writer->pool = pool_new( huffman_threads )))
+	    return FALSE;
+	number = pool_get_thread_number( writer->pool ) + 1;
+	if (!(blocks = realloc( writer->blocks,
+				number * sizeof (huffman_block_s_t) )))
+	    return FALSE;
+	writer->blocks = blocks;
+	while (writer->number < number) {
+	    block          = blocks + writer->number;
+	    block->pending = FALSE;
+	    block->size    = 0;
+	    block->data    = malloc( BLOCK_SIZE );
+	    block->packed  = malloc( BLOCK_PACKED_SIZE( BLOCK_SIZE ) );
+	    writer->number++;
+	    if (!block->data || !block->packed)
 		return FALSE;
-	    }
-	} while (pos > 0);
+	}
+    }
+
+    /* Soumission du bloc courant */
+    block          = writer->blocks + writer->current;
+    block->pending = TRUE;
+    pool_submit( writer->pool, &block->task, huffman_block_compress, block );
+
+    /* Passage au bloc suivant, le plus ancien */
+    writer->current = (writer->current + 1) % writer->number;
+    return huffman_writer_flush( writer, writer->blocks + writer->current );
+}
+
+/**
+ * Attend la fin de la compression d'un bloc s'il en a t soumis un, puis
+ * l'crit dans le fichier et l'ajoute  l'index.
+ */
+static bool_t huffman_writer_flush( huffman_writer_t writer,
+				    huffman_block_t block )
+{
+    /* Variables locales */
+    huffman_index_t index; /* Index agrandi */
+
+    /* Contrle des paramtres */
+    assert( writer );
+    assert( block );
+
+    if (!block->pending)
+	return TRUE;
+    if (writer->pool)
+	pool_wait( writer->pool, &block->task );
+    block->pending = FALSE;
+
+    /* Agrandit l'index si ncessaire */
+    if (writer->count == writer->allocated) {
+	if (!(index = realloc( writer->index, (writer->allocated + 16) *
+			       sizeof (huffman_index_s_t) )))
+	    return FALSE;
+	writer->index      = index;
+	writer->allocated += 16;
+    }
+
+    /* crit le bloc */
+    if (write( writer->fd, block->packed, block->packed_size ) !=
+	(ssize_t) block->packed_size)
+	return FALSE;
+
+    index              = writer->index + writer->count++;
+    index->offset      = writer->offset;
+    index->packed_size = block->packed_size;
+    index->size        = block->size;
+    writer->offset    += block->packed_size;
+    block->size        = 0;
+
+    /* Pas d'erreur */
+    return TRUE;
+}
+
+/**
+ * Lit et vrifie l'index des blocs (version 3), puis soumet la
+ * dcompression des premiers blocs au groupe de threads.
+ */
+static bool_t huffman_reader_open_blocks( huffman_reader_t reader )
+{
+    /* Variables locales */
+    unsigned int    i;         /* Compteur                       */
+    unsigned int    count;     /* Nombre de blocs                */
+    uint64_t        offset;    /* Position de l'index            */
+    uint64_t        position;  /* Position attendue d'un bloc    */
+    uint64_t        remain;    /* Taille des donnes restantes   */
+    unsigned int    size;      /* Taille des plus grands blocs   */
+    struct stat     status;    /* tat du fichier                */
+    unsigned char   *index;    /* Index sous forme brute         */
+    huffman_index_t entry;     /* lment courant de l'index     */
+    huffman_block_t block;     /* Bloc en mmoire                */
+    rbuffer_t       rbuffer;   /* Tampon de lecture              */
+
+    /* Contrle des paramtres */
+    assert( reader );
+    assert( reader->rbuffer.version == 3 );
+
+    /* Tous les blocs sont pleins, sauf le dernier */
+    rbuffer = &reader->rbuffer;
+    count   = get_le32( rbuffer->file_buffer + 12 );
+    offset  = get_le64( rbuffer->file_buffer + 16 );
+    if (count != rbuffer->size / BLOCK_SIZE +
+	(rbuffer->size % BLOCK_SIZE != 0))
+	return FALSE;
+
+    /* L'index termine le fichier, ce qui borne le nombre de blocs avant
+     * toute allocation */
+    if (fstat( rbuffer->fd, &status ) != 0 ||
+	offset > (uint64_t) status.st_size ||
+	(uint64_t) status.st_size - offset != (uint64_t) count * INDEX_ENTRY)
+	return FALSE;
+    if (count == 0)
+	return TRUE;
 
-	/* Stockage du caractre trouv dans le tampon */
-	(*buffer)[i] = -pos;
+    /* Lecture de l'index */
+    if (!(index = malloc( count * INDEX_ENTRY )))
+	return FALSE;
+    if (pread( rbuffer->fd, index, count * INDEX_ENTRY, (off_t) offset ) !=
+	(ssize_t) (count * INDEX_ENTRY) ||
+	!(reader->index = malloc( count * sizeof (huffman_index_s_t) ))) {
+	free( index );
+	return FALSE;
+    }
+    reader->count = count;
+
+    /* Les blocs doivent se suivre jusqu' l'index, et leurs tailles
+     * correspondre  celle des donnes */
+    position = HEADER_SIZE_V3;
+    remain   = rbuffer->size;
+    for (i = 0; i < count; i++) {
+	entry              = reader->index + i;
+	entry->offset      = get_le64( index + i * INDEX_ENTRY );
+	entry->packed_size = get_le32( index + i * INDEX_ENTRY + 8 );
+	entry->size        = get_le32( index + i * INDEX_ENTRY + 12 );
+
+	if (entry->offset != position ||
+	    entry->size != (remain < BLOCK_SIZE ? remain : BLOCK_SIZE) ||
+	    entry->packed_size > BLOCK_PACKED_SIZE( entry->size ))
+	    break;
+	position += entry->packed_size;
+	remain   -= entry->size;
+    }
+    free( index );
+    if (i != count || position != offset)
+	return FALSE;
+
+    /* Cration des threads s'il y a plusieurs blocs, et d'autant de blocs
+     * en mmoire que de threads, plus celui en cours de lecture */
+    if (!(reader->pool = pool_new( count > 1 ? huffman_threads : 1 )))
+	return FALSE;
+    reader->number = pool_get_thread_number( reader->pool ) + 1;
+    if (reader->number > count)
+	reader->number = count;
+    if (!(reader->blocks = malloc( reader->number *
+				   sizeof (huffman_block_s_t) ))) {
+	reader->number = 0;
+	return FALSE;
+    }
+    size = reader->index[0].size;
+    for (i = 0; i < reader->number; i++) {
+	block         = reader->blocks + i;
+	block->data   = malloc( size );
+	block->packed = malloc( BLOCK_PACKED_SIZE( size ) );
     }
+    for (i = 0; i < reader->number; i++)
+	if (!reader->blocks[i].data || !reader->blocks[i].packed)
+	    return FALSE;
+
+    /* Dcompression des premiers blocs */
+    reader->current = 0;
+    reader->ready   = FALSE;
+    for (i = 0; i < reader->number; i++)
+	huffman_reader_submit( reader, reader->blocks + i, i );
+
+    /* Pas d'erreur */
+    return TRUE;
+}
+
+/**
+ * Construit les tables de dcodage  partir de l'arbre lu dans le tampon
+ * (versions 1 et 2, ou bloc de la version 3).
+ */
+static bool_t huffman_reader_init( huffman_reader_t reader )
+{
+    /* Variables locales */
+    huffman_dtree_t tree;                   /* Arbre de Huffman   */
+    unsigned int    count;                  /* Nombre de noeuds   */
+    unsigned int    used;                   /* Taille des tables  */
+    unsigned char   heights[NUM_NODES + 1]; /* Hauteur des noeuds */
+
+    /* Contrle des paramtres */
+    assert( reader );
 
-    /* Ferme le fichier */
-    close( rbuffer.fd );
+    /* Aucune table n'est ncessaire si les donnes sont vides */
+    if (reader->rbuffer.size == 0)
+	return TRUE;
+
+    /* Construction des tables de dcodage  partir de l'arbre */
+    if (!huffman_read_tree( &reader->rbuffer, tree, &count ))
+	return FALSE;
+    huffman_table_heights( tree, count, heights );
+    if (!(reader->table = malloc( huffman_table_size( tree, heights,
+						      TABLE_BITS, 1, 0 ) *
+				  sizeof (huffman_entry_s_t) )))
+	return FALSE;
+    used = 1 << TABLE_BITS;
+    huffman_table_build( tree, heights, reader->table, &used, 0, TABLE_BITS,
+			 1, 0, 0 );
+    huffman_table_pair( reader->table );
 
     /* Pas d'erreur */
     return TRUE;
 }
 
 /**
- * Compresse des donnes selon l'algorithme de Huffman et les crit dans un
- * fichier.
+ * Dcode la suite des donnes du tampon de lecture dans `buffer', comme
+ * huffman_reader_read() (versions 1 et 2, ou bloc de la version 3).
+ */
+static bool_t huffman_reader_decode( huffman_reader_t reader, char *buffer,
+				     unsigned int *size )
+{
+    /* Variables locales */
+    unsigned int    i;       /* Compteur                        */
+    unsigned int    limit;   /* Nombre de caractres  dcoder  */
+    uint64_t        bits;    /* Tampon d'octets local           */
+    unsigned int    remain;  /* Bits prsents dans ce tampon    */
+    huffman_entry_t entry;   /* lment de table courant        */
+    rbuffer_t       rbuffer; /* Tampon de lecture               */
+
+    /* Contrle des paramtres */
+    assert( reader );
+    assert( size );
+    assert( buffer || *size == 0 );
+
+    /* Nombre de caractres restant, au plus la taille du tampon */
+    rbuffer = &reader->rbuffer;
+    limit   = *size;
+    if (rbuffer->size - reader->read < limit)
+	limit = rbuffer->size - reader->read;
+
+    /* Lecture des donnes : chaque consultation de la table principale
+     * dcode un ou deux caractres, les codes longs passant par les tables
+     * secondaires ; le tampon d'octets est gard dans des variables locales
+     * le temps de la boucle */
+    bits   = rbuffer->byte_buffer;
+    remain = rbuffer->bb_remain;
+    for (i = 0; i < limit; ) {
+	FILL_BITS( TABLE_BITS );
+	entry = reader->table + (bits & ((1 << TABLE_BITS) - 1));
+
+	while (entry->count == 0 && entry->bits != 0) {
+	    bits  >>= entry->bits;
+	    remain -= entry->bits;
+	    FILL_BITS( entry->chars[0] );
+	    entry = reader->table + entry->next +
+		(bits & ((1 << entry->chars[0]) - 1));
+	}
+
+	/* Code erron */
+	if (entry->count == 0)
+	    break;
+
+	/* Stockage du ou des caractres trouvs dans le tampon */
+	buffer[i++] = entry->chars[0];
+	if (entry->count == 1 || i == limit) {
+	    bits  >>= entry->first;
+	    remain -= entry->first;
+	} else {
+	    buffer[i++] = entry->chars[1];
+	    bits  >>= entry->bits;
+	    remain -= entry->bits;
+	}
+    }
+    rbuffer->byte_buffer = bits;
+    rbuffer->bb_remain   = remain;
+    reader->read        += i;
+    *size                = i;
+
+    /* Les donnes doivent tre compltes et ne pas dpasser la fin du
+     * fichier : les bits nuls ajouts aprs celle-ci ne doivent jamais tre
+     * consomms, sans attendre le dernier morceau */
+    return i == limit && rbuffer->bb_remain >= rbuffer->padding;
+}
+
+/**
+ * Soumet au groupe de threads la dcompression du bloc numro `number'
+ * dans l'emplacement `block'.
+ */
+static void huffman_reader_submit( huffman_reader_t reader,
+				   huffman_block_t block,
+				   unsigned int number )
+{
+    /* Contrle des paramtres */
+    assert( reader );
+    assert( block );
+    assert( number < reader->count );
+
+    block->fd          = reader->rbuffer.fd;
+    block->offset      = reader->index[number].offset;
+    block->packed_size = reader->index[number].packed_size;
+    block->size        = reader->index[number].size;
+    block->error       = FALSE;
+    pool_submit( reader->pool, &block->task, huffman_block_decompress,
+		 block );
+}
+
+/**
+ * Compresse un bloc (tche du groupe de threads) : statistiques, codes,
+ * table des longueurs des caractres prsents, puis les codes des
+ * caractres.
+ */
+static void huffman_block_compress( void *data )
+{
+    /* Variables locales */
+    unsigned int    i;                   /* Compteur                     */
+    unsigned int    first, last;         /* Caractres extrmes prsents */
+    unsigned int    freqs[4][NUM_CHARS]; /* Nombres d'occurences         */
+    huffman_codes_t codes;               /* Codes des caractres         */
+    wbuffer_s_t     wbuffer;             /* Tampon d'criture            */
+    huffman_block_t block = data;        /* Bloc  compresser            */
+
+    /* Contrle des paramtres */
+    assert( block );
+    assert( block->size != 0 );
+
+    /* Calcule le nombre d'occurence de chaque octet, dans quatre tables
+     * pour que des octets identiques successifs ne s'attendent pas */
+    memset( freqs, 0, sizeof (freqs) );
+    for (i = 0; i + 4 <= block->size; i += 4) {
+	freqs[0][block->data[i]]++;
+	freqs[1][block->data[i + 1]]++;
+	freqs[2][block->data[i + 2]]++;
+	freqs[3][block->data[i + 3]]++;
+    }
+    for (; i < block->size; i++)
+	freqs[0][block->data[i]]++;
+
+    /* Seules les longueurs sont ncessaires pour retrouver les codes
+     * canoniques, qui en sont dduits dans l'ordre des caractres */
+    huffman_make_codes( freqs, codes, &first, &last );
+
+    wbuffer_init( &wbuffer, block->packed, BLOCK_PACKED_SIZE( block->size ) );
+    wbuffer_write_bits( &wbuffer, first, 8 );
+    wbuffer_write_bits( &wbuffer, last, 8 );
+    for (i = first; i <= last; i++)
+	wbuffer_write_bits( &wbuffer, codes[i].size, 8 );
+    wbuffer_write_codes( &wbuffer, codes, block->data, block->size );
+    wbuffer_finish( &wbuffer );
+
+    block->packed_size = wbuffer.fb_size;
+}
+
+/**
+ * Lit et dcompresse un bloc (tche du groupe de threads).
+ */
+static void huffman_block_decompress( void *data )
+{
+    /* Variables locales */
+    unsigned int       size;          /* Taille des donnes dcodes */
+    huffman_reader_s_t reader;        /* Dcodeur du bloc            */
+    huffman_block_t    block = data;  /* Bloc  dcompresser         */
+
+    /* Contrle des paramtres */
+    assert( block );
+
+    /* Lecture du bloc compress */
+    if (pread( block->fd, block->packed, block->packed_size,
+	       (off_t) block->offset ) != (ssize_t) block->packed_size) {
+	block->error = TRUE;
+	return;
+    }
+
+    /* Dcodage du bloc comme un fichier de version 2 en mmoire */
+    rbuffer_init_memory( &reader.rbuffer, block->packed, block->packed_size,
+			 block->size );
+    reader.read  = 0;
+    reader.table = NULL;
+    size         = block->size;
+    block->error = !huffman_reader_init( &reader ) ||
+	!huffman_reader_decode( &reader, (char *) block->data, &size ) ||
+	size != block->size;
+    free( reader.table );
+}
+
+
+/*****************************************************************************
+ *
+ * CONSTRUCTION DES CODES
+ *
+ */
+
+/**
+ * Construit l'arbre de Huffman  partir des statistiques, puis en dduit
+ * les codes canoniques des caractres, dont les extrmes sont placs dans
+ * `first' et `last'.
  */
-bool_t huffman_write( const char *filename, const char *buffer,
-		      unsigned int size )
+static void huffman_make_codes( unsigned int freqs[4][NUM_CHARS],
+				huffman_codes_t codes, unsigned int *first,
+				unsigned int *last )
 {
     /* Variables locales */
     unsigned int    i;                /* Compteur                         */
     unsigned int    count;            /* Nombre de noeuds de l'arbre      */
-    unsigned int    byte;             /* Indice de l'octet dans le code   */
     signed int      cur;              /* Index du noeud courant           */
     huffman_cnode_t children[2];      /* Fils pour la cration de l'arbre */
     huffman_ctree_t tree;             /* Arbre de Huffman                 */
-    huffman_codes_t codes;            /* Codes pour l'arbre de Huffman    */
     pq_t            pq;               /* Queue de priorit                */
-    wbuffer_s_t     wbuffer;          /* Tampon d'criture                */
 
     /* Contrle des paramtres */
-    assert( filename );
-    assert( buffer );
+    assert( freqs );
+    assert( codes );
+    assert( first );
+    assert( last );
 
     /* Initialise l'arbre */
     memset( tree, 0, NUM_CHARS * sizeof (*tree) );
     count = NUM_CHARS;
 
-    /* Calcule le nombre d'occurence de chaque octet */
-    if (size != (unsigned int) -1)
-	for (i = 0; i < size; i++)
-	    tree[(int) buffer[i]].freq++;
-    else {
-	/* Si size vaut -1 : cas spcial d'une chane de caractres */
-	for (i = 0; buffer[i] != '\0'; i++)
-	    tree[(int) buffer[i]].freq++;
-	size = i;
-    }
-
-    /* Initialise le tampon de sortie */
-    if (!wbuffer_init( &wbuffer, filename, size ))
-	return FALSE;
-
-    /* Cas spcial : si la taille des donnes  compresser est nulle */
-    if (size == 0)
-	return TRUE;
+    for (i = 0; i < NUM_CHARS; i++)
+	tree[i].freq = freqs[0][i] + freqs[1][i] + freqs[2][i] +
+	    freqs[3][i];
 
     /* Initialise la queue de priorit */
     pq_init( pq );
@@ -395,42 +1311,433 @@ bool_t huffman_write( const char *filename, const char *buffer,
 	tree[count++].parent = 0;
     }
 
-    /* Dfinit le codage de chaque caractre */
+    /* Dfinit la longueur du code de chaque caractre, qui est sa
+     * profondeur dans l'arbre */
+    *first = NUM_CHARS;
+    *last  = 0;
     for (i = 0; i < NUM_CHARS; i++) {
 	/* Rien par dfaut */
 	codes[i].size = 0;
 
 	/* Si ce caractre est prsent */
 	if (tree[i].freq != 0) {
-	    /* Parcourt l'arbre jusqu' la racine pour former le code */
-	    byte = 0;
-	    cur = tree[i].parent;
-	    codes[i].bits[0] = 0;
-
-	    do {
-		codes[i].bits[byte] = (codes[i].bits[byte] << 1) |
-		    (cur >= 0 ? 0 : 1);
-		if (++codes[i].size % 8 == 0)
-		    codes[i].bits[++byte] = 0;
-
-		cur = tree[cur >= 0 ? cur : -cur].parent;
-	    } while (cur != 0);
+	    /* Remonte l'arbre jusqu' la racine */
+	    for (cur = tree[i].parent; cur != 0;
+		 cur = tree[cur >= 0 ? cur : -cur].parent)
+		codes[i].size++;
+
+	    if (*first == NUM_CHARS)
+		*first = i;
+	    *last = i;
 	}
     }
 
-    /* crit la table de codes */
-    for (i = 0; i < NUM_CHARS; i++)
-	if (!wbuffer_write_bits( &wbuffer, codes[i].size, 8 ) ||
-	    (codes[i].size && !wbuffer_write_code( &wbuffer, codes + i )))
+    /* Raccourcit les codes trop longs */
+    huffman_limit( codes, tree, HUFFMAN_CODE_LIMIT );
+
+    /* Seules les longueurs sont ncessaires pour retrouver les codes
+     * canoniques, qui en sont dduits dans l'ordre des caractres */
+    huffman_canonical( codes );
+}
+
+/**
+ * Lit les codes des caractres dans l'en-tte du fichier et construit
+ * l'arbre de dcodage correspondant, dont le nombre de noeuds est plac
+ * dans `number'.
+ */
+static bool_t huffman_read_tree( rbuffer_t rbuffer, huffman_dtree_t tree,
+				 unsigned int *number )
+{
+    /* Variables locales */
+    unsigned int    i, j;        /* Compteurs                     */
+    unsigned int    code_size;   /* Taille du code courant        */
+    unsigned int    first, last; /* Caractres extrmes prsents  */
+    int             pos;         /* Position dans l'arbre         */
+    signed short    *child;      /* Fils courant                  */
+    unsigned int    count;       /* Nombre de noeuds dans l'arbre */
+    huffman_codes_t codes;       /* Codes canoniques              */
+
+    /* Contrle des paramtres */
+    assert( rbuffer );
+    assert( tree );
+    assert( number );
+
+    /* Initialisation de l'arbre */
+    tree[1].children[0] = 1;
+    tree[1].children[1] = 1;
+    count = 2;
+
+    if (rbuffer->version == 1) {
+	/* Construction de l'arbre  partir des codes (version 1) */
+	for (i = 0; i < NUM_CHARS; i++) {
+	    /* Obtient la longueur du code */
+	    GET_BITS( 8 );
+	    code_size = THE_BITS( 8 );
+	    GOT_BITS( 8 );
+
+	    /* Si le caractre a un code */
+	    if (code_size != 0) {
+		/* Calcule la position dans l'arbre */
+		pos = 1;
+		for (j = 1; j < code_size; j++) {
+		    GET_BIT;
+		    if (tree[pos].children[THE_BIT] <= 1) {
+			/* Cre un noeud */
+			tree[pos].children[THE_BIT] = count;
+			if ((pos = count++) == NUM_NODES + 1)
+			    return FALSE;
+			tree[pos].children[0] = 1;
+			tree[pos].children[1] = 1;
+		    } else
+			pos = tree[pos].children[THE_BIT];
+		    GOT_BIT;
+		}
+
+		/* Affectation du caractre  la position courante */
+		GET_BIT;
+		tree[pos].children[THE_BIT] = -i;
+		GOT_BIT;
+	    }
+	}
+    } else {
+	/* Lecture des longueurs des codes canoniques (version 2) */
+	GET_BITS( 8 );
+	first = THE_BITS( 8 );
+	GOT_BITS( 8 );
+	GET_BITS( 8 );
+	last = THE_BITS( 8 );
+	GOT_BITS( 8 );
+
+	for (i = 0; i < NUM_CHARS; i++)
+	    codes[i].size = 0;
+	for (i = first; i <= last; i++) {
+	    GET_BITS( 8 );
+	    codes[i].size = THE_BITS( 8 );
+	    GOT_BITS( 8 );
+	}
+
+	/* Calcul des codes et construction de l'arbre */
+	if (first > last || !huffman_canonical( codes ))
 	    return FALSE;
 
-    /* crit les caractres */
-    for (i = 0; i < size; i++)
-	if (!wbuffer_write_code( &wbuffer, codes + (int) buffer[i] ))
+	for (i = first; i <= last; i++) {
+	    if (codes[i].size == 0)
+		continue;
+
+	    /* Descend dans l'arbre en crant les noeuds manquants */
+	    pos = 1;
+	    for (j = 0; j + 1 < codes[i].size; j++) {
+		child = tree[pos].children + ((codes[i].bits >> j) & 1);
+		if (*child <= 1) {
+		    *child = count;
+		    tree[count].children[0] = 1;
+		    tree[count].children[1] = 1;
+		    count++;
+		}
+		pos = *child;
+	    }
+
+	    /* Affectation du caractre  la position courante */
+	    tree[pos].children[(codes[i].bits >> j) & 1] = -(int) i;
+	}
+    }
+
+    /* Pas d'erreur */
+    *number = count;
+    return TRUE;
+}
+
+
+/*****************************************************************************
+ *
+ * CODES CANONIQUES
+ *
+ */
+
+/**
+ * Fonction de comparaison pour le tri des caractres par frquence
+ * dcroissante, les plus petits caractres d'abord en cas d'galit.
+ */
+static int huffman_limit_compare( const void *a, const void *b )
+{
+    /* Variables locales */
+    const huffman_cnode_s_t *x = *(const huffman_cnode_s_t * const *) a;
+    const huffman_cnode_s_t *y = *(const huffman_cnode_s_t * const *) b;
+
+    if (x->freq != y->freq)
+	return x->freq < y->freq ? 1 : -1;
+    return x < y ? -1 : 1;
+}
+
+/**
+ * Limite la taille des codes  `limit' bits. Les codes trop longs sont
+ * ramens  cette taille, puis des codes plus courts sont allongs jusqu'
+ * ce que les longueurs soient de nouveau celles d'un code prfixe ; les
+ * longueurs obtenues sont enfin attribues aux caractres par frquence
+ * dcroissante. Ne fait rien si aucun code ne dpasse la limite.
+ */
+static void huffman_limit( huffman_codes_t codes, const huffman_ctree_t tree,
+			   unsigned int limit )
+{
+    /* Variables locales */
+    unsigned int            i, j;          /* Compteurs                    */
+    unsigned int            number;        /* Nombre de caractres         */
+    unsigned int            counts[MAX_CODE_SIZE + 1]; /* Codes par taille */
+    uint64_t                total;         /* Somme de Kraft (en 2^-limit) */
+    const huffman_cnode_s_t *chars[NUM_CHARS]; /* Caractres prsents      */
+
+    /* Contrle des paramtres */
+    assert( codes );
+    assert( tree );
+    assert( limit >= 8 && limit <= MAX_CODE_SIZE );
+
+    /* Nombre de codes de chaque longueur, les plus longs tant ramens 
+     * la limite */
+    memset( counts, 0, sizeof (counts) );
+    number = 0;
+    for (i = 0; i < NUM_CHARS; i++)
+	if (codes[i].size != 0) {
+	    counts[codes[i].size < limit ? codes[i].size : limit]++;
+	    chars[number++] = tree + i;
+	}
+
+    /* Somme de Kraft, qui ne doit pas dpasser 1 */
+    total = 0;
+    for (i = 1; i <= limit; i++)
+	total += (uint64_t) counts[i] << (limit - i);
+    if (total <= (uint64_t) 1 << limit)
+	return;
+
+    /* Tant que la somme est trop grande, un code de taille maximale est
+     * supprim et le plus long des codes plus courts est remplac par deux
+     * codes d'un bit de plus : la somme diminue d'une unit  chaque fois */
+    while (total > (uint64_t) 1 << limit) {
+	assert( counts[limit] != 0 );
+	counts[limit]--;
+	for (i = limit - 1; i > 0; i--)
+	    if (counts[i] != 0) {
+		counts[i]--;
+		counts[i + 1] += 2;
+		break;
+	    }
+	total--;
+    }
+
+    /* Attribue les longueurs, les plus courtes aux plus frquents */
+    qsort( chars, number, sizeof (*chars), huffman_limit_compare );
+    for (i = 1, j = 0; i <= limit; i++)
+	for (; counts[i] != 0; counts[i]--)
+	    codes[chars[j++] - tree].size = i;
+}
+
+/**
+ * Calcule les codes canoniques correspondant aux longueurs donnes : les
+ * codes d'une mme longueur se suivent dans l'ordre des caractres, et les
+ * plus courts prcdent les plus longs. Retourne FALSE si les longueurs ne
+ * peuvent pas tre celles d'un code prfixe.
+ */
+static bool_t huffman_canonical( huffman_codes_t codes )
+{
+    /* Variables locales */
+    unsigned int i, j;                      /* Compteurs                 */
+    unsigned int counts[MAX_CODE_SIZE + 1]; /* Nombre de codes par taille */
+    uint64_t     next[MAX_CODE_SIZE + 1];   /* Prochain code par taille   */
+    uint64_t     code;                      /* Code courant               */
+
+    /* Contrle des paramtres */
+    assert( codes );
+
+    /* Nombre de codes de chaque longueur */
+    memset( counts, 0, sizeof (counts) );
+    for (i = 0; i < NUM_CHARS; i++) {
+	if (codes[i].size > MAX_CODE_SIZE)
 	    return FALSE;
+	counts[codes[i].size]++;
+    }
+    counts[0] = 0;
+
+    /* Premier code de chaque longueur, qui doit tenir dans celle-ci */
+    code = 0;
+    for (i = 1; i <= MAX_CODE_SIZE; i++) {
+	code = (code + counts[i - 1]) << 1;
+	next[i] = code;
+	if (code + counts[i] > (uint64_t) 1 << i)
+	    return FALSE;
+    }
+
+    /* Attribution des codes, crits  partir de leur bit de poids fort */
+    for (i = 0; i < NUM_CHARS; i++)
+	if (codes[i].size != 0) {
+	    code = next[codes[i].size]++;
+	    codes[i].bits = 0;
+	    for (j = 0; j < codes[i].size; j++)
+		codes[i].bits |= ((code >> (codes[i].size - 1 - j)) & 1) << j;
+	}
+
+    /* Pas d'erreur */
+    return TRUE;
+}
+
+
+/*****************************************************************************
+ *
+ * CONSTRUCTION DES TABLES DE DCODAGE
+ *
+ */
+
+/**
+ * Calcule la hauteur (longueur maximale des codes restant  lire) de chaque
+ * noeud de l'arbre de dcodage. Les fils tant toujours crs aprs leur
+ * parent, il suffit de parcourir les noeuds  l'envers.
+ */
+static void huffman_table_heights( const huffman_dtree_t tree,
+				   unsigned int count,
+				   unsigned char *heights )
+{
+    /* Variables locales */
+    unsigned int i, j;   /* Compteurs            */
+    unsigned int height; /* Hauteur d'un fils    */
+    int          child;  /* Fils du noeud courant */
+
+    /* Contrle des paramtres */
+    assert( tree );
+    assert( heights );
+
+    for (i = count - 1; i >= 1; i--) {
+	heights[i] = 1;
+	for (j = 0; j < 2; j++)
+	    if ((child = tree[i].children[j]) > 1 &&
+		(height = heights[child] + 1) > heights[i])
+		heights[i] = height > 255 ? 255 : height;
+    }
+}
+
+/**
+ * Calcule le nombre d'lments ncessaires  une table de dcodage de
+ * `width' bits commenant au noeud `node' de l'arbre, tables secondaires
+ * comprises.
+ */
+static unsigned int huffman_table_size( const huffman_dtree_t tree,
+					const unsigned char *heights,
+					unsigned int width, int node,
+					unsigned int depth )
+{
+    /* Variables locales */
+    unsigned int i;     /* Compteur             */
+    unsigned int size;  /* Taille ncessaire    */
+    int          child; /* Fils du noeud courant */
+
+    /* Contrle des paramtres */
+    assert( tree );
+    assert( heights );
+
+    /* La table elle-mme */
+    size = depth == 0 ? 1 << width : 0;
+
+    /* Tables secondaires des noeuds internes atteints aprs `width' bits */
+    for (i = 0; i < 2; i++)
+	if ((child = tree[node].children[i]) > 1) {
+	    if (depth + 1 < width)
+		size += huffman_table_size( tree, heights, width, child,
+					    depth + 1 );
+	    else
+		size += huffman_table_size( tree, heights,
+					    heights[child] < SUBTABLE_BITS ?
+					    heights[child] : SUBTABLE_BITS,
+					    child, 0 );
+	}
+
+    return size;
+}
+
+/**
+ * Remplit une table de dcodage de `width' bits commenant au noeud `node'
+ * de l'arbre, atteint aprs avoir lu les `depth' bits de `bits', en crant
+ * les tables secondaires ncessaires. Chaque code plus court que la table
+ * occupe tous les lments dont les premiers bits sont les siens.
+ */
+static void huffman_table_build( const huffman_dtree_t tree,
+				 const unsigned char *heights,
+				 huffman_entry_t table, unsigned int *used,
+				 unsigned int base, unsigned int width,
+				 int node, unsigned int depth,
+				 unsigned int bits )
+{
+    /* Variables locales */
+    unsigned int      i;     /* Compteur                     */
+    unsigned int      code;  /* Bits lus jusqu'au fils       */
+    unsigned int      sub;   /* Taille de la table fille     */
+    int               child; /* Fils du noeud courant        */
+    huffman_entry_s_t entry; /* lment  rpter            */
+
+    /* Contrle des paramtres */
+    assert( tree );
+    assert( heights );
+    assert( table );
+    assert( used );
+
+    for (i = 0; i < 2; i++) {
+	child = tree[node].children[i];
+	code  = bits | (i << depth);
+
+	if (child > 1) {
+	    if (depth + 1 < width) {
+		/* Noeud interne : descend d'un niveau */
+		huffman_table_build( tree, heights, table, used, base, width,
+				     child, depth + 1, code );
+		continue;
+	    }
+
+	    /* Code plus long que la table : table secondaire */
+	    sub = heights[child] < SUBTABLE_BITS ? heights[child] :
+		SUBTABLE_BITS;
+	    table[base + code].count    = 0;
+	    table[base + code].bits     = width;
+	    table[base + code].chars[0] = sub;
+	    table[base + code].next     = *used;
+	    *used += 1 << sub;
+	    huffman_table_build( tree, heights, table, used,
+				 table[base + code].next, sub, child, 0, 0 );
+	    continue;
+	}
+
+	/* Caractre complet, ou code inexistant (erreur) */
+	entry.count    = child <= 0 ? 1 : 0;
+	entry.bits     = child <= 0 ? depth + 1 : 0;
+	entry.first    = entry.bits;
+	entry.chars[0] = child <= 0 ? -child : 0;
+	for (; code < (1u << width); code += 2u << depth)
+	    table[base + code] = entry;
+    }
+}
+
+/**
+ * Complte les lments de la table principale par un second caractre
+ * lorsque les bits restants suffisent  le dcoder. Chaque lment ne
+ * dpend que d'un lment d'indice infrieur, d'o le parcours  l'envers.
+ */
+static void huffman_table_pair( huffman_entry_t table )
+{
+    /* Variables locales */
+    unsigned int    i;      /* Compteur        */
+    huffman_entry_t entry;  /* lment courant */
+    huffman_entry_t second; /* lment suivant */
 
-    /* Vide le tampon et ferme le fichier */
-    return wbuffer_finish( &wbuffer );
+    /* Contrle des paramtres */
+    assert( table );
+
+    for (i = (1 << TABLE_BITS) - 1; i > 0; i--) {
+	entry = table + i;
+	if (entry->count != 1 || entry->bits >= TABLE_BITS)
+	    continue;
+
+	second = table + (i >> entry->bits);
+	if (second->count == 1 && second->bits <= TABLE_BITS - entry->bits) {
+	    entry->count    = 2;
+	    entry->chars[1] = second->chars[0];
+	    entry->bits    += second->bits;
+	}
+    }
 }
 
 
@@ -533,12 +1840,17 @@ static bool_t rbuffer_read_byte( rbuffer_t buffer )
 
     /* Il ne reste pas assez de caractre dans le tampon */
     if (buffer->fb_pos == buffer->fb_size) {
+	/* Fin d'un bloc en mmoire */
+	if (buffer->data != buffer->file_buffer)
+	    return FALSE;
+
 	/* Lit les donnes dans le fichier */
 	if ((signed int) (buffer->fb_size = read( buffer->fd,
 						  buffer->file_buffer,
 						  BUFFER_SIZE )) <= 0) {
 	    /* Erreur de lecture */
 	    close( buffer->fd );
+	    buffer->fd = -1;
 	    return FALSE;
 	}
 
@@ -547,19 +1859,68 @@ static bool_t rbuffer_read_byte( rbuffer_t buffer )
     }
 
     /* Ajout de l'octet lu dans le tampon d'entre */
-    buffer->byte_buffer |= (unsigned int)
-	buffer->file_buffer[buffer->fb_pos++] << buffer->bb_remain;
+    buffer->byte_buffer |= (uint64_t)
+	buffer->data[buffer->fb_pos++] << buffer->bb_remain;
     buffer->bb_remain   += 8;
 
     /* Pas d'erreur */
     return TRUE;
 }
 
+/**
+ * Remplit le tampon d'entre d'au moins BIT_BUFFER_FILL bits. Une fois la
+ * fin du fichier atteinte, des bits nuls sont ajouts et compts  part :
+ * il suffit alors de vrifier,  la fin du dcodage, qu'ils n'ont pas t
+ * consomms.
+ */
+static bool_t rbuffer_fill( rbuffer_t buffer )
+{
+    /* Variables locales */
+    ssize_t length; /* Nombre d'octets lus */
+
+    /* Contrle des paramtres */
+    assert( buffer );
+
+    while (buffer->bb_remain < BIT_BUFFER_FILL) {
+	/* Lecture de la suite du fichier si ncessaire (un bloc en mmoire
+	 * est lu d'un coup) */
+	if (buffer->fb_pos == buffer->fb_size && !buffer->eof) {
+	    if (buffer->data != buffer->file_buffer)
+		length = 0;
+	    else if ((length = read( buffer->fd, buffer->file_buffer,
+				BUFFER_SIZE )) < 0) {
+		/* Erreur de lecture */
+		close( buffer->fd );
+		buffer->fd = -1;
+		return FALSE;
+	    }
+
+	    buffer->fb_pos  = 0;
+	    buffer->fb_size = (unsigned int) length;
+	    buffer->eof     = length == 0;
+	}
+
+	/* Ajout d'un octet du fichier, ou d'un octet nul aprs sa fin */
+	if (buffer->eof)
+	    buffer->padding += 8;
+	else
+	    buffer->byte_buffer |= (uint64_t)
+		buffer->data[buffer->fb_pos++] << buffer->bb_remain;
+	buffer->bb_remain += 8;
+    }
+
+    /* Pas d'erreur */
+    return TRUE;
+}
+
 /**
  * Initialise le tampon de lecture
  */
 static bool_t rbuffer_init( rbuffer_t buffer, const char *filename )
 {
+    /* Variables locales */
+    struct stat status; /* tat du fichier */
+
     /* Contrle des paramtres */
     assert( buffer );
     assert( filename );
@@ -574,22 +1935,41 @@ static bool_t rbuffer_init( rbuffer_t buffer, const char *filename )
 	buffer->file_buffer[0] != HEADER0 ||
 	buffer->file_buffer[1] != HEADER1 ||
 	buffer->file_buffer[2] != HEADER2 ||
-	buffer->file_buffer[3] != HEADER3) {
+	(buffer->file_buffer[3] != HEADER3_V1 &&
+	 buffer->file_buffer[3] != HEADER3_V2 &&
+	 buffer->file_buffer[3] != HEADER3_V3)) {
 	close( buffer->fd );
 	return FALSE;
     }
+    buffer->version = buffer->file_buffer[3] == HEADER3_V1 ? 1 :
+	buffer->file_buffer[3] == HEADER3_V2 ? 2 : 3;
+    buffer->data    = buffer->file_buffer;
+
+    /* Version 3 : la taille des donnes, sur 64 bits, et le reste de
+     * l'en-tte donnent accs  l'index des blocs, lus directement */
+    if (buffer->version == 3) {
+	if (buffer->fb_size < HEADER_SIZE_V3) {
+	    close( buffer->fd );
+	    return FALSE;
+	}
+	buffer->size = get_le64( buffer->file_buffer + 4 );
+	return TRUE;
+    }
 
     /* Calcule la taille des donnes */
-    if ((buffer->size = (unsigned int) buffer->file_buffer[4] |
-	 ((unsigned int) buffer->file_buffer[5] << 8) |
-	 ((unsigned int) buffer->file_buffer[6] << 16) |
-	 ((unsigned int) buffer->file_buffer[7] << 24)) == 0) {
+    buffer->size = get_le32( buffer->file_buffer + 4 );
+
+    if (buffer->size == 0) {
 	close( buffer->fd );
+	buffer->fd = -1;
 	return TRUE;
     }
 
-    /* Il faut au moins un octet supplmentaire */
-    if (buffer->fb_size < 9) {
+    /* Il faut au moins un octet supplmentaire, et chaque caractre est
+     * cod sur un bit au moins : une taille que le fichier ne peut contenir
+     * est rejete sans rien dcoder */
+    if (buffer->fb_size < 9 || fstat( buffer->fd, &status ) != 0 ||
+	buffer->size > ((uint64_t) status.st_size - 8) * 8) {
 	close( buffer->fd );
 	return FALSE;
     }
@@ -598,11 +1978,37 @@ static bool_t rbuffer_init( rbuffer_t buffer, const char *filename )
     buffer->fb_pos      = 9;
     buffer->bb_remain   = 8;
     buffer->byte_buffer = buffer->file_buffer[8];
+    buffer->padding     = 0;
+    buffer->eof         = FALSE;
 
     /* Pas d'erreur */
     return TRUE;
 }
 
+/**
+ * Initialise le tampon de lecture sur un bloc compress de `packed_size'
+ * octets, dj en mmoire, dont les donnes font `size' octets.
+ */
+static void rbuffer_init_memory( rbuffer_t buffer,
+				 const unsigned char *data,
+				 unsigned int packed_size, unsigned int size )
+{
+    /* Contrle des paramtres */
+    assert( buffer );
+    assert( data );
+
+    buffer->fd          = -1;
+    buffer->size        = size;
+    buffer->version     = 2;
+    buffer->bb_remain   = 0;
+    buffer->byte_buffer = 0;
+    buffer->padding     = 0;
+    buffer->eof         = FALSE;
+    buffer->fb_pos      = 0;
+    buffer->fb_size     = packed_size;
+    buffer->data        = data;
+}
+
 
 /*****************************************************************************
  *
@@ -611,167 +2017,199 @@ static bool_t rbuffer_init( rbuffer_t buffer, const char *filename )
  */
 
 /**
- * crire le tampon entier dans le fichier.
+ * Transfre les 8 octets du tampon d'octets, plein, dans la zone mmoire.
  */
-static bool_t wbuffer_write( wbuffer_t buffer )
+static void wbuffer_flush( wbuffer_t buffer )
 {
+    /* Variables locales */
+    unsigned int   i;    /* Compteur                 */
+    unsigned char *dest; /* Destination des octets   */
+
     /* Contrle des paramtres */
     assert( buffer );
+    assert( buffer->fb_size + 8 <= buffer->capacity );
 
-    if (buffer->fb_size != 0) {
-	/* crit le tampon */
-	if (write( buffer->fd, buffer->file_buffer, buffer->fb_size) != -1)
-	    /* Remet  zro la taille du tampon */
-	    buffer->fb_size = 0;
-	else {
-	    /* Erreur */
-	    close( buffer->fd );
-	    return FALSE;
-	}
-    }
-
-    /* Pas d'erreur */
-    return TRUE;
+    /* crit les octets, celui de poids faible d'abord */
+    dest = buffer->data + buffer->fb_size;
+    for (i = 0; i < 8; i++)
+	dest[i] = (unsigned char) (buffer->byte_buffer >> (i * 8));
+    buffer->fb_size += 8;
 }
 
 /**
- * Ajoute un caractre dans le tampon de sortie.
+ * crit les derniers bits du tampon d'octets dans la zone mmoire.
  */
-static bool_t wbuffer_flush( wbuffer_t buffer )
+static void wbuffer_finish( wbuffer_t buffer )
 {
     /* Contrle des paramtres */
     assert( buffer );
 
-    while (buffer->bb_size >= 8) {
-	/* crit le caractre et retourne en cas d'erreur */
-	buffer->file_buffer[buffer->fb_size++] =
-	    (unsigned char) buffer->byte_buffer;
-	if (buffer->fb_size == BUFFER_SIZE && !wbuffer_write( buffer ))
-	    return FALSE;
+    /* crit les derniers bits, octet par octet */
+    while (buffer->bb_size != 0) {
+	assert( buffer->fb_size < buffer->capacity );
+	buffer->data[buffer->fb_size++] = (unsigned char) buffer->byte_buffer;
 
 	/* Met  jour le tampon et sa taille */
 	buffer->byte_buffer >>= 8;
-	buffer->bb_size      -= 8;
+	buffer->bb_size      -= buffer->bb_size < 8 ? buffer->bb_size : 8;
     }
-
-    /* Pas d'erreur */
-    return TRUE;
 }
 
 /**
- * crit le tampon, mme non plein, dans le fichier.
+ * crit jusqu' 63 bits dans le tampon d'octets, qui est transfr dans la
+ * zone mmoire ds qu'il contient 64 bits.
  */
-static bool_t wbuffer_finish( wbuffer_t buffer )
+static void wbuffer_write_bits( wbuffer_t buffer, uint64_t data,
+				unsigned int size )
 {
+    /* Variables locales */
+    unsigned int total; /* Nombre de bits aprs l'ajout */
+
     /* Contrle des paramtres */
     assert( buffer );
+    assert( size < 64 );
+    assert( buffer->bb_size < 64 );
 
-    /* crit les derniers bits */
-    if (buffer->bb_size != 0) {
-	buffer->file_buffer[buffer->fb_size++] =
-	    (unsigned char) buffer->byte_buffer;
-
-	/* Met  jour le tampon et sa taille */
-	buffer->bb_size     = 0;
-	buffer->byte_buffer = 0;
+    /* Ajoute les bits */
+    buffer->byte_buffer |= data << buffer->bb_size;
+    total = buffer->bb_size + size;
+    if (total < 64) {
+	buffer->bb_size = total;
+	return;
     }
 
-    /* Ferme le fichier aprs avoir vid le tampon */
-    if (wbuffer_write( buffer )) {
-	close( buffer->fd );
-	return TRUE;
-    }
-    return FALSE;
+    /* Tampon plein : l'crit, puis y place les bits qui n'y tenaient pas
+     * (le tampon n'tait pas vide, sans quoi il ne serait pas plein) */
+    wbuffer_flush( buffer );
+    buffer->byte_buffer = data >> (64 - buffer->bb_size);
+    buffer->bb_size     = total - 64;
 }
 
 /**
- * crit quelques bits (9 ou 25 maximum suivant l'architecture, respectivement
- * 16-bit et 32-bit) dans le tampon.
+ * crit les codes des `size' caractres de `data'.
  */
-static bool_t wbuffer_write_bits( wbuffer_t buffer, unsigned int data,
-				  unsigned int size )
+static void wbuffer_write_codes( wbuffer_t buffer,
+				 const huffman_codes_t codes,
+				 const unsigned char *data,
+				 unsigned int size )
 {
+    /* Variables locales */
+    unsigned int           i;      /* Compteur                     */
+    const huffman_code_s_t *code;  /* Code du caractre courant    */
+    uint64_t               pair;   /* Codes de deux caractres     */
+    unsigned int           length; /* Taille de ces codes          */
+    uint64_t               bits;   /* Tampon d'octets local        */
+    unsigned int           used;   /* Bits prsents dans ce tampon */
+
     /* Contrle des paramtres */
     assert( buffer );
+    assert( codes );
+    assert( data || size == 0 );
+
+    /* crit les caractres deux par deux : leurs codes sont d'abord
+     * runis, ce qui divise par deux le nombre d'ajouts au tampon d'octets,
+     * gard dans des variables locales le temps de la boucle */
+    bits = buffer->byte_buffer;
+    used = buffer->bb_size;
+    for (i = 0; i < size; i += 2) {
+	code   = codes + data[i];
+	pair   = code->bits;
+	length = code->size;
+	assert( code->size != 0 );
+	if (i + 1 < size) {
+	    code    = codes + data[i + 1];
+	    pair   |= code->bits << length;
+	    length += code->size;
+	    assert( code->size != 0 );
+	}
 
-    /* Ajoute les bits */
-    buffer->byte_buffer |= data << buffer->bb_size;
-    buffer->bb_size     += size;
-
-    /* crit le tampon */
-    return wbuffer_flush( buffer );
+	bits |= pair << used;
+	if ((used += length) >= 64) {
+	    /* Tampon plein : l'crit et y place les bits qui n'y tenaient
+	     * pas (le tampon n'tait pas vide, sinon il ne serait pas plein) */
+	    buffer->byte_buffer = bits;
+	    wbuffer_flush( buffer );
+	    used -= 64;
+	    bits  = pair >> (length - used);
+	}
+    }
+    buffer->byte_buffer = bits;
+    buffer->bb_size     = used;
 }
 
 /**
- * crire un code complet dans le tampon.
+ * Initialise le tampon d'criture sur une zone mmoire de `capacity'
+ * octets.
  */
-static bool_t wbuffer_write_code( wbuffer_t buffer, huffman_code_t code )
+static void wbuffer_init( wbuffer_t buffer, unsigned char *data,
+			  unsigned int capacity )
 {
-    /* Variables locales */
-    int          byte;  /* Index d'octet du code  */
-    unsigned int count; /* Nombre de bits restant */
-
     /* Contrle des paramtres */
     assert( buffer );
-    assert( code );
+    assert( data );
 
-    /* crit les premiers bits */
-    byte = (code->size - 1) / 8;
-    if ((count = code->size % 8) != 0 &&
-	!wbuffer_write_bits( buffer, code->bits[byte--], count ))
-	    return FALSE;
+    buffer->bb_size     = 0;
+    buffer->byte_buffer = 0;
+    buffer->fb_size     = 0;
+    buffer->capacity    = capacity;
+    buffer->data        = data;
+}
 
-    /* crit les octets complets */
-    while (byte >= 0)
-	if (!wbuffer_write_bits( buffer, code->bits[byte--], 8 ))
-	    return FALSE;
 
-    /* Pas d'erreur */
-    return TRUE;
+/*****************************************************************************
+ *
+ * ENTIERS CODS EN PETIT-BOUTISTE
+ *
+ */
+
+/**
+ * Lit un entier de 32 bits, l'octet de poids faible en premier.
+ */
+static unsigned int get_le32( const unsigned char *bytes )
+{
+    /* Contrle des paramtres */
+    assert( bytes );
+
+    return (unsigned int) bytes[0] | ((unsigned int) bytes[1] << 8) |
+	((unsigned int) bytes[2] << 16) | ((unsigned int) bytes[3] << 24);
 }
 
 /**
- * Initialise le tampon d'criture.
+ * Lit un entier de 64 bits, l'octet de poids faible en premier.
  */
-static bool_t wbuffer_init( wbuffer_t buffer, const char *filename,
-			    unsigned int size )
+static uint64_t get_le64( const unsigned char *bytes )
 {
     /* Contrle des paramtres */
-    assert( buffer );
-    assert( filename );
-    assert( BUFFER_SIZE >= 8 );
-    
-    /* Ouvre le fichier en criture de retourne en cas d'erreur */
-    if ((buffer->fd = creat( filename, 0666 )) == -1)
-	return FALSE;
+    assert( bytes );
 
-    /* Initialise le buffer avec le dbut du fichier */
-    buffer->file_buffer[0] = HEADER0;
-    buffer->file_buffer[1] = HEADER1;
-    buffer->file_buffer[2] = HEADER2;
-    buffer->file_buffer[3] = HEADER3;
-
-    /* Ajoute la taille des donnes au tampon */
-    buffer->file_buffer[4] = (unsigned char) size;
-    buffer->file_buffer[5] = (unsigned char) (size >> 8);
-    buffer->file_buffer[6] = (unsigned char) (size >> 16);
-    buffer->file_buffer[7] = (unsigned char) (size >> 24);
-
-    /* crit et ferme immdiatement le fichier si la taille est nulle */
-    if (size == 0) {
-	write( buffer->fd, buffer->file_buffer, 8 );
-	close( buffer->fd );
-	return TRUE;
-    }
+    return (uint64_t) get_le32( bytes ) |
+	((uint64_t) get_le32( bytes + 4 ) << 32);
+}
 
-    /* Met  jour la taille des donnes prsentes dans le tampon */
-    buffer->fb_size = 8;
+/**
+ * crit un entier de 32 bits, l'octet de poids faible en premier.
+ */
+static void put_le32( unsigned char *bytes, unsigned int value )
+{
+    /* Contrle des paramtres */
+    assert( bytes );
 
-    /* Initialise les autres champs */
-    buffer->byte_buffer = 0;
-    buffer->bb_size     = 0;
+    bytes[0] = (unsigned char) value;
+    bytes[1] = (unsigned char) (value >> 8);
+    bytes[2] = (unsigned char) (value >> 16);
+    bytes[3] = (unsigned char) (value >> 24);
+}
 
-    return TRUE;
+/**
+ * crit un entier de 64 bits, l'octet de poids faible en premier.
+ */
+static void put_le64( unsigned char *bytes, uint64_t value )
+{
+    /* Contrle des paramtres */
+    assert( bytes );
+
+    put_le32( bytes, (unsigned int) value );
+    put_le32( bytes + 4, (unsigned int) (value >> 32) );
 }
 
 /* Fin du fichier */
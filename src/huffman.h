@@ -39,6 +39,9 @@
 #ifndef _HUFFMAN_H_
 #define _HUFFMAN_H_
 
+/* En-ttes standard */
+#include <stdint.h>
+
 /* En-ttes locaux */
 #include "bool.h"
 
@@ -49,11 +52,28 @@ extern "C"
 #endif /* __cplusplus */
 
 
+/* Types de donnes */
+typedef struct huffman_writer *huffman_writer_t; /* Compression en flux   */
+typedef struct huffman_reader *huffman_reader_t; /* Dcompression en flux */
+
 /* Prototypes des fonctions externes */
-bool_t huffman_read( const char *filename, char **buffer,
-		     unsigned int *size );
-bool_t huffman_write( const char *filename, const char *buffer,
-		      unsigned int size );
+bool_t           huffman_read( const char *filename, char **buffer,
+			       unsigned int *size );
+bool_t           huffman_write( const char *filename, const char *buffer,
+				unsigned int size );
+void             huffman_set_thread_number( unsigned int threads );
+
+huffman_writer_t huffman_writer_open( const char *filename );
+bool_t           huffman_writer_write( huffman_writer_t writer,
+				       const char *buffer,
+				       unsigned int size );
+bool_t           huffman_writer_close( huffman_writer_t writer );
+
+huffman_reader_t huffman_reader_open( const char *filename,
+				      uint64_t *size );
+bool_t           huffman_reader_read( huffman_reader_t reader, char *buffer,
+				      unsigned int *size );
+void             huffman_reader_close( huffman_reader_t reader );
 
 
 /* Traitement spcial si utilisation dans un programme C++ (fin) */
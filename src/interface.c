@@ -49,7 +49,6 @@
 /* En-ttes locaux */
 #include "interface.h"
 #include "dict.h"
-#include "huffman.h"
 #include "alpha.h"
 
 
@@ -63,6 +62,13 @@
 /* Nombre maximum de propositions  chercher dans le dictionnaire */
 #define NUM_WORDS 10
 
+/* Longueur maximale des dbuts de mots dont les propositions sont gardes
+ * en cache (0 : aucune limite) */
+#define CACHE_DEPTH 4
+
+/* Nombre de mots ajouts entre deux rorganisations du dictionnaire */
+#define REBALANCE_INTERVAL 4096
+
 /* Valeurs identifiant des boutons dans les botes de dialogue */
 #define DIALOG_YES    0
 #define DIALOG_NO     1
@@ -267,6 +273,8 @@ interface_t interface_new( int argc, char **argv )
     if (!(interface = malloc( sizeof (interface_s_t) )) ||
 	!(interface->dict = dict_new()))
 	return NULL;
+    dict_set_cache( interface->dict, NUM_WORDS, CACHE_DEPTH );
+    dict_set_rebalance( interface->dict, REBALANCE_INTERVAL );
 
     /* Initialisation de GTK+ */
     gtk_init( &argc, &argv );
@@ -1166,6 +1174,9 @@ static void menu_clear_dict( interface_t interface )
     if (!(interface->dict = dict_new())) {
 	dialog_alert( "Erreur : impossible de crer un dictionnaire." );
 	menu_quit( interface );
+    } else {
+	dict_set_cache( interface->dict, NUM_WORDS, CACHE_DEPTH );
+	dict_set_rebalance( interface->dict, REBALANCE_INTERVAL );
     }
 
     /* Mise  jour de la liste */
@@ -1182,23 +1193,23 @@ static void menu_open_dict( interface_t interface )
 {
     /* Variables locales */
     char   *filename; /* Nom du fichier               */
-    char   *buffer;   /* Tampon de lecture            */
     dict_t dict;      /* Nouveau dictionnaire         */
     bool_t modified;  /* Sauvegarde de l'tat modifi */
 
     /* Rinitialise et ouvre le dictionnaire */
     if ((filename = dialog_file( "Ouvrir un dictionnaire", "*.hdc",
 				 FALSE ))) {
-	if (huffman_read( filename, &buffer, NULL )) {
-	    if ((dict = dict_new()) &&
-		dict_add_words_from_string( dict, buffer )) {
-		dict_delete( interface->dict );
-		interface->dict = dict;
-	    } else
-		dialog_alert( "Erreur d'ouverture du dictionnaire." );
-	    free( buffer );
-	} else
-	    dialog_alert( "Le format du fichier est incorrect." );
+	if ((dict = dict_new()) &&
+	    dict_set_cache( dict, NUM_WORDS, CACHE_DEPTH ) &&
+	    dict_add_words_from_file( dict, filename )) {
+	    dict_set_rebalance( dict, REBALANCE_INTERVAL );
+	    dict_delete( interface->dict );
+	    interface->dict = dict;
+	} else {
+	    if (dict)
+		dict_delete( dict );
+	    dialog_alert( "Erreur d'ouverture du dictionnaire." );
+	}
 	free( filename );
     }
 
@@ -1216,18 +1227,13 @@ static void menu_add_dict( interface_t interface )
 {
     /* Variables locales */
     char *filename;   /* Nom du fichier               */
-    char *buffer;     /* Tampon de lecture            */
     bool_t modified;  /* Sauvegarde de l'tat modifi */
 
     /* Ouvre le dictionnaire */
     if ((filename = dialog_file( "Ajouter un dictionnaire", "*.hdc",
 				 FALSE ))) {
-	if (huffman_read( filename, &buffer, NULL )) {
-	    if (!dict_add_words_from_string( interface->dict, buffer ))
-		dialog_alert( "Erreur d'ouverture du dictionnaire." );
-	    free( buffer );
-	} else
-	    dialog_alert( "Le format du fichier est incorrect." );
+	if (!dict_add_words_from_file( interface->dict, filename ))
+	    dialog_alert( "Erreur d'ouverture du dictionnaire." );
 	free( filename );
     }
 
@@ -1245,19 +1251,13 @@ static void menu_save_dict( interface_t interface )
 {
     /* Variables locales */
     char   *filename; /* Nom du fichier               */
-    char   *buffer;   /* Tampon de d'criture         */
     bool_t modified;  /* Sauvegarde de l'tat modifi */
 
     /* Sauvegarde le dictionnaire */
     if ((filename = dialog_file( "Enregistrer un dictionnaire", "*.hdc",
 				 TRUE ))) {
-	if ((buffer = dict_get_words_into_string( interface->dict ))) {
-	    if (huffman_write( filename, buffer, (unsigned int) -1 ))
-		free( buffer );
-	    else
-		dialog_alert( "Erreur d'criture du dictionnaire." );
-	} else
-	    dialog_alert( "Erreur de recherche des mots du dictionnaire." );
+	if (!dict_write_words_to_file( interface->dict, filename ))
+	    dialog_alert( "Erreur d'criture du dictionnaire." );
 	free( filename );
     }
 
@@ -42,7 +42,6 @@
 /* En-ttes locaux */
 #include "interface.h"
 #include "dict.h"
-#include "huffman.h"
 
 
 /*****************************************************************************
@@ -61,14 +60,17 @@ int main( int argc, char **argv )
 #endif /* !USE_NONE */
 {
     /* Variables locales */
-    int         i;          /* Compteur                  */
-    char        word[128];  /* Mot lu                    */
-    char        *str;       /* Tampon                    */
-    char        **res;      /* Rsultat des propositions */
-    dict_t      dict;       /* Dictionnaire              */
+    int           i;         /* Compteur                  */
+    char          word[128]; /* Mot lu                    */
+    char          **res;     /* Rsultat des propositions */
+    dict_t        dict;      /* Dictionnaire              */
+    unsigned long reserved;  /* Mmoire rserve          */
+    unsigned long used;      /* Mmoire utilise          */
+    double        average;   /* Comparaisons moyennes     */
+    unsigned int  maximum;   /* Comparaisons maximales    */
 #ifdef USE_GTK1
-    interface_t interface;  /* Objet interface           */
-    bool_t      result;     /* Rsultat de l'excution   */
+    interface_t   interface; /* Objet interface           */
+    bool_t        result;    /* Rsultat de l'excution   */
 
     if (getenv( "DISPLAY" )) {
 	/* Cration de l'objet interface */
@@ -117,27 +119,33 @@ int main( int argc, char **argv )
 	    } else
 		fputs( "Erreur de recherche des mots !\n", stderr );
 	} else if (word[0] == '<') {
-	    if (huffman_read( word[1] == '\0' ? "dict.hdc" : word + 1,
-			      &str, NULL )) {
-		if (!dict_add_words_from_string( dict, str ))
-		    fputs( "Erreur d'ajout de dictionnaire !\n", stderr );
-		free( str );
-	    } else
+	    if (!dict_add_words_from_file( dict, word[1] == '\0' ?
+					   "dict.hdc" : word + 1 ))
 		fputs( "Erreur de lecture !\n", stderr );
 	} else if (word[0] == '>') {
-	    if ((str = dict_get_words_into_string( dict ))) {
-		if (huffman_write( word[1] == '\0' ? "dict.hdc" : word + 1,
-				   str, (unsigned int) -1 ))
-		    free(str);
-		else
-		    fputs( "Erreur d'criture !\n", stderr );
-	    } else
-		puts( "Erreur de recherche des mots du dictionnaire !" );
+	    if (!dict_write_words_to_file( dict, word[1] == '\0' ?
+					   "dict.hdc" : word + 1 ))
+		fputs( "Erreur d'criture !\n", stderr );
+	} else if (word[0] == '#') {
+	    dict_get_memory_usage( dict, &reserved, &used );
+	    printf( "    Mmoire rserve : %lu octets\n"
+		    "    Mmoire utilise : %lu octets\n", reserved, used );
+	    dict_get_cache_memory_usage( dict, &reserved, &used );
+	    printf( "    Listes en cache  : %lu octets (%lu utiliss)\n",
+		    reserved, used );
+	    if (dict_get_balance( dict, &average, &maximum ))
+		printf( "    Comparaisons     : %.2f en moyenne, %u au plus\n",
+			average, maximum );
+	} else if (word[0] == '=') {
+	    if (!dict_rebalance( dict ) || !dict_compact( dict ))
+		fputs( "Erreur de rorganisation !\n", stderr );
 	} else if (word[0] == '?')
 	    puts( "Commandes disponibles :\n"
 		  "    *[mot]     : recherche les mots commenant par `mot'\n"
 		  "    <[fichier] : ajoute les mots au dictionnaire\n"
 		  "    >[fichier] : enregistre le dictionnaire\n"
+		  "    #          : affiche la mmoire occupe\n"
+		  "    =          : rorganise le dictionnaire\n"
 		  "    ?          : affiche ce message d'aide\n"
 		  "    .          : quitte le programme\n" );
 	else if (word[0] == '.')
@@ -0,0 +1,288 @@
+/*
+ * ---------------------------------------------------------------------------
+ *
+ * Act : Auto-Completion Tree -- Implmentation d'un arbre d'auto-compltion
+ * Copyright (c) 2004 Benjamin Gaillard
+ *
+ * ---------------------------------------------------------------------------
+ *
+ * Fichier     : pool.c
+ *
+ * Description : Groupe de threads excutant des tches indpendantes, par
+ *               exemple la compression de blocs de donnes.
+ *
+ * Commentaire : Sans thread (un seul processeur, ou chec de leur cration),
+ *               les tches sont simplement excutes lors de leur soumission.
+ *
+ * ---------------------------------------------------------------------------
+ *
+ * Ce programme est un logiciel libre ; vous pouvez le redistribuer et/ou le
+ * modifier conformment aux dispositions de la Licence Publique Gnrale GNU,
+ * telle que publie par la Free Software Foundation ; version 2 de la
+ * licence, ou encore ( votre convenance) toute version ultrieure.
+ *
+ * Ce programme est distribu dans l'espoir qu'il sera utile, mais SANS AUCUNE
+ * GARANTIE ; sans mme la garantie implicite de COMMERCIALISATION ou
+ * D'ADAPTATION  UN OBJET PARTICULIER. Pour plus de dtail, voir la Licence
+ * Publique Gnrale GNU.
+ *
+ * Vous devez avoir reu un exemplaire de la Licence Publique Gnrale GNU en
+ * mme temps que ce programme ; si ce n'est pas le cas, crivez  la Free
+ * Software Foundation Inc., 675 Mass Ave, Cambridge, MA 02139, tats-Unis.
+ *
+ * ---------------------------------------------------------------------------
+ */
+
+
+/* Options de compilation (pour sysconf()) */
+#define _POSIX_C_SOURCE 200112L
+
+/* En-ttes standard */
+#include <stdlib.h>
+#include <unistd.h>
+#include <assert.h>
+#include <pthread.h>
+
+/* En-ttes locaux */
+#include "bool.h"
+#include "pool.h"
+
+
+/*****************************************************************************
+ *
+ * TYPES DE DONNES
+ *
+ */
+
+/* Groupe de threads */
+typedef struct pool
+{
+    unsigned int    number;  /* Nombre de threads            */
+    pthread_t       *threads; /* Threads                     */
+    pthread_mutex_t mutex;   /* Verrou protgeant les champs */
+    pthread_cond_t  work;    /* Tche disponible ou arrt    */
+    pthread_cond_t  done;    /* Tche termine               */
+    pool_task_t     first;   /* Premire tche en attente    */
+    pool_task_t     last;    /* Dernire tche en attente    */
+    bool_t          stop;    /* Arrt demand                */
+}
+pool_s_t;
+
+
+/*****************************************************************************
+ *
+ * PROTOTYPES DES FONCTIONS STATIQUES
+ *
+ */
+
+/* Fonction principale des threads */
+static void *pool_thread( void *data );
+
+
+/*****************************************************************************
+ *
+ * FONCTIONS EXTERNES
+ *
+ */
+
+/**
+ * Cre un groupe de `threads' threads, ou d'autant de threads que de
+ * processeurs si `threads' est nul. Aucun thread n'est cr s'il n'en faut
+ * qu'un : les tches sont alors excutes par l'appelant.
+ */
+pool_t pool_new( unsigned int threads )
+{
+    /* Variables locales */
+    long   cpus; /* Nombre de processeurs */
+    pool_t pool; /* Groupe cr           */
+
+    /* Nombre de threads par dfaut */
+    if (threads == 0) {
+	cpus    = sysconf( _SC_NPROCESSORS_ONLN );
+	threads = cpus > 0 ? (unsigned int) cpus : 1;
+    }
+
+    /* Allocation et initialisation du groupe */
+    if (!(pool = malloc( sizeof (pool_s_t) )))
+	return NULL;
+
+    pool->number  = 0;
+    pool->threads = NULL;
+    pool->first   = NULL;
+    pool->last    = NULL;
+    pool->stop    = FALSE;
+    if (threads < 2)
+	return pool;
+
+    if (pthread_mutex_init( &pool->mutex, NULL ) != 0) {
+	free( pool );
+	return NULL;
+    }
+    if (pthread_cond_init( &pool->work, NULL ) != 0) {
+	pthread_mutex_destroy( &pool->mutex );
+	free( pool );
+	return NULL;
+    }
+    if (pthread_cond_init( &pool->done, NULL ) != 0) {
+	pthread_cond_destroy( &pool->work );
+	pthread_mutex_destroy( &pool->mutex );
+	free( pool );
+	return NULL;
+    }
+
+    /* Cration des threads : ceux qui ont pu l'tre suffisent */
+    if ((pool->threads = malloc( threads * sizeof (pthread_t) )))
+	while (pool->number < threads &&
+	       pthread_create( pool->threads + pool->number, NULL,
+			       pool_thread, pool ) == 0)
+	    pool->number++;
+
+    return pool;
+}
+
+/**
+ * Dtruit un groupe de threads, aprs avoir attendu la fin des tches
+ * soumises.
+ */
+void pool_delete( pool_t pool )
+{
+    /* Variables locales */
+    unsigned int i; /* Compteur */
+
+    /* Contrle des paramtres */
+    assert( pool );
+
+    if (pool->threads) {
+	/* Demande l'arrt des threads et attend qu'ils se terminent */
+	pthread_mutex_lock( &pool->mutex );
+	pool->stop = TRUE;
+	pthread_cond_broadcast( &pool->work );
+	pthread_mutex_unlock( &pool->mutex );
+
+	for (i = 0; i < pool->number; i++)
+	    pthread_join( pool->threads[i], NULL );
+	free( pool->threads );
+
+	pthread_cond_destroy( &pool->done );
+	pthread_cond_destroy( &pool->work );
+	pthread_mutex_destroy( &pool->mutex );
+    }
+
+    /* Libration de la mmoire */
+    free( pool );
+}
+
+/**
+ * Obtient le nombre de threads du groupe (nul si les tches sont excutes
+ * par l'appelant).
+ */
+unsigned int pool_get_thread_number( const pool_t pool )
+{
+    /* Contrle des paramtres */
+    assert( pool );
+
+    return pool->number;
+}
+
+/**
+ * Soumet une tche au groupe, qui appellera `function' avec `data'.
+ */
+void pool_submit( pool_t pool, pool_task_t task, pool_function_t function,
+		  void *data )
+{
+    /* Contrle des paramtres */
+    assert( pool );
+    assert( task );
+    assert( function );
+
+    /* Initialisation de la tche */
+    task->function = function;
+    task->data     = data;
+    task->done     = FALSE;
+    task->next     = NULL;
+
+    /* Sans thread, la tche est excute immdiatement */
+    if (pool->number == 0) {
+	function( data );
+	task->done = TRUE;
+	return;
+    }
+
+    /* Ajout de la tche  la file et rveil d'un thread */
+    pthread_mutex_lock( &pool->mutex );
+    if (pool->last)
+	pool->last->next = task;
+    else
+	pool->first = task;
+    pool->last = task;
+    pthread_cond_signal( &pool->work );
+    pthread_mutex_unlock( &pool->mutex );
+}
+
+/**
+ * Attend la fin d'une tche soumise au groupe.
+ */
+void pool_wait( pool_t pool, pool_task_t task )
+{
+    /* Contrle des paramtres */
+    assert( pool );
+    assert( task );
+
+    if (pool->number == 0) {
+	assert( task->done );
+	return;
+    }
+
+    pthread_mutex_lock( &pool->mutex );
+    while (!task->done)
+	pthread_cond_wait( &pool->done, &pool->mutex );
+    pthread_mutex_unlock( &pool->mutex );
+}
+
+
+/*****************************************************************************
+ *
+ * FONCTIONS STATIQUES
+ *
+ */
+
+/**
+ * Fonction principale des threads : excute les tches de la file jusqu'
+ * ce que l'arrt soit demand et que la file soit vide.
+ */
+static void *pool_thread( void *data )
+{
+    /* Variables locales */
+    pool_t      pool = data; /* Groupe de threads */
+    pool_task_t task;        /* Tche courante    */
+
+    /* Contrle des paramtres */
+    assert( pool );
+
+    pthread_mutex_lock( &pool->mutex );
+    for (;;) {
+	/* Attend une tche */
+	while (!pool->first && !pool->stop)
+	    pthread_cond_wait( &pool->work, &pool->mutex );
+	if (!pool->first)
+	    break;
+
+	/* Retire la tche de la file */
+	task        = pool->first;
+	pool->first = task->next;
+	if (!pool->first)
+	    pool->last = NULL;
+
+	/* L'excute sans le verrou, puis signale sa fin */
+	pthread_mutex_unlock( &pool->mutex );
+	task->function( task->data );
+	pthread_mutex_lock( &pool->mutex );
+	task->done = TRUE;
+	pthread_cond_broadcast( &pool->done );
+    }
+    pthread_mutex_unlock( &pool->mutex );
+
+    return NULL;
+}
+
+/* Fin du fichier */
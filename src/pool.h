@@ -0,0 +1,83 @@
+/*
+ * ---------------------------------------------------------------------------
+ *
+ * Act : Auto-Completion Tree -- Implmentation d'un arbre d'auto-compltion
+ * Copyright (c) 2004 Benjamin Gaillard
+ *
+ * ---------------------------------------------------------------------------
+ *
+ * Fichier     : pool.h
+ *
+ * Description : Ce fichier contient les types et les prototypes des
+ *               fonctions externes du fichier `pool.c' pour pouvoir les
+ *               utiliser dans d'autres modules.
+ *
+ * Commentaire : Pour plus d'informations sur les fonctions et leurs
+ *               paramtres, voir le fichier `pool.c'.
+ *
+ * ---------------------------------------------------------------------------
+ *
+ * Ce programme est un logiciel libre ; vous pouvez le redistribuer et/ou le
+ * modifier conformment aux dispositions de la Licence Publique Gnrale GNU,
+ * telle que publie par la Free Software Foundation ; version 2 de la
+ * licence, ou encore ( votre convenance) toute version ultrieure.
+ *
+ * Ce programme est distribu dans l'espoir qu'il sera utile, mais SANS AUCUNE
+ * GARANTIE ; sans mme la garantie implicite de COMMERCIALISATION ou
+ * D'ADAPTATION  UN OBJET PARTICULIER. Pour plus de dtail, voir la Licence
+ * Publique Gnrale GNU.
+ *
+ * Vous devez avoir reu un exemplaire de la Licence Publique Gnrale GNU en
+ * mme temps que ce programme ; si ce n'est pas le cas, crivez  la Free
+ * Software Foundation Inc., 675 Mass Ave, Cambridge, MA 02139, tats-Unis.
+ *
+ * ---------------------------------------------------------------------------
+ */
+
+
+/* Pour ne pas include plusieurs fois cet en-tte */
+#ifndef _POOL_H_
+#define _POOL_H_
+
+/* En-ttes locaux */
+#include "bool.h"
+
+/* Traitement spcial si utilisation dans un programme C++ (dbut) */
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+
+/* Types de donnes */
+typedef struct pool *pool_t;                        /* Groupe de threads    */
+typedef void       (*pool_function_t)( void *data ); /* Fonction d'une tche */
+
+/* Tche confie au groupe de threads, alloue par l'appelant, qui ne doit
+ * pas y toucher avant qu'elle ne soit termine */
+typedef struct pool_task
+{
+    pool_function_t  function; /* Fonction  excuter       */
+    void             *data;    /* Donnes de la fonction    */
+    bool_t           done;     /* Tche termine            */
+    struct pool_task *next;    /* Tche suivante de la file */
+}
+pool_task_s_t, *pool_task_t;
+
+/* Prototypes des fonctions externes */
+pool_t       pool_new( unsigned int threads );
+void         pool_delete( pool_t pool );
+unsigned int pool_get_thread_number( const pool_t pool );
+void         pool_submit( pool_t pool, pool_task_t task,
+			  pool_function_t function, void *data );
+void         pool_wait( pool_t pool, pool_task_t task );
+
+
+/* Traitement spcial si utilisation dans un programme C++ (fin) */
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* !_POOL_H_ */
+
+/* Fin du fichier */
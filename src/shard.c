@@ -0,0 +1,653 @@
+/*
+ * ---------------------------------------------------------------------------
+ *
+ * Act : Auto-Completion Tree -- Implmentation d'un arbre d'auto-compltion
+ * Copyright (c) 2004 Benjamin Gaillard
+ *
+ * ---------------------------------------------------------------------------
+ *
+ * Fichier     : shard.c
+ *
+ * Description : Dictionnaire rparti entre plusieurs arbres indpendants,
+ *               protgs chacun par son propre verrou, afin que plusieurs
+ *               threads puissent y ajouter des mots en mme temps.
+ *
+ * Commentaire : Un mot est rang dans la partition dsigne par ses deux
+ *               premires lettres : une recherche ne consulte donc qu'une
+ *               partition ds que le prfixe en compte deux, celles
+ *               atteintes par sa premire lettre s'il n'en a qu'une et
+ *               toutes s'il est vide.
+ *
+ * ---------------------------------------------------------------------------
+ *
+ * Ce programme est un logiciel libre ; vous pouvez le redistribuer et/ou le
+ * modifier conformment aux dispositions de la Licence Publique Gnrale GNU,
+ * telle que publie par la Free Software Foundation ; version 2 de la
+ * licence, ou encore ( votre convenance) toute version ultrieure.
+ *
+ * Ce programme est distribu dans l'espoir qu'il sera utile, mais SANS AUCUNE
+ * GARANTIE ; sans mme la garantie implicite de COMMERCIALISATION ou
+ * D'ADAPTATION  UN OBJET PARTICULIER. Pour plus de dtail, voir la Licence
+ * Publique Gnrale GNU.
+ *
+ * Vous devez avoir reu un exemplaire de la Licence Publique Gnrale GNU en
+ * mme temps que ce programme ; si ce n'est pas le cas, crivez  la Free
+ * Software Foundation Inc., 675 Mass Ave, Cambridge, MA 02139, tats-Unis.
+ *
+ * ---------------------------------------------------------------------------
+ */
+
+
+/* En-ttes standard */
+#include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+
+/* En-ttes locaux */
+#include "shard.h"
+#include "tstree.h"
+#include "pool.h"
+#include "alpha.h"
+
+
+/*****************************************************************************
+ *
+ * CONSTANTES ET MACROS
+ *
+ */
+
+/* Nombre de mots mis en attente par un thread pour chaque partition avant
+ * de les ajouter en une seule prise du verrou */
+#define BATCH_SIZE 256
+
+/* Partition d'un mot selon ses deux premires lettres (en minuscules) */
+#define SHARD_INDEX( shard, first, second )                       \
+    (((unsigned char) (first) * 31u + (unsigned char) (second)) % \
+     (shard)->number)
+
+
+/*****************************************************************************
+ *
+ * TYPES DE DONNES
+ *
+ */
+
+/* Partition : arbre et verrou le protgeant */
+typedef struct shard_part
+{
+    tstree_t        tree;  /* Arbre des mots de la partition */
+    pthread_mutex_t mutex; /* Verrou protgeant l'arbre      */
+}
+shard_part_s_t, *shard_part_t;
+
+/* Dictionnaire partitionn */
+typedef struct shard
+{
+    unsigned int   number;               /* Nombre de partitions      */
+    unsigned int   threads;              /* Threads d'ajout           */
+    unsigned long  masks[UCHAR_MAX + 1]; /* Partitions par 1re lettre */
+    shard_part_s_t parts[SHARD_MAX];     /* Partitions                */
+}
+shard_s_t;
+
+/* Mot en attente d'ajout, non termin par un zro dans la chane */
+typedef struct shard_word
+{
+    char         *start; /* Dbut du mot    */
+    unsigned int length; /* Longueur du mot */
+}
+shard_word_s_t, *shard_word_t;
+
+/* Part d'une chane confie  un thread lors d'un ajout parallle */
+typedef struct shard_feed
+{
+    shard_t        shard;                        /* Dictionnaire       */
+    char           *start;                       /* Dbut de la part   */
+    char           *end;                         /* Fin de la part     */
+    bool_t         ok;                           /* Pas d'erreur       */
+    pool_task_s_t  task;                         /* Tche du thread    */
+    unsigned int   counts[SHARD_MAX];            /* Mots en attente    */
+    shard_word_s_t words[SHARD_MAX][BATCH_SIZE]; /* Lots de mots       */
+}
+shard_feed_s_t, *shard_feed_t;
+
+/* Mot candidat lors de la fusion des rsultats de plusieurs partitions */
+typedef struct shard_candidate
+{
+    unsigned int  count;  /* Frquence du mot               */
+    unsigned int  order;  /* Rang d'obtention du mot        */
+    unsigned long offset; /* Position du mot dans le tampon */
+}
+shard_candidate_s_t;
+
+
+/*****************************************************************************
+ *
+ * PROTOTYPES DES FONCTIONS STATIQUES
+ *
+ */
+
+static unsigned long shard_get_mask( const shard_t shard, const char *word );
+static void          shard_feed( void *data );
+static bool_t        shard_queue( char *word, unsigned int length,
+				  void *data );
+static bool_t        shard_flush( shard_feed_t feed, unsigned int index );
+static int           shard_compare( const void *first, const void *second );
+
+
+/*****************************************************************************
+ *
+ * FONCTIONS EXTERNES
+ *
+ */
+
+/**
+ * Cre un dictionnaire rparti en `number' partitions (au plus SHARD_MAX).
+ */
+shard_t shard_new( unsigned int number )
+{
+    /* Variables locales */
+    unsigned int i, j;  /* Compteurs                */
+    shard_t      shard; /* Dictionnaire partitionn */
+
+    /* Contrle des paramtres */
+    assert( number > 0 && number <= SHARD_MAX );
+
+    if (!(shard = malloc( sizeof (shard_s_t) )))
+	return NULL;
+
+    shard->number  = number;
+    shard->threads = 0;
+
+    /* Cration des partitions */
+    for (i = 0; i < number; i++) {
+	if (!(shard->parts[i].tree = tstree_new()))
+	    break;
+	if (pthread_mutex_init( &shard->parts[i].mutex, NULL ) != 0) {
+	    tstree_delete( shard->parts[i].tree );
+	    break;
+	}
+    }
+    if (i < number) {
+	while (i-- > 0) {
+	    pthread_mutex_destroy( &shard->parts[i].mutex );
+	    tstree_delete( shard->parts[i].tree );
+	}
+	free( shard );
+	return NULL;
+    }
+
+    /* Partitions atteintes par les mots commenant par chaque lettre */
+    for (i = 0; i <= UCHAR_MAX; i++) {
+	shard->masks[i] = 0;
+	if (IS_LOWER_CASE( (char) i ))
+	    for (j = 0; j <= UCHAR_MAX; j++)
+		if (IS_LOWER_CASE( (char) j ))
+		    shard->masks[i] |= 1UL << SHARD_INDEX( shard, i, j );
+    }
+
+    return shard;
+}
+
+/**
+ * Dtruit un dictionnaire partitionn.
+ */
+void shard_delete( shard_t shard )
+{
+    /* Variables locales */
+    unsigned int i; /* Compteur */
+
+    /* Contrle des paramtres */
+    assert( shard );
+
+    for (i = 0; i < shard->number; i++) {
+	pthread_mutex_destroy( &shard->parts[i].mutex );
+	tstree_delete( shard->parts[i].tree );
+    }
+    free( shard );
+}
+
+/**
+ * Retourne le nombre de partitions d'un dictionnaire.
+ */
+unsigned int shard_get_part_number( const shard_t shard )
+{
+    /* Contrle des paramtres */
+    assert( shard );
+
+    return shard->number;
+}
+
+/**
+ * Dfinit le nombre de threads utiliss par shard_add_words_from_string()
+ * (autant que de processeurs si `threads' est nul).
+ */
+void shard_set_thread_number( shard_t shard, unsigned int threads )
+{
+    /* Contrle des paramtres */
+    assert( shard );
+
+    shard->threads = threads;
+}
+
+/**
+ * Ajoute un mot au dictionnaire.
+ */
+bool_t shard_add( shard_t shard, char *word )
+{
+    return shard_add_count( shard, word, 1 );
+}
+
+/**
+ * Ajoute `count' occurences d'un mot au dictionnaire ; plusieurs threads
+ * peuvent le faire en mme temps. Comme ceux qu'extrait alpha_split(), le
+ * mot ne doit contenir que des lettres : les partitions qu'une recherche
+ * consulte pour un prfixe d'une lettre n'en prvoient pas d'autres.
+ */
+bool_t shard_add_count( shard_t shard, char *word, unsigned int count )
+{
+    /* Variables locales */
+    int          i;      /* Compteur  */
+    bool_t       result; /* Rsultat  */
+    shard_part_t part;   /* Partition */
+
+    /* Contrle des paramtres */
+    assert( shard );
+    assert( word );
+    assert( count != 0 );
+
+    /* Il faut un mot d'au moins deux lettres, et rien d'autre */
+    if (word[0] == '\0' || word[1] == '\0')
+	return FALSE;
+    for (i = 0; word[i]; i++)
+	if (!IS_ALPHA( word[i] ))
+	    return FALSE;
+
+    /* Conversion en minuscules */
+    for (i = 0; word[i]; i++)
+	if (IS_UPPER_CASE( word[i] ))
+	    word[i] = UPPER_TO_LOWER_CASE( word[i] );
+
+    /* Ajout du mot  sa partition */
+    part = shard->parts + SHARD_INDEX( shard, word[0], word[1] );
+    pthread_mutex_lock( &part->mutex );
+    result = tstree_add_key_count( part->tree, word, count ) ? TRUE : FALSE;
+    pthread_mutex_unlock( &part->mutex );
+
+    return result;
+}
+
+/**
+ * Ajoute au dictionnaire les mots d'une chane de caractres, dcoupe entre
+ * les threads (voir shard_set_thread_number()) : chacun range les mots de sa
+ * part dans leur partition, par lots de BATCH_SIZE mots au plus.
+ */
+bool_t shard_add_words_from_string( shard_t shard, char *string )
+{
+    /* Variables locales */
+    unsigned int i;      /* Compteur                */
+    unsigned int number; /* Nombre de parts         */
+    size_t       length; /* Longueur de la chane   */
+    char         *pos;   /* Limite entre deux parts */
+    bool_t       ok;     /* Pas d'erreur            */
+    pool_t       pool;   /* Groupe de threads       */
+    shard_feed_t feeds;  /* Parts des threads       */
+
+    /* Contrle des paramtres */
+    assert( shard );
+    assert( string );
+
+    if (!(pool = pool_new( shard->threads )))
+	return FALSE;
+    number = pool_get_thread_number( pool );
+    if (number == 0)
+	number = 1;
+    if (!(feeds = malloc( number * sizeof (shard_feed_s_t) ))) {
+	pool_delete( pool );
+	return FALSE;
+    }
+
+    /* Les listes en cache ne seront reconstruites qu'une fois les mots
+     * ajouts */
+    for (i = 0; i < shard->number; i++) {
+	pthread_mutex_lock( &shard->parts[i].mutex );
+	tstree_invalidate_cache( shard->parts[i].tree );
+	pthread_mutex_unlock( &shard->parts[i].mutex );
+    }
+
+    /* Dcoupage de la chane : chaque part se termine aprs un sparateur,
+     * pour que la fin de ses mots ne soit pas lue par la suivante */
+    length = strlen( string );
+    pos    = string;
+    for (i = 0; i < number; i++) {
+	feeds[i].shard = shard;
+	feeds[i].start = pos;
+	if (i + 1 < number) {
+	    if (string + length * (i + 1) / number > pos)
+		pos = string + length * (i + 1) / number;
+	    while (IS_ALPHA( *pos ))
+		pos++;
+	    if (*pos != '\0')
+		pos++;
+	} else
+	    pos = string + length;
+	feeds[i].end = pos;
+	pool_submit( pool, &feeds[i].task, shard_feed, feeds + i );
+    }
+
+    /* Attente des threads */
+    ok = TRUE;
+    for (i = 0; i < number; i++) {
+	pool_wait( pool, &feeds[i].task );
+	ok = ok && feeds[i].ok;
+    }
+
+    pool_delete( pool );
+    free( feeds );
+    return ok;
+}
+
+/**
+ * Recherche les `number' mots les plus utiliss commenant par `word' (tous
+ * si `number' est nul) dans les seules partitions que le prfixe peut
+ * atteindre. Le rsultat,  librer par free(), a la forme de celui de
+ * dict_get_most_used().
+ */
+char **shard_get_most_used( const shard_t shard, char *word,
+			    unsigned int number )
+{
+    /* Variables locales */
+    unsigned int        i, j;        /* Compteurs                       */
+    unsigned int        found;       /* Mots trouvs dans une partition */
+    unsigned int        total;       /* Nombre de candidats             */
+    unsigned int        capacity;    /* Candidats par partition         */
+    unsigned long       size;        /* Taille des candidats            */
+    unsigned long       offset;      /* Position du candidat suivant    */
+    unsigned long       mask;        /* Partitions consultes           */
+    void                *bigger;     /* Tableau agrandi                 */
+    char                *keys;       /* Chanes des candidats           */
+    char                *pos;        /* Position dans le rsultat       */
+    char                **result;    /* Rsultat : tableau de chanes   */
+    bool_t              ok;          /* Pas d'erreur                    */
+    tstree_node_t       *nodes;      /* Noeuds trouvs                  */
+    shard_part_t        part;        /* Partition courante              */
+    shard_candidate_s_t *candidates; /* Mots candidats                  */
+
+    /* Contrle des paramtres */
+    assert( shard );
+
+    /* Conversion en minuscules */
+    if (word) {
+	for (i = 0; word[i]; i++)
+	    if (IS_UPPER_CASE( word[i] ))
+		word[i] = UPPER_TO_LOWER_CASE( word[i] );
+    } else
+	word = "";
+
+    /* Nombre maximal de mots  trouver, par partition et en tout */
+    mask = shard_get_mask( shard, word );
+    if (number == 0) {
+	for (i = 0; i < shard->number; i++)
+	    if (mask & (1UL << i)) {
+		pthread_mutex_lock( &shard->parts[i].mutex );
+		number += tstree_get_key_number( shard->parts[i].tree );
+		pthread_mutex_unlock( &shard->parts[i].mutex );
+	    }
+	number++;
+    }
+    capacity = number;
+
+    /* Allocation des tableaux de travail */
+    nodes      = malloc( capacity * sizeof (tstree_node_t) );
+    candidates = NULL;
+    keys       = NULL;
+    ok         = nodes != NULL;
+
+    /* Recherche des mots dans chaque partition atteinte, copis sous son
+     * verrou */
+    total  = 0;
+    size   = 0;
+    offset = 0;
+    for (i = 0; ok && i < shard->number; i++) {
+	if (!(mask & (1UL << i)))
+	    continue;
+
+	part = shard->parts + i;
+	pthread_mutex_lock( &part->mutex );
+	found = capacity;
+	if (tstree_get_most_used( part->tree, word, nodes, &found ) &&
+	    found > 0) {
+	    /* Agrandissement des tableaux de candidats */
+	    for (j = 0; j < found; j++)
+		size += tstree_node_get_depth( nodes[j] ) + 1;
+	    if ((bigger = realloc( candidates, (total + found) *
+				   sizeof (shard_candidate_s_t) )))
+		candidates = bigger;
+	    else
+		ok = FALSE;
+	    if (ok && (bigger = realloc( keys, size )))
+		keys = bigger;
+	    else
+		ok = FALSE;
+
+	    /* Copie des mots */
+	    for (j = 0; ok && j < found; j++) {
+		candidates[total].count  = tstree_node_get_count( nodes[j] );
+		candidates[total].order  = total;
+		candidates[total].offset = offset;
+		ok = tstree_node_get_key_in_buffer( nodes[j], keys + offset,
+						    0 );
+		offset += tstree_node_get_depth( nodes[j] ) + 1;
+		total++;
+	    }
+	}
+	pthread_mutex_unlock( &part->mutex );
+    }
+    free( nodes );
+
+    /* Fusion des listes de chaque partition, par frquence dcroissante */
+    result = NULL;
+    if (ok && total > 0) {
+	if ((mask & (mask - 1)) != 0)
+	    qsort( candidates, total, sizeof (shard_candidate_s_t),
+		   shard_compare );
+	if (total > number)
+	    total = number;
+
+	/* Construction du rsultat */
+	for (size = 0, i = 0; i < total; i++)
+	    size += strlen( keys + candidates[i].offset ) + 1;
+	if ((result = malloc( number * sizeof (char *) + size ))) {
+	    pos = (char *) (result + number);
+	    for (i = 0; i < total; i++) {
+		strcpy( pos, keys + candidates[i].offset );
+		result[i] = pos;
+		pos += strlen( pos ) + 1;
+	    }
+	    while (i < number)
+		result[i++] = NULL;
+	}
+    }
+
+    /* Libration de la mmoire et retour du rsultat */
+    free( candidates );
+    free( keys );
+    return result;
+}
+
+/**
+ * Retourne le nombre de mots diffrents du dictionnaire.
+ */
+unsigned int shard_get_key_number( const shard_t shard )
+{
+    /* Variables locales */
+    unsigned int i;      /* Compteur      */
+    unsigned int number; /* Nombre de mots */
+
+    /* Contrle des paramtres */
+    assert( shard );
+
+    number = 0;
+    for (i = 0; i < shard->number; i++) {
+	pthread_mutex_lock( &shard->parts[i].mutex );
+	number += tstree_get_key_number( shard->parts[i].tree );
+	pthread_mutex_unlock( &shard->parts[i].mutex );
+    }
+
+    return number;
+}
+
+/**
+ * Obtient la quantit de mmoire rserve et utilise par le dictionnaire.
+ */
+void shard_get_memory_usage( const shard_t shard, unsigned long *reserved,
+			     unsigned long *used )
+{
+    /* Variables locales */
+    unsigned int  i;             /* Compteur                    */
+    unsigned long part_reserved; /* Mmoire rserve (partition) */
+    unsigned long part_used;     /* Mmoire utilise (partition) */
+
+    /* Contrle des paramtres */
+    assert( shard );
+    assert( reserved );
+    assert( used );
+
+    *reserved = sizeof (shard_s_t);
+    *used     = sizeof (shard_s_t);
+    for (i = 0; i < shard->number; i++) {
+	pthread_mutex_lock( &shard->parts[i].mutex );
+	tstree_get_memory_usage( shard->parts[i].tree, &part_reserved,
+				 &part_used );
+	pthread_mutex_unlock( &shard->parts[i].mutex );
+	*reserved += part_reserved;
+	*used     += part_used;
+    }
+}
+
+
+/*****************************************************************************
+ *
+ * FONCTIONS STATIQUES
+ *
+ */
+
+/**
+ * Retourne l'ensemble des partitions pouvant contenir des mots commenant
+ * par `word' (en minuscules), sous forme de masque de bits.
+ */
+static unsigned long shard_get_mask( const shard_t shard, const char *word )
+{
+    /* Contrle des paramtres */
+    assert( shard );
+    assert( word );
+
+    if (word[0] == '\0')
+	return shard->number == sizeof (unsigned long) * CHAR_BIT ?
+	    ~0UL : (1UL << shard->number) - 1;
+    if (word[1] == '\0')
+	return shard->masks[(unsigned char) word[0]];
+    return 1UL << SHARD_INDEX( shard, word[0], word[1] );
+}
+
+/**
+ * Dcoupe en mots la part de chane confie  un thread, les convertit en
+ * minuscules et les range dans le lot de leur partition, ajout  celle-ci
+ * ds qu'il est plein.
+ */
+static void shard_feed( void *data )
+{
+    /* Variables locales */
+    shard_feed_t feed = data; /* Part du thread */
+    unsigned int i;           /* Compteur       */
+
+    for (i = 0; i < feed->shard->number; i++)
+	feed->counts[i] = 0;
+
+    if (!(feed->ok = alpha_split( feed->start, feed->end, shard_queue,
+				  feed )))
+	return;
+
+    /* Ajout des derniers lots */
+    for (i = 0; i < feed->shard->number; i++)
+	if (feed->counts[i] > 0 && !shard_flush( feed, i )) {
+	    feed->ok = FALSE;
+	    return;
+	}
+}
+
+/**
+ * Met en attente un mot trouv par alpha_split() dans le lot de sa
+ * partition, ajout  celle-ci ds qu'il est plein.
+ */
+static bool_t shard_queue( char *word, unsigned int length, void *data )
+{
+    /* Variables locales */
+    shard_feed_t feed = data; /* Part du thread     */
+    unsigned int index;       /* Partition du mot   */
+
+    /* Contrle des paramtres */
+    assert( word );
+    assert( feed );
+
+    if (length < 2)
+	return TRUE;
+
+    index = SHARD_INDEX( feed->shard, word[0], word[1] );
+    feed->words[index][feed->counts[index]].start  = word;
+    feed->words[index][feed->counts[index]].length = length;
+    return ++feed->counts[index] < BATCH_SIZE || shard_flush( feed, index );
+}
+
+/**
+ * Ajoute  sa partition le lot de mots en attente d'un thread, en une seule
+ * prise du verrou.
+ */
+static bool_t shard_flush( shard_feed_t feed, unsigned int index )
+{
+    /* Variables locales */
+    unsigned int i;    /* Compteur                 */
+    char         save; /* Caractre suivant un mot */
+    bool_t       ok;   /* Pas d'erreur             */
+    shard_word_t word; /* Mot courant              */
+    shard_part_t part; /* Partition                */
+
+    /* Contrle des paramtres */
+    assert( feed );
+    assert( index < feed->shard->number );
+
+    part = feed->shard->parts + index;
+    ok   = TRUE;
+
+    pthread_mutex_lock( &part->mutex );
+    for (i = 0; ok && i < feed->counts[index]; i++) {
+	word = feed->words[index] + i;
+	save = word->start[word->length];
+	word->start[word->length] = '\0';
+	ok = tstree_add_key( part->tree, word->start ) != NULL;
+	word->start[word->length] = save;
+    }
+    pthread_mutex_unlock( &part->mutex );
+
+    feed->counts[index] = 0;
+    return ok;
+}
+
+/**
+ * Compare deux mots candidats pour le tri : par frquence dcroissante, puis
+ * dans l'ordre o ils ont t obtenus.
+ */
+static int shard_compare( const void *first, const void *second )
+{
+    /* Variables locales */
+    const shard_candidate_s_t *a = first;  /* Premier candidat */
+    const shard_candidate_s_t *b = second; /* Second candidat  */
+
+    if (a->count != b->count)
+	return a->count > b->count ? -1 : 1;
+    return a->order < b->order ? -1 : a->order > b->order;
+}
+
+/* Fin du fichier */
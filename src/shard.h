@@ -0,0 +1,82 @@
+/*
+ * ---------------------------------------------------------------------------
+ *
+ * Act : Auto-Completion Tree -- Implmentation d'un arbre d'auto-compltion
+ * Copyright (c) 2004 Benjamin Gaillard
+ *
+ * ---------------------------------------------------------------------------
+ *
+ * Fichier     : shard.h
+ *
+ * Description : Ce fichier contient les prototypes des fonctions externes du
+ *               fichier `shard.c' pour pouvoir les utiliser dans d'autres
+ *               modules.
+ *
+ * Commentaire : Pour plus d'informations sur les fonctions et leurs
+ *               paramtres, voir le fichier `shard.c'.
+ *
+ * ---------------------------------------------------------------------------
+ *
+ * Ce programme est un logiciel libre ; vous pouvez le redistribuer et/ou le
+ * modifier conformment aux dispositions de la Licence Publique Gnrale GNU,
+ * telle que publie par la Free Software Foundation ; version 2 de la
+ * licence, ou encore ( votre convenance) toute version ultrieure.
+ *
+ * Ce programme est distribu dans l'espoir qu'il sera utile, mais SANS AUCUNE
+ * GARANTIE ; sans mme la garantie implicite de COMMERCIALISATION ou
+ * D'ADAPTATION  UN OBJET PARTICULIER. Pour plus de dtail, voir la Licence
+ * Publique Gnrale GNU.
+ *
+ * Vous devez avoir reu un exemplaire de la Licence Publique Gnrale GNU en
+ * mme temps que ce programme ; si ce n'est pas le cas, crivez  la Free
+ * Software Foundation Inc., 675 Mass Ave, Cambridge, MA 02139, tats-Unis.
+ *
+ * ---------------------------------------------------------------------------
+ */
+
+
+/* Pour ne pas include plusieurs fois cet en-tte */
+#ifndef _SHARD_H_
+#define _SHARD_H_
+
+/* En-ttes locaux */
+#include "bool.h"
+
+/* Traitement spcial si utilisation dans un programme C++ (dbut) */
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+
+/* Nombre maximal de partitions d'un dictionnaire */
+#define SHARD_MAX 32
+
+/* Types de donnes */
+typedef struct shard *shard_t; /* Dictionnaire partitionn */
+
+/* Prototypes des fonctions externes */
+shard_t      shard_new( unsigned int number );
+void         shard_delete( shard_t shard );
+unsigned int shard_get_part_number( const shard_t shard );
+void         shard_set_thread_number( shard_t shard, unsigned int threads );
+bool_t       shard_add( shard_t shard, char *word );
+bool_t       shard_add_count( shard_t shard, char *word,
+			      unsigned int count );
+bool_t       shard_add_words_from_string( shard_t shard, char *string );
+char       **shard_get_most_used( const shard_t shard, char *word,
+				  unsigned int number );
+unsigned int shard_get_key_number( const shard_t shard );
+void         shard_get_memory_usage( const shard_t shard,
+				     unsigned long *reserved,
+				     unsigned long *used );
+
+
+/* Traitement spcial si utilisation dans un programme C++ (fin) */
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* !_SHARD_H_ */
+
+/* Fin du fichier */
@@ -33,50 +33,370 @@
  *
  * ---------------------------------------------------------------------------
  */
-
+/* Options de compilation (pour posix_memalign()) */
+#define _POSIX_C_SOURCE 200112L
 
 /* En-ttes standard */
 #include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
 #include <assert.h>
+#include <pthread.h>
+#if defined( __SSE2__ ) && defined( __GNUC__ )
+# include <emmintrin.h>
+#endif
 
 /* En-ttes locaux */
+#include "alpha.h"
 #include "tstree.h"
 
 
+/*****************************************************************************
+ *
+ * CONSTANTES
+ *
+ */
+
+/* Nombre de noeuds contenus dans un bloc de l'arne (puissance de deux) */
+#define BLOCK_SHIFT 12
+#define BLOCK_NODES (1 << BLOCK_SHIFT) /* 4096 */
+#define BLOCK_MASK  (BLOCK_NODES - 1)
+
+/* Taille d'un bloc de noeuds en octets, qui est aussi son alignement */
+#define BLOCK_SIZE (BLOCK_NODES * sizeof (tstree_node_s_t))
+
+/* Taille initiale de la table des blocs */
+#define BLOCK_TABLE_SIZE 16
+
+/* Taille initiale de la pile de parcours (agrandie au besoin) */
+#define STACK_SIZE 64
+
+/* Nombre de noeuds traverss mmoriss lors de l'ajout d'une cl */
+#define PATH_SIZE 256
+
+/* Nombre maximal de frres traverss pour un caractre (un par valeur) */
+#define MAX_BROTHERS 256
+
+/* Longueur des prfixes dont les fils sont copis en largeur, et non en
+ * profondeur, lors du compactage */
+#define BREADTH_DEPTH 2
+
+/* Nombre de codes des caractres indexs par les tables d'accs direct aux
+ * deux premiers niveaux : les minuscules de alpha.h, plus le code 0 rserv
+ * aux autres caractres */
+#define DIRECT_CODES 57
+
+/* Nombre de caractres d'un lment de frres larges (la taille d'un
+ * registre SSE2), et nombre de frres  partir duquel un ensemble de frres
+ * est doubl par de tels lments par dfaut */
+#define WIDE_CHARS     16
+#define WIDE_THRESHOLD 8
+
+/* Taille initiale de la table des lments de frres larges */
+#define WIDE_TABLE_SIZE 256
+
+/* Nombre maximal d'anciennes tables de blocs conserves pendant les ajouts
+ * concurrents (deux par agrandissement, la taille doublant  chaque fois) */
+#define RETIRED_SIZE 64
+
+/* Nombre de cls retenues sans allocation lors d'une slection */
+#define ENTRIES_SIZE 64
+
+/* Nombre initial de listes en cache (agrandi au besoin) */
+#define CACHE_LISTS 1024
+
+
+/*****************************************************************************
+ *
+ * MACROS
+ *
+ */
+
+/* Macro permettant d'obtenir un noeud  partir de son index */
+#define NODE( tree, index ) ((tree)->blocks[(index) >> BLOCK_SHIFT] + \
+			     ((index) & BLOCK_MASK))
+
+/* Macro permettant d'obtenir les donnes froides du bloc d'un noeud */
+#define COLD( tree, index ) ((tree)->colds[(index) >> BLOCK_SHIFT])
+
+/* Macros permettant d'accder  la frquence et au parent d'un noeud */
+#define COUNT( tree, index )  (COLD( tree, index )->counts[(index) & \
+							   BLOCK_MASK])
+#define PARENT( tree, index ) (COLD( tree, index )->parents[(index) & \
+							    BLOCK_MASK])
+
+/* Macro permettant d'accder  la frquence maximale du sous-arbre d'un
+ * noeud (frres et fils compris) */
+#define MAXIMUM( tree, index ) (COLD( tree, index )->maxima[(index) & \
+							     BLOCK_MASK])
+
+/* Macro permettant d'accder au numro de la liste en cache d'un noeud (0 :
+ * pas de liste) */
+#define SLOT( tree, index ) (COLD( tree, index )->slots[(index) & BLOCK_MASK])
+
+/* Macro permettant d'obtenir une liste en cache  partir de son numro */
+#define LIST( tree, number ) ((tree)->lists + (number) * (tree)->cachesize)
+
+/* Macro indiquant si une cl retenue est moins bonne qu'une autre : moins
+ * frquente, ou aussi frquente mais numre aprs */
+#define WORSE( a, b ) ((a)->count < (b)->count || \
+		       ((a)->count == (b)->count && (a)->order > (b)->order))
+
+/* Macros permettant d'obtenir un noeud et les donnes froides de son bloc
+ * pendant les ajouts concurrents : la table des blocs peut tre remplace
+ * par un autre thread */
+#define SHARED_NODE( tree, index ) \
+    (__atomic_load_n( __atomic_load_n( &(tree)->blocks, __ATOMIC_ACQUIRE ) + \
+		      ((index) >> BLOCK_SHIFT), __ATOMIC_ACQUIRE ) + \
+     ((index) & BLOCK_MASK))
+#define SHARED_COLD( tree, index ) \
+    __atomic_load_n( __atomic_load_n( &(tree)->colds, __ATOMIC_ACQUIRE ) + \
+		     ((index) >> BLOCK_SHIFT), __ATOMIC_ACQUIRE )
+
+/* Macro permettant d'obtenir l'en-tte du bloc contenant un noeud */
+#define HEADER( node ) ((tstree_header_t) ((uintptr_t) (node) & \
+					   ~(uintptr_t) (BLOCK_SIZE - 1)))
+
+
 /*****************************************************************************
  *
  * TYPES DE DONNES
  *
  */
 
+/* Index d'un noeud dans l'arne (0 : pas de noeud) */
+typedef unsigned int tstree_index_t;
+
+/* Noeud de l'arbre : seules les donnes utilises lors des parcours y sont
+ * conserves afin de tenir en 16 octets */
+typedef struct tstree_node
+{
+    tstree_index_t brothers[2]; /* Frres infrieur et suprieur */
+    tstree_index_t child;       /* Fils                          */
+    char           chr;         /* Caractre correspondant       */
+    unsigned short wide;        /* Frres larges (0 : aucun)     */
+}
+tstree_node_s_t;
+
+/* lment de frres larges : les caractres d'au plus WIDE_CHARS frres,
+ * compars en une fois, et les noeuds correspondants ; un ensemble de
+ * frres assez grand est doubl d'une chane de tels lments, dsigne par
+ * la racine de son arbre binaire */
+typedef struct tstree_wide
+{
+    char           chrs[WIDE_CHARS];  /* Caractres des frres    */
+    tstree_index_t nodes[WIDE_CHARS]; /* Frres                   */
+    unsigned int   count;             /* Nombre de frres         */
+    unsigned int   next;              /* lment suivant (0 : fin) */
+}
+tstree_wide_s_t, *tstree_wide_t;
+
+/* Donnes froides d'un bloc, ranges  part des noeuds */
+typedef struct tstree_cold
+{
+    tstree_t       tree;                 /* Arbre propritaire du bloc */
+    tstree_index_t base;                 /* Index du premier noeud     */
+    unsigned int   counts[BLOCK_NODES];  /* Frquences des mots        */
+    tstree_index_t parents[BLOCK_NODES]; /* Noeuds parents             */
+    unsigned int   maxima[BLOCK_NODES];  /* Frquences maximales       */
+    unsigned int   *slots;               /* Listes en cache des noeuds */
+}
+tstree_cold_s_t, *tstree_cold_t;
+
+/* En-tte d'un bloc, qui occupe la place du premier noeud de celui-ci */
+typedef union tstree_header
+{
+    tstree_node_s_t node; /* Place occupe        */
+    tstree_cold_t   cold; /* Donnes froides      */
+}
+tstree_header_s_t, *tstree_header_t;
+
+/* tat des ajouts concurrents */
+typedef struct tstree_shared
+{
+    pthread_mutex_t mutex;                  /* Verrou des allocations   */
+    unsigned int    nretired;               /* Nombre d'anciennes tables */
+    void            *retired[RETIRED_SIZE]; /* Anciennes tables de blocs */
+}
+tstree_shared_s_t, *tstree_shared_t;
+
 /* Objet arbre */
 typedef struct tstree
 {
-    tstree_node_t root;  /* Racine                */
-    unsigned int  count; /* Nombre de noeuds      */
-    unsigned int  depth; /* Profondeur de l'arbre */
+    tstree_index_t root;      /* Racine                      */
+    unsigned int   count;     /* Nombre de noeuds            */
+    unsigned int   depth;     /* Profondeur de l'arbre       */
+    tstree_index_t next;      /* Prochain index libre        */
+    unsigned int   nblocks;   /* Nombre de blocs allous     */
+    unsigned int   maxblocks; /* Taille de la table de blocs */
+    tstree_node_t  *blocks;   /* Blocs de noeuds             */
+    tstree_cold_t  *colds;    /* Donnes froides des blocs   */
+
+    /* Listes en cache des cls les plus frquentes de chaque prfixe */
+    unsigned int   cachesize;  /* Taille des listes (0 : pas de cache) */
+    unsigned int   cachedepth; /* Profondeur maximale (0 : illimite)  */
+    bool_t         cachevalid; /* Listes  jour                        */
+    unsigned int   nlists;     /* Nombre de listes utilises           */
+    unsigned int   maxlists;   /* Nombre de listes alloues            */
+    tstree_index_t *lists;     /* Listes, ranges les unes  la suite  */
+
+    /* Rquilibrage automatique des frres, aprs au moins `rebalance'
+     * ajouts et autant que de cls dans l'arbre */
+    unsigned int   rebalance; /* Ajouts minimum (0 : aucun rquilibrage) */
+    unsigned int   added;     /* Ajouts depuis le dernier rquilibrage   */
+    unsigned int   suspended; /* Suspensions en cours                     */
+
+    /* Accs direct aux prfixes d'un et deux caractres, par le code
+     * compact de chacun d'eux (0 : caractre non index) */
+    bool_t         direct;               /* Tables utilises    */
+    unsigned char  codes[UCHAR_MAX + 1]; /* Code des caractres */
+    tstree_index_t firsts[DIRECT_CODES]; /* Premier niveau      */
+    tstree_index_t seconds[DIRECT_CODES *
+			   DIRECT_CODES]; /* Deuxime niveau    */
+
+    /* Frres larges des ensembles de frres les plus grands */
+    unsigned int   widening; /* Seuil de doublement (0 : aucun) */
+    unsigned int   nwides;   /* Nombre d'lments utiliss      */
+    unsigned int   maxwides; /* Nombre d'lments allous       */
+    tstree_wide_t  wides;    /* lments                        */
+
+    /* Ajouts concurrents en cours (NULL : aucun) */
+    tstree_shared_t shared;
 }
 tstree_s_t;
 
-/* Noeud de l'arbre */
-typedef struct tstree_node
+/* lment de la pile de parcours : un noeud dont les frres infrieurs sont
+ * en cours de parcours, ou dont le fils l'est une fois le noeud signal */
+typedef struct tstree_frame
 {
-    tstree_node_t parent, brothers[2], child; /* Parents, frres et fils */
-    unsigned int  depth;                      /* Profondeur du noeud     */
-    char          chr;                        /* Caractre correspondant */
-    unsigned int  count;                      /* Frquence du mot        */
+    tstree_index_t index; /* Noeud              */
+    bool_t         visit; /* Noeud dj signal */
 }
-tstree_node_s_t;
+tstree_frame_s_t, *tstree_frame_t;
+
+/* Pile de parcours */
+typedef struct tstree_stack
+{
+    unsigned int     top;               /* Nombre d'lments  */
+    unsigned int     size;              /* Taille de la pile  */
+    tstree_frame_t   frames;            /* lments           */
+    tstree_frame_s_t local[STACK_SIZE]; /* Pile initiale      */
+}
+tstree_stack_s_t, *tstree_stack_t;
 
+/* Cl retenue lors de la recherche des cls les plus frquentes */
+typedef struct tstree_entry
+{
+    unsigned int   count; /* Frquence                  */
+    unsigned int   order; /* Rang dans l'numration    */
+    tstree_index_t index; /* Noeud                      */
+}
+tstree_entry_s_t, *tstree_entry_t;
 
-/*****************************************************************************
- *
- * VARIABLES STATIQUES
- *
- */
+/* Curseur d'numration des cls commenant par un prfixe */
+typedef struct tstree_cursor
+{
+    tstree_t         tree;   /* Arbre parcouru                     */
+    tstree_index_t   prefix; /* Noeud du prfixe,  signaler d'abord */
+    tstree_index_t   next;   /* Prochain sous-arbre  parcourir    */
+    unsigned int     min;    /* Frquence  dpasser               */
+    bool_t           failed; /* chec d'allocation de la pile      */
+    tstree_stack_s_t stack;  /* Pile de parcours                   */
+}
+tstree_cursor_s_t;
+
+/* Objet d'insertion de cls tries, chaque cl reprenant le chemin de la
+ * prcdente aprs leur prfixe commun */
+typedef struct tstree_inserter
+{
+    tstree_t       tree;     /* Arbre complt                          */
+    unsigned int   depth;    /* Longueur de la cl prcdente           */
+    unsigned int   size;     /* Taille alloue pour le chemin           */
+    unsigned int   maxdepth; /* Taille alloue pour les fins            */
+    tstree_index_t *path;    /* Noeuds traverss pour la cl prcdente */
+    unsigned int   *ends;    /* Longueur du chemin aprs chaque caractre */
+}
+tstree_inserter_s_t;
+
+/* Intervalle de cls tries de mme prfixe dont les frres restent 
+ * construire */
+typedef struct tstree_range
+{
+    unsigned int   first;  /* Premire cl                  */
+    unsigned int   last;   /* Cl suivant la dernire       */
+    unsigned int   depth;  /* Longueur du prfixe commun    */
+    tstree_index_t parent; /* Noeud du prfixe (0 : racine) */
+}
+tstree_range_s_t, *tstree_range_t;
+
+/* Frre  crer pour les cls d'un intervalle ayant le mme caractre */
+typedef struct tstree_group
+{
+    unsigned int first;   /* Premire cl prolongeant le frre */
+    unsigned int last;    /* Cl suivant la dernire           */
+    unsigned int count;   /* Frquence de la cl du frre      */
+    unsigned int maximum; /* Frquence maximale des cls       */
+    double       weight;  /* Frquence totale des cls         */
+    char         chr;     /* Caractre                         */
+}
+tstree_group_s_t, *tstree_group_t;
+
+/* Construction d'un arbre  partir de cls tries */
+typedef struct tstree_builder
+{
+    tstree_t           tree;                 /* Arbre construit            */
+    char *const        *keys;                /* Cls tries                */
+    const unsigned int *counts;              /* Frquences (NULL : 1)      */
+    bool_t             weighted;             /* Coupe selon les frquences */
+    unsigned int       top;                  /* Intervalles en attente     */
+    unsigned int       size;                 /* Taille de la pile          */
+    tstree_range_t     ranges;               /* Pile des intervalles       */
+    tstree_group_s_t   groups[MAX_BROTHERS]; /* Frres du niveau courant   */
+}
+tstree_builder_s_t, *tstree_builder_t;
+
+/* lment de la pile d'une fusion : ensemble de frres de l'autre arbre 
+ * fusionner avec celui d'un noeud, ou noeud  recopier avec ses frres et
+ * son fils */
+typedef struct tstree_merge
+{
+    tstree_index_t source; /* Noeud de l'autre arbre             */
+    tstree_index_t parent; /* Noeud du prfixe (0 : racine)      */
+    tstree_index_t *link;  /* Lien vers la copie (NULL : fusion) */
+}
+tstree_merge_s_t, *tstree_merge_t;
+
+/* Fusion d'un arbre dans un autre */
+typedef struct tstree_merger
+{
+    tstree_t       tree;  /* Arbre complt      */
+    tstree_t       other; /* Arbre fusionn      */
+    unsigned int   top;   /* lments en attente */
+    unsigned int   size;  /* Taille de la pile   */
+    tstree_merge_t items; /* Pile des lments   */
+}
+tstree_merger_s_t, *tstree_merger_t;
 
-static tstree_callback_t walk_callback;  /* Callback utilis         */
-static void              *callback_data; /* Donnes pour le callback */
+/* Ensemble de frres  rquilibrer, avec la frquence totale des cls
+ * qui prolongent chacun */
+typedef struct tstree_level
+{
+    tstree_index_t parent;               /* Noeud du prfixe (0 : racine) */
+    unsigned int   number;               /* Nombre de frres              */
+    unsigned int   next;                 /* Prochain frre  visiter      */
+    tstree_index_t nodes[MAX_BROTHERS];  /* Frres, dans l'ordre          */
+    double         totals[MAX_BROTHERS]; /* Frquences totales des fils   */
+}
+tstree_level_s_t, *tstree_level_t;
+
+/* Noeud  visiter lors du calcul des comparaisons entre frres */
+typedef struct tstree_visit
+{
+    tstree_index_t index; /* Noeud                               */
+    unsigned int   cost;  /* Comparaisons avant d'atteindre le noeud */
+}
+tstree_visit_s_t, *tstree_visit_t;
 
 
 /*****************************************************************************
@@ -85,10 +405,101 @@ static void              *callback_data; /* Donn
  *
  */
 
-static tstree_node_t tstree_node_new( const tstree_node_t parent, char chr );
-static void          tstree_node_delete( tstree_node_t node );
-static tstree_node_t tstree_get_node( const tstree_t tree, const char *key );
-static bool_t        tstree_walk_subnodes( const tstree_node_t node );
+static tstree_index_t tstree_node_new( tstree_t tree, tstree_index_t parent,
+				       char chr );
+static tstree_index_t tstree_node_index( const tstree_node_t node,
+					 tstree_t *tree );
+static bool_t         tstree_block_new( tstree_t tree );
+static void           tstree_blocks_free( tstree_t tree );
+static tstree_index_t tstree_get_node( const tstree_t tree,
+				       const char *key );
+static bool_t         tstree_select( const tstree_t tree,
+				     tstree_index_t prefix,
+				     tstree_node_t *nodes,
+				     unsigned int *number );
+static int            tstree_entry_compare( const void *first,
+					    const void *second );
+static void           tstree_heap_up( tstree_entry_t heap,
+				      unsigned int pos );
+static void           tstree_heap_down( tstree_entry_t heap,
+					unsigned int size,
+					unsigned int pos );
+static bool_t         tstree_entries_grow( tstree_entry_t *entries,
+					   unsigned int *size,
+					   tstree_entry_t local );
+static int            tstree_compare_key( const tstree_t tree,
+					  tstree_index_t index,
+					  const char *key,
+					  unsigned int length );
+static tstree_index_t *tstree_cache_get( tstree_t tree,
+					 tstree_index_t index );
+static void           tstree_cache_update( tstree_t tree, const char *key,
+					   unsigned int length,
+					   tstree_index_t index );
+static bool_t         tstree_cache_rebuild( tstree_t tree );
+static void           tstree_update_maxima( tstree_t tree, const char *key,
+					    unsigned int count );
+static tstree_node_t  tstree_add_count( tstree_t tree, const char *key,
+					unsigned int pos,
+					tstree_index_t index,
+					unsigned int number,
+					const tstree_index_t *path,
+					unsigned int length,
+					unsigned int size );
+static tstree_index_t tstree_shared_node_new( tstree_t tree );
+static bool_t         tstree_shared_raise( tstree_t tree,
+					   tstree_index_t index,
+					   unsigned int count );
+static void           tstree_shared_maxima( tstree_t tree, const char *key,
+					    unsigned int count );
+static bool_t         tstree_inserter_grow( tstree_inserter_t inserter,
+					    unsigned int pos,
+					    unsigned int length );
+static bool_t         tstree_build_level( tstree_builder_t builder,
+					  const tstree_range_s_t *range );
+static bool_t         tstree_build_brothers( tstree_builder_t builder,
+					     unsigned int first,
+					     unsigned int last,
+					     const tstree_range_s_t *range,
+					     tstree_index_t *link );
+static bool_t         tstree_merge_push( tstree_merger_t merger,
+					 tstree_index_t source,
+					 tstree_index_t parent,
+					 tstree_index_t *link );
+static bool_t         tstree_merge_brothers( tstree_merger_t merger,
+					     tstree_index_t source,
+					     tstree_index_t parent );
+static bool_t         tstree_merge_copy( tstree_merger_t merger,
+					 const tstree_merge_s_t *item );
+static void           tstree_raise_maxima( tstree_t tree,
+					   tstree_index_t index,
+					   unsigned int count );
+static void           tstree_rebalance_list( const tstree_t tree,
+					     tstree_level_t level,
+					     tstree_index_t parent );
+static tstree_index_t tstree_rebalance_brothers( tstree_t tree,
+						 const tstree_index_t *nodes,
+						 const double *totals,
+						 unsigned int first,
+						 unsigned int last );
+static tstree_index_t tstree_wide_find( const tstree_t tree,
+					unsigned int wide, char chr );
+static void           tstree_wide_add( tstree_t tree,
+				       tstree_index_t parent,
+				       tstree_index_t index );
+static bool_t         tstree_wide_promote( tstree_t tree,
+					   tstree_index_t root );
+static unsigned int   tstree_wide_new( tstree_t tree,
+				       unsigned int number );
+static bool_t         tstree_wide_rebuild( tstree_t tree );
+static void           tstree_cursor_init( tstree_cursor_t cursor,
+					  const tstree_t tree,
+					  const char *key );
+static void           tstree_cursor_start( tstree_cursor_t cursor,
+					   tstree_index_t prefix );
+static void           tstree_cursor_free( tstree_cursor_t cursor );
+static tstree_index_t tstree_cursor_step( tstree_cursor_t cursor );
+static bool_t         tstree_stack_grow( tstree_stack_t stack );
 
 
 /*****************************************************************************
@@ -103,13 +514,51 @@ static bool_t        tstree_walk_subnodes( const tstree_node_t node );
 tstree_t tstree_new( void )
 {
     /* Variables locales */
-    tstree_t tree = malloc( sizeof (tstree_s_t) ); /* L'arbre cr */
+    tstree_t     tree = malloc( sizeof (tstree_s_t) ); /* L'arbre cr */
+    unsigned int i;                                    /* Compteur     */
+    unsigned int code;                                 /* Code courant */
+
+    /* La taille d'un noeud doit tre une puissance de deux */
+    assert( (sizeof (tstree_node_s_t) & (sizeof (tstree_node_s_t) - 1)) ==
+	    0 );
 
     /* Initialisation de l'objet */
     if (tree) {
-	tree->root  = NULL;
-	tree->count = 0;
-	tree->depth = 0;
+	tree->root      = 0;
+	tree->count     = 0;
+	tree->depth     = 0;
+	tree->next      = 0;
+	tree->nblocks   = 0;
+	tree->maxblocks = 0;
+	tree->blocks    = NULL;
+	tree->colds     = NULL;
+
+	tree->cachesize  = 0;
+	tree->cachedepth = 0;
+	tree->cachevalid = FALSE;
+	tree->nlists     = 0;
+	tree->maxlists   = 0;
+	tree->lists      = NULL;
+
+	tree->rebalance = 0;
+	tree->added     = 0;
+	tree->suspended = 0;
+
+	/* Codes des lettres minuscules, seules prsentes dans les mots du
+	 * dictionnaire */
+	tree->direct = TRUE;
+	for (i = 0, code = 0; i <= UCHAR_MAX; i++)
+	    tree->codes[i] = IS_LOWER_CASE( (char) i ) ? ++code : 0;
+	assert( code == DIRECT_CODES - 1 );
+	memset( tree->firsts, 0, sizeof (tree->firsts) );
+	memset( tree->seconds, 0, sizeof (tree->seconds) );
+
+	tree->widening = WIDE_THRESHOLD;
+	tree->nwides   = 0;
+	tree->maxwides = 0;
+	tree->wides    = NULL;
+
+	tree->shared = NULL;
 
 	return tree;
     }
@@ -126,19 +575,93 @@ void tstree_delete( tstree_t tree )
     /* Contrle des paramtres */
     assert( tree );
 
-    /* Libration de la mmoire */
-    if (tree->root)
-	tstree_node_delete( tree->root );
+    /* Libration des blocs de l'arne, puis de l'arbre */
+    tstree_blocks_free( tree );
+    free( tree->lists );
+    free( tree->wides );
     free( tree );
 }
 
+/**
+ * Cre une copie conforme d'un arbre : mmes noeuds aux mmes index, mmes
+ * listes en cache et mmes rglages.
+ */
+tstree_t tstree_clone( const tstree_t tree )
+{
+    /* Variables locales */
+    unsigned int  i;     /* Compteur              */
+    tstree_t      clone; /* Copie                 */
+    tstree_cold_t cold;  /* Donnes froides copies */
+    size_t        size;  /* Taille des listes     */
+
+    /* Vrification des paramtres */
+    assert( tree );
+    assert( !tree->shared );
+
+    /* Copie des champs, l'arne et les tables tant alloues ensuite */
+    if (!(clone = malloc( sizeof (tstree_s_t) )))
+	return NULL;
+    *clone           = *tree;
+    clone->nblocks   = 0;
+    clone->maxblocks = 0;
+    clone->blocks    = NULL;
+    clone->colds     = NULL;
+    clone->maxlists  = 0;
+    clone->lists     = NULL;
+    clone->maxwides  = 0;
+    clone->wides     = NULL;
+
+    /* Copie des blocs, sans leur en-tte, et de leurs donnes froides */
+    for (i = 0; i < tree->nblocks; i++) {
+	if (!tstree_block_new( clone )) {
+	    tstree_delete( clone );
+	    return NULL;
+	}
+	memcpy( clone->blocks[i] + 1, tree->blocks[i] + 1,
+		BLOCK_SIZE - sizeof (tstree_node_s_t) );
+
+	cold = clone->colds[i];
+	memcpy( cold->counts, tree->colds[i]->counts, sizeof (cold->counts) );
+	memcpy( cold->parents, tree->colds[i]->parents,
+		sizeof (cold->parents) );
+	memcpy( cold->maxima, tree->colds[i]->maxima, sizeof (cold->maxima) );
+	if (cold->slots)
+	    memcpy( cold->slots, tree->colds[i]->slots,
+		    BLOCK_NODES * sizeof (unsigned int) );
+    }
+
+    /* Copie des listes en cache et des frres larges */
+    if (tree->maxlists != 0) {
+	size = (size_t) tree->maxlists * tree->cachesize *
+	    sizeof (tstree_index_t);
+	if (!(clone->lists = malloc( size ))) {
+	    tstree_delete( clone );
+	    return NULL;
+	}
+	memcpy( clone->lists, tree->lists, size );
+	clone->maxlists = tree->maxlists;
+    }
+    if (tree->maxwides != 0) {
+	if (!(clone->wides = malloc( tree->maxwides *
+				     sizeof (tstree_wide_s_t) ))) {
+	    tstree_delete( clone );
+	    return NULL;
+	}
+	memcpy( clone->wides, tree->wides,
+		tree->nwides * sizeof (tstree_wide_s_t) );
+	clone->maxwides = tree->maxwides;
+    }
+
+    return clone;
+}
+
 /**
  * Retourne le noeud racine de l'arbre.
  */
 tstree_node_t tstree_get_root( const tstree_t tree )
 {
     assert( tree );
-    return tree->root;
+    return tree->root ? NODE( tree, tree->root ) : NULL;
 }
 
 /**
@@ -160,287 +683,3064 @@ unsigned int tstree_get_key_number( const tstree_t tree )
 }
 
 /**
- * Ajoute une cl (un mot) dans l'arbre.
+ * Retourne le nombre de noeuds de l'arbre.
  */
-tstree_node_t tstree_add_key( tstree_t tree, const char *key )
+unsigned int tstree_get_node_number( const tstree_t tree )
 {
-    /* Variables locales */
-    unsigned int    pos;    /* Caractre courant de la cl */
-    tstree_node_t   node;   /* Noeud courant               */
-    tstree_node_t   parent; /* Noeud parent                */
-    tstree_node_t   *next;  /* Noeud suivant               */
-    tstree_node_s_t root;   /* Racine de l'arbre           */
-
-    /* Vrification des paramtres */
     assert( tree );
-    assert( key );
-    assert( key[0] != '\0' );
-
-    /* Initialisation des donnes */
-    root.child = tree->root;
-    root.depth = 0;
-    node = &root;
-
-    /* Parcourt chaque caractre de la chane */
-    for (pos = 0; key[pos]; pos++)
-	if (!node->child) {
-	    /* L'enfant existe, passe au caractre suivant */
-	    if ((node->child = tstree_node_new( node, key[pos] )))
-		node = node->child;
-	    else
-		return NULL;
-	} else {
-	    /* Cration de l'enfant */
-	    parent = node;
-	    node = node->child;
-
-	    while (node->chr != key[pos]) {
-		next = node->brothers + (node->chr > key[pos] ? 0 : 1);
-
-		if (*(next))
-		    node = *next;
-		else {
-		    if ((*next = tstree_node_new( parent, key[pos] ))) {
-			node = *next;
-			break;
-		    }
-		    return NULL;
-		}
-	    }
-	}
-
-    /* Ajout de la cl au compteur */
-    if (node->count == 0)
-	tree->count++;
-    node->count++;
-
-    /* Mise  jour de la profondeur de l'arbre */
-    tree->root = root.child;
-    if (tree->depth < pos)
-	tree->depth = pos;
-
-    /* Retour du noeud cr */
-    return node;
+    return tree->next - tree->nblocks;
 }
 
 /**
- * Parcourt les noeuds et appelle un callback  chaque cl dcouverte.
+ * Obtient la quantit de mmoire rserve par l'arne de l'arbre ainsi que
+ * celle rellement occupe par les noeuds.
  */
-bool_t tstree_get_keys( const tstree_t tree, const char *key,
-			tstree_callback_t callback, void *data )
+void tstree_get_memory_usage( const tstree_t tree, unsigned long *reserved,
+			      unsigned long *used )
 {
     /* Variables locales */
-    tstree_node_t node; /* Noeud courant */
+    unsigned long nodes; /* Nombre de noeuds allous */
 
     /* Vrification des paramtres */
     assert( tree );
-    assert( callback );
-
-    /* Effectue le parcours */
-    if ((node = tstree_get_node( tree, key ))) {
-	if (node->depth > 1 && node->parent->count != 0 &&
-	    !callback( node->parent, data ))
-	    return FALSE;
-
-	walk_callback = callback;
-	callback_data = data;
-
-	return tstree_walk_subnodes( node );
-    }
-
-    /* Erreur */
-    return FALSE;
-}
-
-/**
- * Obtient la cl (mot) correspondant  un noeud.
- */
-char *tstree_node_get_key( const tstree_node_t node )
-{
-    /* Variables locales */
-    unsigned int size;    /* Taille de la cl   */
-    char         *buffer; /* Tampon pour la cl */
-
-    /* Vrification des paramtre */
-    assert( node );
-
-    /* Calcul de la taille ncessaire pour la cl */
-    size = node->depth + 1;
-
-    /* Construction de la cl */
-    if ((buffer = malloc( (node->depth + 1) * sizeof (char) ))) {
-	if (tstree_node_get_key_in_buffer( node, buffer, size ))
-	    return buffer;
 
-	free( buffer );
-	return NULL;
-    }
-
-    /* Erreur */
-    return NULL;
+    /* Nombre de noeuds (l'en-tte de chaque bloc n'est pas un noeud) */
+    nodes = tstree_get_node_number( tree );
+
+    /* Calcul des tailles */
+    if (reserved)
+	*reserved = (unsigned long) tree->nblocks *
+	    (BLOCK_SIZE + sizeof (tstree_cold_s_t)) +
+	    (unsigned long) tree->maxblocks *
+	    (sizeof (tstree_node_t) + sizeof (tstree_cold_t)) +
+	    sizeof (tree->firsts) + sizeof (tree->seconds) +
+	    (unsigned long) tree->maxwides * sizeof (tstree_wide_s_t);
+    if (used)
+	*used = nodes * (sizeof (tstree_node_s_t) + 2 * sizeof (unsigned int) +
+			 sizeof (tstree_index_t)) +
+	    sizeof (tree->firsts) + sizeof (tree->seconds) +
+	    (unsigned long) tree->nwides * sizeof (tstree_wide_s_t);
 }
 
 /**
- * Obtient la cl (mot) correspondant  un noeud dans un tampon existant.
+ * Active ou dsactive (`size' nul) la conservation, pour chaque prfixe
+ * d'au plus `depth' caractres (tous si `depth' est nul), de la liste de ses
+ * `size' compltions les plus frquentes. Les listes ne sont construites
+ * qu' la premire recherche qui en a besoin.
  */
-bool_t tstree_node_get_key_in_buffer( const tstree_node_t node,
-				      char *buffer, unsigned int size )
+bool_t tstree_set_cache( tstree_t tree, unsigned int size,
+			 unsigned int depth )
 {
     /* Variables locales */
-    unsigned int  pos;     /* Position dans la chane */
-    tstree_node_t current; /* Noeud courant           */
+    unsigned int i; /* Compteur */
 
     /* Vrification des paramtres */
-    assert( node );
-    assert( buffer );
-
-    /* Calcul de la taille si ncessaire */
-    if (size == 0)
-	size = (unsigned int) -1;
-
-    /* Initialisation de la chane */
-    pos = node->depth;
-    size--;
-    buffer[pos < size ? pos : size] = '\0';
+    assert( tree );
 
-    /* Construction de la cl */
-    for (current = node; current;current = current->parent) {
-	pos--;
-	if (pos < size)
-	    buffer[pos] = current->chr;
-	if (pos == 0)
-	    break;
+    /* Libration des anciennes listes */
+    for (i = 0; i < tree->nblocks; i++) {
+	free( tree->colds[i]->slots );
+	tree->colds[i]->slots = NULL;
     }
+    free( tree->lists );
+
+    tree->cachesize  = size;
+    tree->cachedepth = depth;
+    tree->cachevalid = FALSE;
+    tree->nlists     = 0;
+    tree->maxlists   = 0;
+    tree->lists      = NULL;
+
+    /* Allocation des tables de listes des blocs existants */
+    for (i = 0; size != 0 && i < tree->nblocks; i++)
+	if (!(tree->colds[i]->slots = calloc( BLOCK_NODES,
+					      sizeof (unsigned int) ))) {
+	    tstree_set_cache( tree, 0, 0 );
+	    return FALSE;
+	}
 
     /* Pas d'erreur */
     return TRUE;
 }
 
 /**
- * Retourne la profondeur d'un noeud.
+ * Marque les listes en cache comme primes : elles ne sont alors plus
+ * mises  jour  chaque ajout de cl, mais reconstruites entirement lors
+ * de la prochaine recherche.  appeler avant un chargement en masse.
  */
-unsigned int tstree_node_get_depth( const tstree_node_t node )
+void tstree_invalidate_cache( tstree_t tree )
 {
-    assert( node );
-    return node->depth;
+    assert( tree );
+    tree->cachevalid = FALSE;
 }
 
 /**
- * Retourne le nombre d'occurences d'un noeud.
+ * Reconstruit sans attendre la prochaine recherche les listes en cache qui
+ * ne sont plus  jour : les recherches suivantes ne modifient plus l'arbre
+ * et peuvent alors tre faites depuis plusieurs threads.
  */
-unsigned int tstree_node_get_count( const tstree_node_t node )
+bool_t tstree_update_cache( tstree_t tree )
 {
-    assert( node );
-    return node->count;
+    assert( tree );
+    return tree->cachesize == 0 || tree->cachevalid ||
+	tstree_cache_rebuild( tree );
 }
 
-
-/*****************************************************************************
- *
- * FONCTIONS STATIQUES
- *
- */
-
 /**
- * Cre un nouveau noeud.
+ * Obtient la quantit de mmoire rserve et utilise par les listes en
+ * cache.
  */
-static tstree_node_t tstree_node_new( const tstree_node_t parent, char chr )
+void tstree_get_cache_memory_usage( const tstree_t tree,
+				    unsigned long *reserved,
+				    unsigned long *used )
 {
     /* Variables locales */
-    tstree_node_t node = malloc( sizeof (tstree_node_s_t) ); /* Noeud cr */
+    unsigned long slots; /* Taille des tables de listes */
 
-    /* Initialisation du noeud */
-    if (node) {
-	node->parent      = parent && parent->depth != 0 ? parent : NULL;
-	node->brothers[0] = NULL;
-	node->brothers[1] = NULL;
-	node->child       = NULL;
-	node->depth       = parent ? parent->depth + 1 : 1;
-	node->chr         = chr;
-	node->count       = 0;
+    /* Vrification des paramtres */
+    assert( tree );
 
-	return node;
-    }
+    /* Calcul des tailles */
+    slots = tree->cachesize == 0 ? 0 : (unsigned long) tree->nblocks *
+	BLOCK_NODES * sizeof (unsigned int);
+    if (reserved)
+	*reserved = slots + (unsigned long) tree->maxlists *
+	    tree->cachesize * sizeof (tstree_index_t);
+    if (used)
+	*used = slots + (unsigned long) tree->nlists *
+	    tree->cachesize * sizeof (tstree_index_t);
+}
 
-    /* Erreur */
-    return NULL;
+/**
+ * Ajoute une cl (un mot) dans l'arbre.
+ */
+tstree_node_t tstree_add_key( tstree_t tree, const char *key )
+{
+    return tstree_add_key_count( tree, key, 1 );
 }
 
 /**
- * Dtruit un noeud.
+ * Ajoute `number' occurences d'une cl dans l'arbre, en une seule descente.
+ * La frquence de la cl est limite  UINT_MAX.
  */
-static void tstree_node_delete( tstree_node_t node )
+tstree_node_t tstree_add_key_count( tstree_t tree, const char *key,
+				    unsigned int number )
 {
+    /* Variables locales */
+    unsigned int   pos;             /* Caractre courant de la cl */
+    unsigned int   length;          /* Longueur du chemin          */
+    tstree_index_t index;           /* Noeud courant               */
+    tstree_index_t parent;          /* Noeud parent                */
+    tstree_index_t *next;           /* Lien vers le noeud suivant  */
+    tstree_node_t  node;            /* Noeud courant (pointeur)    */
+    tstree_index_t path[PATH_SIZE]; /* Noeuds traverss            */
+
     /* Vrification des paramtres */
-    assert( node );
+    assert( tree );
+    assert( key );
+    assert( key[0] != '\0' );
+    assert( number != 0 );
+    assert( !tree->shared );
 
-    /* Destruction des frres et fils */
-    if (node->brothers[0])
-	tstree_node_delete( node->brothers[0] );
-    if (node->brothers[1])
-	tstree_node_delete( node->brothers[1] );
-    if (node->child)
-	tstree_node_delete( node->child );
+    /* Initialisation des donnes */
+    next   = &tree->root;
+    length = 0;
+    index  = 0;
+    parent = 0;
+    node   = NULL;
 
-    /* Libration de la mmoire */
-    free( node );
+    /* Parcourt chaque caractre de la chane */
+    for (pos = 0; key[pos]; pos++) {
+	/* Recherche du caractre parmi les frres */
+	while ((index = *next) != 0) {
+	    if (length < PATH_SIZE)
+		path[length] = index;
+	    length++;
+
+	    node = NODE( tree, index );
+	    if (node->chr == key[pos])
+		break;
+	    next = node->brothers + (node->chr > key[pos] ? 0 : 1);
+	}
+
+	/* Cration du noeud s'il n'existe pas encore */
+	if (index == 0) {
+	    if (!(index = tstree_node_new( tree, parent, key[pos] )))
+		return NULL;
+	    node  = NODE( tree, index );
+	    *next = index;
+	    tstree_wide_add( tree, parent, index );
+
+	    if (length < PATH_SIZE)
+		path[length] = index;
+	    length++;
+	}
+
+	/* Passe au caractre suivant */
+	parent = index;
+	next   = &node->child;
+    }
+
+    /* Mise  jour des frquences */
+    node = tstree_add_count( tree, key, pos, index, number, path, length,
+			     PATH_SIZE );
+
+    /* Rquilibrage automatique (un chec laisse l'arbre utilisable) : il
+     * ne dplace pas les noeuds, contrairement au compactage, laiss 
+     * l'appelant */
+    if (tree->rebalance != 0 && ++tree->added >= tree->rebalance &&
+	tree->suspended == 0 && tree->added >= tree->count)
+	tstree_rebalance( tree );
+
+    return node;
 }
 
 /**
- * Obtient le noeud correspondant  une cl (mot) pas forcment entier.
+ * Ajoute  l'arbre `number' cls tries dans l'ordre de l'arbre (celui des
+ * caractres de type char, un prfixe tant plac avant les cls qui le
+ * prolongent), avec leurs frquences `counts' (1 si NULL) ; les cls
+ * identiques sont regroupes. Dans un arbre vide, chaque ensemble de frres
+ * est construit en un seul parcours des cls comme un arbre binaire
+ * quilibr, coup au frre mdian ou, si `weighted' est vrai, au frre
+ * mdian en frquence totale ; sinon, les cls sont ajoutes une  une.
+ * Retourne FALSE en cas d'erreur d'allocation ou de cls non tries (l'arbre
+ * ne contient alors qu'une partie des cls).
  */
-static tstree_node_t tstree_get_node( const tstree_t tree, const char *key )
+bool_t tstree_build_from_sorted( tstree_t tree, char *const *keys,
+				 const unsigned int *counts,
+				 unsigned int number, bool_t weighted )
 {
     /* Variables locales */
-    unsigned int    pos;  /* Position dans la chane */
-    tstree_node_t   node; /* Noeud courant           */
-    tstree_node_s_t root; /* Racine de l'arbre       */
+    unsigned int       i;        /* Compteur                     */
+    unsigned int       shared;   /* Prfixe commun au prcdent  */
+    bool_t             result;   /* Rsultat                     */
+    tstree_range_s_t   range;    /* Intervalle en cours          */
+    tstree_builder_s_t builder;  /* Construction en cours        */
+    tstree_inserter_t  inserter; /* Ajout dans un arbre non vide */
 
     /* Vrification des paramtres */
     assert( tree );
+    assert( keys || number == 0 );
 
-    /* Parcourt les noeuds */
-    if (key && key[0] != '\0') {
-	root.child = tree->root;
-	node = &root;
+    if (number == 0)
+	return TRUE;
 
-	for (pos = 0; key[pos]; pos++) {
-	    if (!node->child)
-		return NULL;
+    /* Les listes en cache sont reconstruites  la prochaine recherche */
+    tstree_invalidate_cache( tree );
 
-	    node = node->child;
+    /* Dans un arbre non vide, chaque cl reprend le chemin de la prcdente
+     * aprs leur prfixe commun */
+    if (tree->root != 0) {
+	if (!(inserter = tstree_inserter_new( tree )))
+	    return FALSE;
 
-	    while (node->chr != key[pos])
-		if (!(node = node->brothers[node->chr > key[pos] ? 0 : 1]))
-		    return NULL;
+	result = TRUE;
+	for (i = 0; result && i < number; i++) {
+	    shared = 0;
+	    if (i != 0)
+		while (keys[i][shared] != '\0' &&
+		       keys[i][shared] == keys[i - 1][shared])
+		    shared++;
+
+	    result = keys[i][0] != '\0' &&
+		tstree_inserter_add( inserter, keys[i], shared,
+				     counts ? counts[i] : 1 ) != NULL;
 	}
 
-	return node->child;
+	tstree_inserter_delete( inserter );
+	return result;
     }
 
-    return tree->root;
+    /* Initialisation de la pile des intervalles avec l'ensemble des cls */
+    builder.tree     = tree;
+    builder.keys     = keys;
+    builder.counts   = counts;
+    builder.weighted = weighted;
+    builder.size     = STACK_SIZE;
+    if (!(builder.ranges = malloc( builder.size *
+				   sizeof (tstree_range_s_t) )))
+	return FALSE;
+    builder.ranges[0].first  = 0;
+    builder.ranges[0].last   = number;
+    builder.ranges[0].depth  = 0;
+    builder.ranges[0].parent = 0;
+    builder.top              = 1;
+
+    /* Construction des frres de chaque intervalle, qui ajoute  la pile
+     * ceux de leurs fils */
+    result = TRUE;
+    while (result && builder.top != 0) {
+	range  = builder.ranges[--builder.top];
+	result = tstree_build_level( &builder, &range );
+    }
+
+    /* Libration de la mmoire, puis doublement des grands ensembles de
+     * frres (un chec les laisse sous forme d'arbres binaires) */
+    free( builder.ranges );
+    tstree_wide_rebuild( tree );
+    return result;
 }
 
 /**
- * Parcourt les sous-noeuds d'un noeud rcursivement.
+ * Ajoute  l'arbre toutes les cls d'un autre arbre, dont les frquences
+ * s'ajoutent  celles des cls dj prsentes. Les deux arbres sont
+ * parcourus ensemble : seuls les noeuds communs sont compars, et chaque
+ * sous-arbre absent est recopi d'un bloc, avec la forme qu'il a dans
+ * l'autre arbre. Retourne FALSE en cas d'erreur d'allocation (l'arbre ne
+ * contient alors qu'une partie des cls).
  */
-static bool_t tstree_walk_subnodes( const tstree_node_t node )
+bool_t tstree_merge( tstree_t tree, const tstree_t other )
 {
-    /* Vrification des paramtres */
-    assert( node );
+    /* Variables locales */
+    tstree_index_t    first;  /* Premier noeud cr    */
+    tstree_index_t    index;  /* Noeud courant         */
+    tstree_index_t    parent; /* Parent du noeud       */
+    tstree_index_t    *link;  /* Ensemble de frres    */
+    bool_t            result; /* Rsultat              */
+    tstree_merge_s_t  item;   /* lment en cours      */
+    tstree_merger_s_t merger; /* Fusion en cours       */
 
-    /* Si une cl correspond  ce noeud, appelle le callback */
-    if (node->count != 0 && !walk_callback( node, callback_data ))
+    /* Vrification des paramtres */
+    assert( tree );
+    assert( other );
+    assert( tree != other );
+    assert( !tree->shared );
+    assert( !other->shared );
+
+    if (other->root == 0)
+	return TRUE;
+
+    /* Les listes en cache sont reconstruites  la prochaine recherche */
+    tstree_invalidate_cache( tree );
+
+    /* Initialisation de la pile avec les frres de la racine */
+    merger.tree  = tree;
+    merger.other = other;
+    merger.size  = STACK_SIZE;
+    merger.top   = 0;
+    if (!(merger.items = malloc( merger.size *
+				 sizeof (tstree_merge_s_t) )))
 	return FALSE;
+    first  = tree->next;
+    result = tstree_merge_push( &merger, other->root, 0, NULL );
+
+    /* Fusion ou recopie de chaque lment, qui ajoute  la pile les
+     * ensembles de frres suivants */
+    while (result && merger.top != 0) {
+	item = merger.items[--merger.top];
+
+	/* Un ensemble de frres absent de l'arbre est recopi en entier */
+	if (!item.link) {
+	    link = item.parent ? &NODE( tree, item.parent )->child :
+		&tree->root;
+	    if (*link == 0) {
+		item.link = link;
+		if (item.parent != 0)
+		    tstree_raise_maxima( tree, item.parent,
+					 MAXIMUM( other, item.source ) );
+	    }
+	}
 
-    /* S'appelle rcursivement avec les frres et le fils */
-    if (node->brothers[0] && !tstree_walk_subnodes( node->brothers[0] ))
-	return FALSE;
-    if (node->child && !tstree_walk_subnodes( node->child ))
-	return FALSE;
-    if (node->brothers[1] && !tstree_walk_subnodes( node->brothers[1] ))
+	result = item.link ? tstree_merge_copy( &merger, &item ) :
+	    tstree_merge_brothers( &merger, item.source, item.parent );
+    }
+    free( merger.items );
+
+    /* Mise  jour de la profondeur de l'arbre */
+    if (tree->depth < other->depth)
+	tree->depth = other->depth;
+
+    /* Doublement des nouveaux ensembles de frres, tous crs en mme temps
+     * que leur racine (un chec les laisse sous forme d'arbres binaires) */
+    for (index = first; tree->widening != 0 && index < tree->next; index++)
+	if ((index & BLOCK_MASK) != 0) {
+	    parent = PARENT( tree, index );
+	    if ((parent ? NODE( tree, parent )->child : tree->root) == index)
+		tstree_wide_promote( tree, index );
+	}
+
+    return result;
+}
+
+/**
+ * Reconstruit chaque ensemble de frres comme un arbre binaire coup au
+ * frre mdian en frquence, la frquence d'un frre tant celle de toutes
+ * les cls qui commencent par son prfixe : les prfixes les plus frquents
+ * sont ainsi atteints avec le moins de comparaisons. Les noeuds ne sont pas
+ * dplacs, mais les curseurs en cours deviennent invalides.
+ */
+bool_t tstree_rebalance( tstree_t tree )
+{
+    /* Variables locales */
+    unsigned int   top;    /* Ensembles en cours                  */
+    unsigned int   size;   /* Taille de la pile des ensembles     */
+    unsigned int   i;      /* Compteur                            */
+    double         total;  /* Frquence totale d'un ensemble      */
+    tstree_index_t index;  /* Noeud courant                       */
+    tstree_level_t levels; /* Pile des ensembles                  */
+    tstree_level_t bigger; /* Pile agrandie                       */
+    tstree_level_t level;  /* Ensemble courant                    */
+
+    /* Vrification des paramtres */
+    assert( tree );
+    assert( !tree->shared );
+
+    tree->added = 0;
+    if (tree->root == 0)
+	return TRUE;
+
+    /* Un ensemble de frres par caractre du prfixe courant au plus : la
+     * mmoire utilise ne dpend que de la longueur des cls */
+    size = STACK_SIZE;
+    if (!(levels = malloc( size * sizeof (tstree_level_s_t) )))
+	return FALSE;
+    tstree_rebalance_list( tree, levels, 0 );
+    top = 1;
+
+    /* Parcours en profondeur : un ensemble est reconstruit une fois ceux
+     * de tous ses fils reconstruits, leurs frquences totales et maximales
+     * tant alors connues */
+    while (top != 0) {
+	level = levels + top - 1;
+	while (level->next < level->number &&
+	       NODE( tree, level->nodes[level->next] )->child == 0)
+	    level->next++;
+
+	/* Passage  l'ensemble des fils du frre suivant */
+	if (level->next < level->number) {
+	    if (top == size) {
+		if (!(bigger = realloc( levels, 2 * size *
+					sizeof (tstree_level_s_t) ))) {
+		    free( levels );
+		    tstree_wide_rebuild( tree );
+		    return FALSE;
+		}
+		levels = bigger;
+		size  *= 2;
+		level  = levels + top - 1;
+	    }
+	    tstree_rebalance_list( tree, levels + top,
+				   level->nodes[level->next] );
+	    top++;
+	    continue;
+	}
+
+	/* Reconstruction de l'ensemble */
+	index = tstree_rebalance_brothers( tree, level->nodes, level->totals,
+					   0, level->number );
+	total = 0.0;
+	for (i = 0; i < level->number; i++)
+	    total += COUNT( tree, level->nodes[i] ) + level->totals[i];
+
+	/* Rattachement au prfixe, dont le frre suivant sera visit */
+	if (--top != 0) {
+	    NODE( tree, level->parent )->child = index;
+	    level = levels + top - 1;
+	    level->totals[level->next++] = total;
+	} else
+	    tree->root = index;
+    }
+
+    /* Libration de la mmoire ; les racines des ensembles de frres ont
+     * chang */
+    free( levels );
+    tstree_wide_rebuild( tree );
+    return TRUE;
+}
+
+/**
+ * Recopie les noeuds de l'arbre dans une nouvelle arne : chaque ensemble
+ * de frres est rang d'un seul tenant, en largeur, et les ensembles sont
+ * rangs en largeur pour les prfixes les plus courts, puis dans l'ordre
+ * d'un parcours en profondeur, chacun suivi de ceux de ses fils dans
+ * l'ordre des caractres. Les noeuds visits par une recherche ou un
+ * parcours sont ainsi proches en mmoire. Les noeuds inaccessibles
+ * disparaissent. Les noeuds obtenus auparavant et les curseurs en cours
+ * deviennent invalides ; en cas d'erreur, l'arbre est inchang.
+ */
+bool_t tstree_compact( tstree_t tree )
+{
+    /* Variables locales */
+    unsigned int    top;                 /* Hauteur de la pile          */
+    unsigned int    size;                /* Taille de la pile           */
+    unsigned int    head;                /* Frre courant               */
+    unsigned int    tail;                /* Frres  copier             */
+    unsigned int    number;              /* Frres ayant un fils        */
+    unsigned int    first;               /* Dbut de la file            */
+    bool_t          breadth;             /* Copie en largeur            */
+    unsigned int    i;                   /* Compteur                    */
+    bool_t          result;              /* Rsultat                    */
+    tstree_index_t  old;                 /* Ancien index d'un noeud     */
+    tstree_index_t  index;               /* Nouvel index d'un noeud     */
+    tstree_index_t  *map;                /* Nouvel index de chaque noeud */
+    tstree_index_t  *pending;            /* Prfixes des frres  copier */
+    tstree_index_t  *bigger;             /* Pile agrandie               */
+    tstree_node_t   node;                /* Ancien noeud                */
+    tstree_node_t   copy;                /* Nouveau noeud               */
+    tstree_s_t      arena;               /* Nouvelle arne              */
+    tstree_index_t  queue[MAX_BROTHERS]; /* Frres, en largeur          */
+    tstree_index_t  stack[MAX_BROTHERS]; /* Parcours des frres         */
+
+    /* Vrification des paramtres */
+    assert( tree );
+    assert( !tree->shared );
+
+    if (tree->root == 0)
+	return TRUE;
+
+    /* Allocation de la table de correspondance et de la pile */
+    size = STACK_SIZE;
+    map  = calloc( tree->next, sizeof (tstree_index_t) );
+    if (!map || !(pending = malloc( size * sizeof (tstree_index_t) ))) {
+	free( map );
+	return FALSE;
+    }
+
+    /* La nouvelle arne est gre par une copie de l'arbre */
+    arena           = *tree;
+    arena.root      = 0;
+    arena.next      = 0;
+    arena.nblocks   = 0;
+    arena.maxblocks = 0;
+    arena.blocks    = NULL;
+    arena.colds     = NULL;
+    memset( arena.firsts, 0, sizeof (arena.firsts) );
+    memset( arena.seconds, 0, sizeof (arena.seconds) );
+
+    /* Copie des ensembles de frres, en commenant par celui de la racine
+     * (le prfixe 0) : ceux des prfixes courts, visits par toutes les
+     * recherches, sont copis en largeur  la suite, en file, puis les
+     * autres en profondeur, en pile */
+    pending[0] = 0;
+    first      = 0;
+    top        = 1;
+    breadth    = TRUE;
+    result     = TRUE;
+    while (result && first != top) {
+	if (breadth) {
+	    for (i = 0, old = pending[first]; old && i < BREADTH_DEPTH;
+		 old = PARENT( tree, old ))
+		i++;
+
+	    /* Passage  la pile : les ensembles restants sont inverss */
+	    if (i == BREADTH_DEPTH) {
+		breadth = FALSE;
+		for (i = 0; first + i < top - 1 - i; i++) {
+		    old                  = pending[first + i];
+		    pending[first + i]   = pending[top - 1 - i];
+		    pending[top - 1 - i] = old;
+		}
+	    }
+	}
+	old = breadth ? pending[first++] : pending[--top];
+
+	/* Copie des frres en largeur */
+	queue[0] = old ? NODE( tree, old )->child : tree->root;
+	tail     = 1;
+	for (head = 0; head < tail; head++) {
+	    node  = NODE( tree, queue[head] );
+	    index = tstree_node_new( &arena, old ? map[old] : 0, node->chr );
+	    if (!(map[queue[head]] = index)) {
+		result = FALSE;
+		break;
+	    }
+	    COUNT( &arena, index )   = COUNT( tree, queue[head] );
+	    MAXIMUM( &arena, index ) = MAXIMUM( tree, queue[head] );
+
+	    for (i = 0; i < 2; i++)
+		if (node->brothers[i] != 0)
+		    queue[tail++] = node->brothers[i];
+	}
+
+	/* Frres ayant un fils, dans l'ordre des caractres */
+	number = 0;
+	old    = queue[0];
+	for (i = 0; result && (old != 0 || i != 0); ) {
+	    while (old != 0) {
+		stack[i++] = old;
+		old        = NODE( tree, old )->brothers[0];
+	    }
+	    old = stack[--i];
+	    if (NODE( tree, old )->child != 0)
+		queue[number++] = old;
+	    old = NODE( tree, old )->brothers[1];
+	}
+
+	/* Leurs fils sont ajouts  la file, ou empils dans l'ordre inverse
+	 * pour tre copis dans l'ordre */
+	if (result && top + number > size) {
+	    while (top + number > size)
+		size *= 2;
+	    if (!(bigger = realloc( pending,
+				    size * sizeof (tstree_index_t) ))) {
+		result = FALSE;
+		break;
+	    }
+	    pending = bigger;
+	}
+	for (i = 0; result && i < number; i++)
+	    pending[top++] = queue[breadth ? i : number - 1 - i];
+    }
+    free( pending );
+
+    /* En cas d'erreur, la nouvelle arne est abandonne */
+    if (!result) {
+	tstree_blocks_free( &arena );
+	free( map );
+	return FALSE;
+    }
+
+    /* Mise  jour des liens entre les nouveaux noeuds */
+    for (old = 1; old < tree->next; old++)
+	if ((old & BLOCK_MASK) != 0 && map[old] != 0) {
+	    node = NODE( tree, old );
+	    copy = NODE( &arena, map[old] );
+	    copy->brothers[0] = map[node->brothers[0]];
+	    copy->brothers[1] = map[node->brothers[1]];
+	    copy->child       = map[node->child];
+	}
+
+    /* Remplacement de l'arne ; les listes en cache dsignent les anciens
+     * noeuds et seront reconstruites */
+    arena.root = map[tree->root];
+    tstree_blocks_free( tree );
+    for (i = 0; i < arena.nblocks; i++)
+	arena.colds[i]->tree = tree;
+    *tree = arena;
+    tree->cachevalid = FALSE;
+    tree->nlists     = 0;
+
+    free( map );
+    tstree_wide_rebuild( tree );
+    return TRUE;
+}
+
+/**
+ * Active le rquilibrage automatique de l'arbre, ou le dsactive si
+ * `interval' est nul. Il a lieu aprs au moins `interval' ajouts de cls
+ * par tstree_add_key_count() et au moins autant d'ajouts que de cls dans
+ * l'arbre : son cot, proportionnel  la taille de l'arbre, est ainsi
+ * rparti sur les ajouts. Les noeuds ne sont pas dplacs.
+ */
+void tstree_set_rebalance( tstree_t tree, unsigned int interval )
+{
+    assert( tree );
+    tree->rebalance = interval;
+    tree->added     = 0;
+}
+
+/**
+ * Suspend le rquilibrage automatique pendant une srie d'ajouts, jusqu'
+ * l'appel correspondant de tstree_resume_rebalance() ; les appels peuvent
+ * tre imbriqus.
+ */
+void tstree_suspend_rebalance( tstree_t tree )
+{
+    assert( tree );
+    tree->suspended++;
+}
+
+/**
+ * Reprend le rquilibrage automatique suspendu par
+ * tstree_suspend_rebalance() :  la dernire reprise, l'arbre est
+ * rquilibr une fois si les ajouts de la srie l'ont rendu ncessaire.
+ * Retourne FALSE en cas d'erreur d'allocation (l'arbre reste utilisable).
+ */
+bool_t tstree_resume_rebalance( tstree_t tree )
+{
+    /* Vrification des paramtres */
+    assert( tree );
+    assert( tree->suspended != 0 );
+
+    if (--tree->suspended != 0 || tree->rebalance == 0 ||
+	tree->added < tree->rebalance || tree->added < tree->count)
+	return TRUE;
+    return tstree_rebalance( tree );
+}
+
+/**
+ * Active ou dsactive l'accs direct aux noeuds des prfixes d'un et deux
+ * caractres lors des recherches ; les tables restent tenues  jour dans
+ * tous les cas.
+ */
+void tstree_set_direct( tstree_t tree, bool_t enabled )
+{
+    assert( tree );
+    tree->direct = enabled;
+}
+
+/**
+ * Fixe le nombre de frres  partir duquel un ensemble de frres est doubl
+ * de frres larges, dont les caractres sont compars par groupes de
+ * WIDE_CHARS lors des recherches, ou dsactive ceux-ci (`threshold' nul).
+ * En cas d'erreur, certains ensembles restent sous forme d'arbres binaires.
+ */
+bool_t tstree_set_wide( tstree_t tree, unsigned int threshold )
+{
+    assert( tree );
+    tree->widening = threshold;
+    return tstree_wide_rebuild( tree );
+}
+
+/**
+ * Calcule le nombre moyen (pondr par la frquence des cls) et maximal
+ * de comparaisons avec des frres effectues lors de la recherche d'une cl
+ * de l'arbre.
+ */
+bool_t tstree_get_balance( const tstree_t tree, double *average,
+			   unsigned int *maximum )
+{
+    /* Variables locales */
+    unsigned int     top;     /* Hauteur de la pile           */
+    unsigned int     size;    /* Taille de la pile            */
+    unsigned int     count;   /* Frquence d'une cl          */
+    double           sum;     /* Somme des comparaisons       */
+    double           weight;  /* Somme des frquences         */
+    tstree_visit_s_t visit;   /* Noeud courant                */
+    tstree_visit_t   stack;   /* Noeuds  visiter             */
+    tstree_visit_t   bigger;  /* Pile agrandie                */
+    tstree_node_t    node;    /* Noeud courant (pointeur)     */
+
+    /* Vrification des paramtres */
+    assert( tree );
+    assert( average );
+    assert( maximum );
+
+    *average = 0.0;
+    *maximum = 0;
+    if (tree->root == 0)
+	return TRUE;
+
+    /* Parcours de l'arbre : chaque frre travers cote une comparaison */
+    size = STACK_SIZE;
+    if (!(stack = malloc( size * sizeof (tstree_visit_s_t) )))
+	return FALSE;
+    stack[0].index = tree->root;
+    stack[0].cost  = 0;
+    top    = 1;
+    sum    = 0.0;
+    weight = 0.0;
+
+    while (top != 0) {
+	visit = stack[--top];
+	node  = NODE( tree, visit.index );
+
+	if ((count = COUNT( tree, visit.index )) != 0) {
+	    sum    += (double) visit.cost * count;
+	    weight += count;
+	    if (*maximum < visit.cost)
+		*maximum = visit.cost;
+	}
+
+	/* Place pour les deux frres et le fils */
+	if (top + 3 > size) {
+	    if (!(bigger = realloc( stack, 2 * size *
+				    sizeof (tstree_visit_s_t) ))) {
+		free( stack );
+		return FALSE;
+	    }
+	    stack = bigger;
+	    size *= 2;
+	}
+
+	if (node->brothers[0] != 0) {
+	    stack[top].index = node->brothers[0];
+	    stack[top].cost  = visit.cost + 1;
+	    top++;
+	}
+	if (node->brothers[1] != 0) {
+	    stack[top].index = node->brothers[1];
+	    stack[top].cost  = visit.cost + 1;
+	    top++;
+	}
+	if (node->child != 0) {
+	    stack[top].index = node->child;
+	    stack[top].cost  = visit.cost;
+	    top++;
+	}
+    }
+
+    if (weight != 0.0)
+	*average = sum / weight;
+
+    free( stack );
+    return TRUE;
+}
+
+/**
+ * Parcourt les noeuds et appelle un callback  chaque cl dcouverte.
+ */
+bool_t tstree_get_keys( const tstree_t tree, const char *key,
+			tstree_callback_t callback, void *data )
+{
+    /* Variables locales */
+    tstree_index_t    index;  /* Noeud correspondant  la cl */
+    tstree_node_t     node;   /* Noeud trouv                 */
+    tstree_cursor_s_t cursor; /* Curseur de parcours          */
+    bool_t            result; /* Rsultat                     */
+
+    /* Vrification des paramtres */
+    assert( tree );
+    assert( callback );
+
+    /* Il faut que le prfixe existe et puisse tre complt */
+    if (key && key[0] != '\0') {
+	if (!(index = tstree_get_node( tree, key )) ||
+	    !NODE( tree, index )->child)
+	    return FALSE;
+    } else if (!tree->root)
+	return FALSE;
+
+    /* Effectue le parcours */
+    tstree_cursor_init( &cursor, tree, key );
+    result = TRUE;
+
+    while ((node = tstree_cursor_next( &cursor )))
+	if (!callback( node, data )) {
+	    result = FALSE;
+	    break;
+	}
+
+    if (cursor.failed)
+	result = FALSE;
+    tstree_cursor_free( &cursor );
+
+    return result;
+}
+
+/**
+ * Cherche les `*number' cls les plus frquentes commenant par un prfixe.
+ * Elles sont ranges par frquence dcroissante puis dans l'ordre
+ * lexicographique, et `*number' est mis  jour avec le nombre trouv.
+ */
+bool_t tstree_get_most_used( const tstree_t tree, const char *key,
+			     tstree_node_t *nodes, unsigned int *number )
+{
+    /* Variables locales */
+    unsigned int   i;      /* Compteur                     */
+    unsigned int   length; /* Longueur du prfixe          */
+    tstree_index_t index;  /* Noeud correspondant  la cl */
+    tstree_index_t *list;  /* Liste en cache du prfixe    */
+
+    /* Vrification des paramtres */
+    assert( tree );
+    assert( nodes );
+    assert( number );
+
+    /* Il faut que le prfixe existe et puisse tre complt */
+    if (key && key[0] != '\0') {
+	if (!(index = tstree_get_node( tree, key )) ||
+	    !NODE( tree, index )->child)
+	    return FALSE;
+    } else if (!tree->root)
+	return FALSE;
+    else
+	index = 0;
+
+    /* Utilisation de la liste en cache du prfixe si elle est assez longue
+     * (en la reconstruisant au besoin) */
+    if (index && *number <= tree->cachesize &&
+	(tree->cachevalid || tstree_cache_rebuild( tree ))) {
+	length = strlen( key );
+	if ((tree->cachedepth == 0 || length <= tree->cachedepth) &&
+	    SLOT( tree, index ) != 0) {
+	    list = LIST( tree, SLOT( tree, index ) );
+	    for (i = 0; i < *number && list[i]; i++)
+		nodes[i] = NODE( tree, list[i] );
+
+	    *number = i;
+	    return TRUE;
+	}
+    }
+
+    /* Sinon, recherche dans le sous-arbre */
+    return tstree_select( tree, index, nodes, number );
+}
+
+/**
+ * Obtient la cl (mot) correspondant  un noeud.
+ */
+char *tstree_node_get_key( const tstree_node_t node )
+{
+    /* Variables locales */
+    unsigned int size;    /* Taille de la cl   */
+    char         *buffer; /* Tampon pour la cl */
+
+    /* Vrification des paramtre */
+    assert( node );
+
+    /* Calcul de la taille ncessaire pour la cl */
+    size = tstree_node_get_depth( node ) + 1;
+
+    /* Construction de la cl */
+    if ((buffer = malloc( size * sizeof (char) ))) {
+	if (tstree_node_get_key_in_buffer( node, buffer, size ))
+	    return buffer;
+
+	free( buffer );
+	return NULL;
+    }
+
+    /* Erreur */
+    return NULL;
+}
+
+/**
+ * Obtient la cl (mot) correspondant  un noeud dans un tampon existant.
+ */
+bool_t tstree_node_get_key_in_buffer( const tstree_node_t node,
+				      char *buffer, unsigned int size )
+{
+    /* Variables locales */
+    unsigned int   pos;   /* Position dans la chane */
+    tstree_t       tree;  /* Arbre du noeud          */
+    tstree_index_t index; /* Noeud courant           */
+
+    /* Vrification des paramtres */
+    assert( node );
+    assert( buffer );
+
+    /* Calcul de la taille si ncessaire */
+    if (size == 0)
+	size = (unsigned int) -1;
+
+    /* Initialisation de la chane */
+    pos = tstree_node_get_depth( node );
+    size--;
+    buffer[pos < size ? pos : size] = '\0';
+
+    /* Construction de la cl en remontant les parents */
+    for (index = tstree_node_index( node, &tree ); index;
+	 index = PARENT( tree, index )) {
+	pos--;
+	if (pos < size)
+	    buffer[pos] = NODE( tree, index )->chr;
+    }
+
+    /* Pas d'erreur */
+    return TRUE;
+}
+
+/**
+ * Retourne la profondeur d'un noeud, calcule en remontant ses parents.
+ */
+unsigned int tstree_node_get_depth( const tstree_node_t node )
+{
+    /* Variables locales */
+    unsigned int   depth; /* Profondeur     */
+    tstree_t       tree;  /* Arbre du noeud */
+    tstree_index_t index; /* Noeud courant  */
+
+    /* Vrification des paramtres */
+    assert( node );
+
+    /* Remonte jusqu' la racine */
+    depth = 0;
+    for (index = tstree_node_index( node, &tree ); index;
+	 index = PARENT( tree, index ))
+	depth++;
+
+    return depth;
+}
+
+/**
+ * Retourne le nombre d'occurences d'un noeud.
+ */
+unsigned int tstree_node_get_count( const tstree_node_t node )
+{
+    /* Variables locales */
+    tstree_t       tree;  /* Arbre du noeud */
+    tstree_index_t index; /* Index du noeud */
+
+    /* Vrification des paramtres */
+    assert( node );
+
+    index = tstree_node_index( node, &tree );
+    return COUNT( tree, index );
+}
+
+/**
+ * Cre un curseur numrant les cls commenant par un prfixe donn.
+ */
+tstree_cursor_t tstree_cursor_new( const tstree_t tree, const char *key )
+{
+    /* Variables locales */
+    tstree_cursor_t cursor; /* Curseur cr */
+
+    /* Vrification des paramtres */
+    assert( tree );
+
+    /* Allocation et initialisation du curseur */
+    if ((cursor = malloc( sizeof (tstree_cursor_s_t) ))) {
+	tstree_cursor_init( cursor, tree, key );
+	return cursor;
+    }
+
+    /* Erreur */
+    return NULL;
+}
+
+/**
+ * Dtruit un curseur.
+ */
+void tstree_cursor_delete( tstree_cursor_t cursor )
+{
+    /* Vrification des paramtres */
+    assert( cursor );
+
+    /* Libration de la mmoire */
+    tstree_cursor_free( cursor );
+    free( cursor );
+}
+
+/**
+ * Retourne le noeud de la prochaine cl (dans l'ordre lexicographique) ou
+ * NULL s'il n'y en a plus. L'numration peut tre interrompue et reprise 
+ * tout moment puisque le curseur conserve sa propre pile.
+ */
+tstree_node_t tstree_cursor_next( tstree_cursor_t cursor )
+{
+    /* Variables locales */
+    tstree_index_t index; /* Noeud trouv */
+
+    /* Vrification des paramtres */
+    assert( cursor );
+
+    /* Avance le curseur */
+    index = tstree_cursor_step( cursor );
+    return index ? NODE( cursor->tree, index ) : NULL;
+}
+
+/**
+ * Indique si l'numration a chou faute de mmoire.
+ */
+bool_t tstree_cursor_has_failed( const tstree_cursor_t cursor )
+{
+    assert( cursor );
+    return cursor->failed;
+}
+
+/**
+ * Cre un objet d'insertion de cls tries dans un arbre.
+ */
+tstree_inserter_t tstree_inserter_new( tstree_t tree )
+{
+    /* Variables locales */
+    tstree_inserter_t inserter; /* Objet cr */
+
+    /* Vrification des paramtres */
+    assert( tree );
+
+    /* Allocation et initialisation de l'objet */
+    if ((inserter = malloc( sizeof (tstree_inserter_s_t) ))) {
+	inserter->tree     = tree;
+	inserter->depth    = 0;
+	inserter->size     = 0;
+	inserter->maxdepth = 0;
+	inserter->path     = NULL;
+	inserter->ends     = NULL;
+    }
+
+    return inserter;
+}
+
+/**
+ * Dtruit un objet d'insertion.
+ */
+void tstree_inserter_delete( tstree_inserter_t inserter )
+{
+    /* Vrification des paramtres */
+    assert( inserter );
+
+    /* Libration de la mmoire */
+    free( inserter->path );
+    free( inserter->ends );
+    free( inserter );
+}
+
+/**
+ * Ajoute `number' occurences d'une cl dont les `shared' premiers
+ * caractres sont ceux de la cl prcdemment ajoute par cet objet : la
+ * descente reprend au noeud du dernier de ces caractres au lieu de
+ * repartir de la racine. Des cls tries partagent ainsi l'essentiel de
+ * leur chemin.
+ */
+tstree_node_t tstree_inserter_add( tstree_inserter_t inserter,
+				   const char *key, unsigned int shared,
+				   unsigned int number )
+{
+    /* Variables locales */
+    unsigned int   pos;    /* Caractre courant de la cl */
+    unsigned int   length; /* Longueur du chemin          */
+    tstree_t       tree;   /* Arbre complt              */
+    tstree_index_t index;  /* Noeud courant               */
+    tstree_index_t parent; /* Noeud parent                */
+    tstree_index_t *next;  /* Lien vers le noeud suivant  */
+    tstree_node_t  node;   /* Noeud courant (pointeur)    */
+
+    /* Vrification des paramtres */
+    assert( inserter );
+    assert( key );
+    assert( key[0] != '\0' );
+    assert( shared <= inserter->depth );
+    assert( number != 0 );
+
+    /* Reprise du chemin de la cl prcdente aprs le prfixe commun */
+    tree = inserter->tree;
+    if (shared == 0) {
+	next   = &tree->root;
+	length = 0;
+	index  = 0;
+    } else {
+	length = inserter->ends[shared - 1];
+	index  = inserter->path[length - 1];
+	next   = &NODE( tree, index )->child;
+    }
+    parent = index;
+
+    /* Le chemin n'est plus valable jusqu' la fin de l'ajout */
+    inserter->depth = 0;
+
+    /* Parcourt les caractres suivants, comme tstree_add_key_count() */
+    for (pos = shared; key[pos]; pos++) {
+	if (!tstree_inserter_grow( inserter, pos, length ))
+	    return NULL;
+
+	/* Recherche du caractre parmi les frres */
+	while ((index = *next) != 0) {
+	    inserter->path[length++] = index;
+
+	    node = NODE( tree, index );
+	    if (node->chr == key[pos])
+		break;
+	    next = node->brothers + (node->chr > key[pos] ? 0 : 1);
+	}
+
+	/* Cration du noeud s'il n'existe pas encore */
+	if (index == 0) {
+	    if (!(index = tstree_node_new( tree, parent, key[pos] )))
+		return NULL;
+	    node  = NODE( tree, index );
+	    *next = index;
+	    tstree_wide_add( tree, parent, index );
+
+	    inserter->path[length++] = index;
+	}
+
+	/* Passe au caractre suivant */
+	inserter->ends[pos] = length;
+	parent              = index;
+	next                = &node->child;
+    }
+    inserter->depth = pos;
+
+    /* Mise  jour des frquences */
+    return tstree_add_count( tree, key, pos, index, number, inserter->path,
+			     length, length );
+}
+
+/**
+ * Passe l'arbre en mode d'ajouts concurrents : jusqu' l'appel de
+ * tstree_end_concurrent(), seule tstree_add_key_concurrent() peut tre
+ * appele, depuis autant de threads que voulu. Les listes en cache et les
+ * frres larges sont abandonns, et le rquilibrage automatique suspendu.
+ */
+bool_t tstree_begin_concurrent( tstree_t tree )
+{
+    /* Variables locales */
+    unsigned int threshold; /* Seuil des frres larges */
+
+    /* Vrification des paramtres */
+    assert( tree );
+    assert( !tree->shared );
+
+    /* Cration de l'tat partag */
+    if (!(tree->shared = malloc( sizeof (tstree_shared_s_t) )))
+	return FALSE;
+    if (pthread_mutex_init( &tree->shared->mutex, NULL ) != 0) {
+	free( tree->shared );
+	tree->shared = NULL;
+	return FALSE;
+    }
+    tree->shared->nretired = 0;
+
+    /* Les ajouts ne tiennent  jour ni les listes ni les frres larges */
+    tree->cachevalid = FALSE;
+    threshold        = tree->widening;
+    tree->widening   = 0;
+    tstree_wide_rebuild( tree );
+    tree->widening   = threshold;
+
+    return TRUE;
+}
+
+/**
+ * Ajoute `number' occurences d'une cl  l'arbre en mode d'ajouts
+ * concurrents. Chaque nouveau noeud est entirement initialis avant d'tre
+ * publi par une comparaison-change sur le lien qui le dsigne : un autre
+ * thread ne peut donc pas voir de noeud  moiti construit, et celui qui perd
+ * la course reprend la recherche depuis ce lien. Les frquences sont mises 
+ * jour par des oprations atomiques ; seule l'allocation d'un nouveau bloc de
+ * noeuds prend un verrou.
+ */
+tstree_node_t tstree_add_key_concurrent( tstree_t tree, const char *key,
+					 unsigned int number )
+{
+    /* Variables locales */
+    unsigned int   pos;             /* Caractre courant de la cl     */
+    unsigned int   length;          /* Longueur du chemin              */
+    unsigned int   count;           /* Nouvelle frquence de la cl    */
+    unsigned int   old;             /* Ancienne frquence de la cl    */
+    unsigned int   first;           /* Code du premier caractre       */
+    unsigned int   code;            /* Code du caractre courant       */
+    tstree_index_t index;           /* Noeud courant                   */
+    tstree_index_t parent;          /* Noeud parent                    */
+    tstree_index_t spare;           /* Noeud allou, pas encore publi */
+    tstree_index_t expected;        /* Valeur attendue du lien         */
+    tstree_index_t *next;           /* Lien vers le noeud suivant      */
+    tstree_node_t  node;            /* Noeud courant (pointeur)        */
+    unsigned int   *counts;         /* Frquence de la cl             */
+    tstree_index_t path[PATH_SIZE]; /* Noeuds traverss                */
+
+    /* Vrification des paramtres */
+    assert( tree );
+    assert( tree->shared );
+    assert( key );
+    assert( key[0] != '\0' );
+    assert( number != 0 );
+
+    /* Initialisation des donnes */
+    next   = &tree->root;
+    length = 0;
+    index  = 0;
+    parent = 0;
+    spare  = 0;
+    node   = NULL;
+
+    /* Parcourt chaque caractre de la chane */
+    for (pos = 0; key[pos]; pos++) {
+	/* Recherche du caractre parmi les frres, un nouveau noeud tant
+	 * publi  la place du premier lien nul rencontr */
+	for (;;) {
+	    if ((index = __atomic_load_n( next, __ATOMIC_ACQUIRE )) == 0) {
+		if (!spare && !(spare = tstree_shared_node_new( tree )))
+		    return NULL;
+		SHARED_NODE( tree, spare )->chr = key[pos];
+		SHARED_COLD( tree, spare )->parents[spare & BLOCK_MASK] =
+		    parent;
+
+		expected = 0;
+		if (!__atomic_compare_exchange_n( next, &expected, spare, 0,
+						  __ATOMIC_RELEASE,
+						  __ATOMIC_ACQUIRE ))
+		    continue;
+		index = spare;
+		spare = 0;
+
+		/* Inscription dans les tables d'accs direct */
+		if (pos < 2 &&
+		    (code = tree->codes[(unsigned char) key[pos]]) != 0) {
+		    if (pos == 0)
+			tree->firsts[code] = index;
+		    else if ((first = tree->codes[(unsigned char)
+						  key[0]]) != 0)
+			tree->seconds[first * DIRECT_CODES + code] = index;
+		}
+	    }
+
+	    if (length < PATH_SIZE)
+		path[length] = index;
+	    length++;
+
+	    node = SHARED_NODE( tree, index );
+	    if (node->chr == key[pos])
+		break;
+	    next = node->brothers + (node->chr > key[pos] ? 0 : 1);
+	}
+
+	/* Passe au caractre suivant */
+	parent = index;
+	next   = &node->child;
+    }
+
+    /* Un noeud allou en vain reste inaccessible jusqu'au compactage */
+
+    /* Ajout de la cl au compteur, la frquence tant limite  UINT_MAX */
+    counts = SHARED_COLD( tree, index )->counts + (index & BLOCK_MASK);
+    old    = __atomic_load_n( counts, __ATOMIC_RELAXED );
+    do
+	count = old > UINT_MAX - number ? UINT_MAX : old + number;
+    while (!__atomic_compare_exchange_n( counts, &old, count, 0,
+					 __ATOMIC_RELAXED, __ATOMIC_RELAXED ));
+    if (old == 0)
+	__atomic_fetch_add( &tree->count, 1, __ATOMIC_RELAXED );
+
+    /* Mise  jour des frquences maximales le long du chemin, en remontant
+     * tant qu'elles sont infrieures, comme tstree_add_count() */
+    if (length <= PATH_SIZE) {
+	while (length != 0 &&
+	       tstree_shared_raise( tree, path[length - 1], count ))
+	    length--;
+    } else
+	tstree_shared_maxima( tree, key, count );
+
+    /* Mise  jour de la profondeur de l'arbre */
+    old = __atomic_load_n( &tree->depth, __ATOMIC_RELAXED );
+    while (old < pos &&
+	   !__atomic_compare_exchange_n( &tree->depth, &old, pos, 0,
+					 __ATOMIC_RELAXED, __ATOMIC_RELAXED ))
+	;
+
+    return SHARED_NODE( tree, index );
+}
+
+/**
+ * Termine le mode d'ajouts concurrents, une fois tous les ajouts achevs :
+ * les frres larges sont reconstruits, et les listes en cache le seront  la
+ * prochaine recherche.
+ */
+void tstree_end_concurrent( tstree_t tree )
+{
+    /* Variables locales */
+    unsigned int i; /* Compteur */
+
+    /* Vrification des paramtres */
+    assert( tree );
+    assert( tree->shared );
+
+    /* Libration des anciennes tables de blocs et de l'tat partag */
+    for (i = 0; i < tree->shared->nretired; i++)
+	free( tree->shared->retired[i] );
+    pthread_mutex_destroy( &tree->shared->mutex );
+    free( tree->shared );
+    tree->shared = NULL;
+
+    /* Les index rservs dans des blocs qui n'ont pu tre allous sont
+     * abandonns */
+    if (tree->next > tree->nblocks << BLOCK_SHIFT)
+	tree->next = tree->nblocks << BLOCK_SHIFT;
+
+    tstree_wide_rebuild( tree );
+}
+
+
+/*****************************************************************************
+ *
+ * FONCTIONS STATIQUES
+ *
+ */
+
+/**
+ * Cre un nouveau noeud en le prenant dans l'arne de l'arbre.
+ */
+static tstree_index_t tstree_node_new( tstree_t tree, tstree_index_t parent,
+				       char chr )
+{
+    /* Variables locales */
+    tstree_index_t index; /* Index du noeud cr        */
+    tstree_node_t  node;  /* Noeud cr                 */
+    unsigned int   first; /* Code du premier caractre  */
+    unsigned int   code;  /* Code du caractre du noeud */
+
+    /* Vrification des paramtres */
+    assert( tree );
+
+    /* Allocation d'un nouveau bloc si le bloc courant est plein (le premier
+     * emplacement de chaque bloc est rserv  son en-tte) */
+    if ((tree->next & BLOCK_MASK) == 0) {
+	if (tree->next == 0 && tree->nblocks != 0)
+	    return 0;
+	if (!tstree_block_new( tree ))
+	    return 0;
+	tree->next++;
+    }
+
+    /* Initialisation du noeud */
+    index = tree->next++;
+    node  = NODE( tree, index );
+    node->brothers[0] = 0;
+    node->brothers[1] = 0;
+    node->child       = 0;
+    node->chr         = chr;
+    node->wide        = 0;
+
+    COUNT( tree, index )  = 0;
+    PARENT( tree, index ) = parent;
+    MAXIMUM( tree, index ) = 0;
+    if (tree->cachesize != 0)
+	SLOT( tree, index ) = 0;
+
+    /* Inscription dans les tables d'accs direct des noeuds des deux premiers
+     * niveaux */
+    if ((code = tree->codes[(unsigned char) chr]) != 0) {
+	if (parent == 0)
+	    tree->firsts[code] = index;
+	else if (PARENT( tree, parent ) == 0 &&
+		 (first = tree->codes[(unsigned char)
+				      NODE( tree, parent )->chr]) != 0)
+	    tree->seconds[first * DIRECT_CODES + code] = index;
+    }
+
+    return index;
+}
+
+/**
+ * Obtient l'index d'un noeud ainsi que l'arbre auquel il appartient grce 
+ * l'en-tte du bloc qui le contient.
+ */
+static tstree_index_t tstree_node_index( const tstree_node_t node,
+					 tstree_t *tree )
+{
+    /* Variables locales */
+    tstree_header_t header = HEADER( node ); /* En-tte du bloc */
+
+    /* Vrification des paramtres */
+    assert( node );
+    assert( tree );
+
+    *tree = header->cold->tree;
+    return header->cold->base + (tstree_index_t)
+	(node - (tstree_node_t) header);
+}
+
+/**
+ * Ajoute un bloc  l'arne de l'arbre.
+ */
+static bool_t tstree_block_new( tstree_t tree )
+{
+    /* Variables locales */
+    unsigned int  size;   /* Nouvelle taille de la table */
+    void          *block; /* Bloc de noeuds              */
+    tstree_cold_t cold;   /* Donnes froides du bloc     */
+    void          *table; /* Table de blocs agrandie     */
+    tstree_cold_t *colds; /* Table de donnes agrandie   */
+
+    /* Vrification des paramtres */
+    assert( tree );
+
+    /* Agrandissement de la table des blocs si ncessaire ; pendant les
+     * ajouts concurrents, les anciennes tables, que d'autres threads peuvent
+     * encore lire, ne sont libres qu' la fin de ceux-ci */
+    if (tree->nblocks == tree->maxblocks) {
+	size = tree->maxblocks ? tree->maxblocks * 2 : BLOCK_TABLE_SIZE;
+
+	if (tree->shared) {
+	    if (tree->shared->nretired + 2 > RETIRED_SIZE ||
+		!(table = malloc( size * sizeof (tstree_node_t) )))
+		return FALSE;
+	    if (!(colds = malloc( size * sizeof (tstree_cold_t) ))) {
+		free( table );
+		return FALSE;
+	    }
+	    if (tree->nblocks != 0) {
+		memcpy( table, tree->blocks,
+			tree->nblocks * sizeof (tstree_node_t) );
+		memcpy( colds, tree->colds,
+			tree->nblocks * sizeof (tstree_cold_t) );
+	    }
+	    tree->shared->retired[tree->shared->nretired++] = tree->blocks;
+	    tree->shared->retired[tree->shared->nretired++] = tree->colds;
+	    __atomic_store_n( &tree->blocks, (tstree_node_t *) table,
+			      __ATOMIC_RELEASE );
+	    __atomic_store_n( &tree->colds, colds, __ATOMIC_RELEASE );
+	} else {
+	    if (!(table = realloc( tree->blocks,
+				   size * sizeof (tstree_node_t) )))
+		return FALSE;
+	    tree->blocks = table;
+
+	    if (!(table = realloc( tree->colds,
+				   size * sizeof (tstree_cold_t) )))
+		return FALSE;
+	    tree->colds = table;
+	}
+
+	tree->maxblocks = size;
+    }
+
+    /* Allocation du bloc align sur sa taille et de ses donnes froides */
+    if (posix_memalign( &block, BLOCK_SIZE, BLOCK_SIZE ) != 0)
+	return FALSE;
+    if (!(cold = malloc( sizeof (tstree_cold_s_t) ))) {
+	free( block );
+	return FALSE;
+    }
+
+    /* Allocation de la table des listes en cache si ncessaire */
+    cold->slots = NULL;
+    if (tree->cachesize != 0 &&
+	!(cold->slots = calloc( BLOCK_NODES, sizeof (unsigned int) ))) {
+	free( cold );
+	free( block );
+	return FALSE;
+    }
+
+    /* Initialisation de l'en-tte */
+    cold->tree = tree;
+    cold->base = tree->nblocks << BLOCK_SHIFT;
+    ((tstree_header_t) block)->cold = cold;
+
+    /* Ajout du bloc  la table, publi pour les ajouts concurrents */
+    tree->blocks[tree->nblocks] = block;
+    tree->colds[tree->nblocks]  = cold;
+    __atomic_store_n( &tree->nblocks, tree->nblocks + 1, __ATOMIC_RELEASE );
+
+    /* Pas d'erreur */
+    return TRUE;
+}
+
+/**
+ * Libre les blocs de l'arne d'un arbre et leur table.
+ */
+static void tstree_blocks_free( tstree_t tree )
+{
+    /* Variables locales */
+    unsigned int i; /* Compteur */
+
+    /* Vrification des paramtres */
+    assert( tree );
+
+    for (i = 0; i < tree->nblocks; i++) {
+	free( tree->blocks[i] );
+	free( tree->colds[i]->slots );
+	free( tree->colds[i] );
+    }
+    free( tree->blocks );
+    free( tree->colds );
+}
+
+/**
+ * Obtient le noeud correspondant au dernier caractre d'une cl (mot) pas
+ * forcment entire.
+ */
+static tstree_index_t tstree_get_node( const tstree_t tree, const char *key )
+{
+    /* Variables locales */
+    unsigned int   pos;    /* Position dans la chane    */
+    unsigned int   first;  /* Code du premier caractre  */
+    unsigned int   second; /* Code du deuxime caractre */
+    tstree_index_t index;  /* Noeud courant              */
+    tstree_node_t  node;   /* Noeud courant (pointeur)   */
+
+    /* Vrification des paramtres */
+    assert( tree );
+    assert( key );
+    assert( key[0] != '\0' );
+
+    /* Accs direct aux noeuds des deux premiers caractres s'ils sont
+     * indexs, la recherche se poursuivant  partir de leur fils */
+    index = tree->root;
+    pos   = 0;
+    if (tree->direct &&
+	(first = tree->codes[(unsigned char) key[0]]) != 0) {
+	if ((second = tree->codes[(unsigned char) key[1]]) != 0) {
+	    index = tree->seconds[first * DIRECT_CODES + second];
+	    pos   = 2;
+	} else {
+	    index = tree->firsts[first];
+	    pos   = 1;
+	}
+	if (!index || key[pos] == '\0')
+	    return index;
+	index = NODE( tree, index )->child;
+    }
+
+    /* Parcourt les noeuds, en comparant en une fois les caractres des
+     * frres larges */
+    for (;;) {
+	if (!index)
+	    return 0;
+
+	node = NODE( tree, index );
+	if (node->wide != 0) {
+	    if (!(index = tstree_wide_find( tree, node->wide, key[pos] )))
+		return 0;
+	    node = NODE( tree, index );
+	}
+	if (node->chr == key[pos]) {
+	    if (key[++pos] == '\0')
+		return index;
+	    index = node->child;
+	} else
+	    index = node->brothers[node->chr > key[pos] ? 0 : 1];
+    }
+}
+
+/**
+ * Cherche les `*number' cls les plus frquentes du sous-arbre d'un prfixe
+ * (tout l'arbre si `prefix' est nul), y compris le prfixe lui-mme.
+ */
+static bool_t tstree_select( const tstree_t tree, tstree_index_t prefix,
+			     tstree_node_t *nodes, unsigned int *number )
+{
+    /* Variables locales */
+    unsigned int      i;                   /* Compteur                    */
+    unsigned int      found;               /* Nombre de cls retenues     */
+    unsigned int      rank;                /* Nombre de cls numres    */
+    unsigned int      size;                /* Taille du tableau de cls   */
+    bool_t            all;                 /* Toutes les cls demandes   */
+    tstree_index_t    index;               /* Noeud courant               */
+    tstree_entry_t    entries;             /* Cls retenues               */
+    tstree_entry_s_t  entry;               /* Cl courante                */
+    tstree_entry_s_t  local[ENTRIES_SIZE]; /* Tableau initial             */
+    tstree_cursor_s_t cursor;              /* Curseur de parcours         */
+
+    /* Vrification des paramtres */
+    assert( tree );
+    assert( nodes );
+    assert( number );
+
+    if (*number == 0)
+	return TRUE;
+
+    /* Si toutes les cls peuvent tre retenues, elles sont simplement
+     * rassembles puis tries ; sinon, un tas de `*number' lments conserve
+     * les meilleures, la moins bonne tant  sa racine */
+    all     = *number >= tree->count;
+    size    = all ? ENTRIES_SIZE : *number;
+    entries = local;
+    if (size > ENTRIES_SIZE &&
+	!(entries = malloc( size * sizeof (tstree_entry_s_t) )))
+	return FALSE;
+
+    /* Parcours des cls dans l'ordre lexicographique : une fois le tas
+     * plein, seules les cls plus frquentes que sa racine sont encore
+     * numres, ce qui permet d'ignorer les sous-arbres dont la frquence
+     * maximale est trop faible (les cls de mme frquence viennent aprs
+     * dans l'ordre et ne sont donc pas meilleures) */
+    tstree_cursor_init( &cursor, tree, NULL );
+    tstree_cursor_start( &cursor, prefix );
+    found = 0;
+    rank  = 0;
+
+    while ((index = tstree_cursor_step( &cursor ))) {
+	entry.count = COUNT( tree, index );
+	entry.order = rank++;
+	entry.index = index;
+
+	if (all) {
+	    /* Agrandissement du tableau si ncessaire */
+	    if (found == size && !tstree_entries_grow( &entries, &size,
+						       local )) {
+		cursor.failed = TRUE;
+		break;
+	    }
+	    entries[found++] = entry;
+	} else if (found < size) {
+	    /* Ajout au tas tant qu'il n'est pas plein */
+	    entries[found] = entry;
+	    tstree_heap_up( entries, found++ );
+	} else {
+	    /* Remplacement de la racine (la cl est forcment meilleure) */
+	    entries[0] = entry;
+	    tstree_heap_down( entries, found, 0 );
+	}
+
+	/* Mise  jour de la frquence  dpasser */
+	if (!all && found == size)
+	    cursor.min = entries[0].count;
+    }
+    tstree_cursor_free( &cursor );
+
+    /* Rangement des cls par frquence dcroissante puis dans l'ordre
+     * lexicographique */
+    if (!cursor.failed) {
+	if (all)
+	    qsort( entries, found, sizeof (tstree_entry_s_t),
+		   tstree_entry_compare );
+	else
+	    for (i = found; i > 1; i--) {
+		entry = entries[0];
+		entries[0] = entries[i - 1];
+		entries[i - 1] = entry;
+		tstree_heap_down( entries, i - 1, 0 );
+	    }
+
+	for (i = 0; i < found; i++)
+	    nodes[i] = NODE( tree, entries[i].index );
+	*number = found;
+    }
+
+    /* Libration de la mmoire et retour du rsultat */
+    if (entries != local)
+	free( entries );
+    return !cursor.failed;
+}
+
+/**
+ * Construit les frres d'un intervalle de cls de mme prfixe : regroupe
+ * les cls par caractre suivant le prfixe, puis cre les frres.
+ */
+static bool_t tstree_build_level( tstree_builder_t builder,
+				  const tstree_range_s_t *range )
+{
+    /* Variables locales */
+    unsigned int   i;      /* Cl courante             */
+    unsigned int   number; /* Nombre de frres         */
+    unsigned int   count;  /* Frquence d'une cl      */
+    char           chr;    /* Caractre courant        */
+    tstree_group_t group;  /* Frre courant            */
+    tstree_t       tree;   /* Arbre construit          */
+
+    /* Vrification des paramtres */
+    assert( builder );
+    assert( range );
+    assert( range->first < range->last );
+
+    tree   = builder->tree;
+    number = 0;
+    for (i = range->first; i < range->last; ) {
+	/* Les caractres doivent tre croissants et les cls non vides */
+	chr = builder->keys[i][range->depth];
+	if (chr == '\0' ||
+	    (number != 0 && chr <= builder->groups[number - 1].chr))
+	    return FALSE;
+
+	group          = builder->groups + number++;
+	group->chr     = chr;
+	group->count   = 0;
+
+	/* Cls se terminant par ce caractre, places avant les autres */
+	for (; i < range->last && builder->keys[i][range->depth] == chr &&
+		 builder->keys[i][range->depth + 1] == '\0'; i++) {
+	    count = builder->counts ? builder->counts[i] : 1;
+	    assert( count != 0 );
+	    group->count = group->count > UINT_MAX - count ? UINT_MAX :
+		group->count + count;
+	}
+	group->maximum = group->count;
+	group->weight  = group->count;
+
+	/* Cls qui le prolongent */
+	group->first = i;
+	for (; i < range->last && builder->keys[i][range->depth] == chr;
+	     i++) {
+	    count = builder->counts ? builder->counts[i] : 1;
+	    assert( count != 0 );
+	    if (group->maximum < count)
+		group->maximum = count;
+	    group->weight += count;
+	}
+	group->last = i;
+
+	/* Mise  jour de la profondeur de l'arbre */
+	if (group->count != 0 && tree->depth < range->depth + 1)
+	    tree->depth = range->depth + 1;
+    }
+
+    /* Cration des frres sous le noeud du prfixe */
+    return tstree_build_brothers( builder, 0, number, range,
+				  range->parent ?
+				  &NODE( tree, range->parent )->child :
+				  &tree->root );
+}
+
+/**
+ * Cre les frres `first'  `last' (exclu) du niveau courant sous forme
+ * d'arbre binaire coup au frre mdian, rattach par `link', et ajoute 
+ * la pile les intervalles de leurs fils.
+ */
+static bool_t tstree_build_brothers( tstree_builder_t builder,
+				     unsigned int first, unsigned int last,
+				     const tstree_range_s_t *range,
+				     tstree_index_t *link )
+{
+    /* Variables locales */
+    unsigned int     middle;  /* Frre mdian             */
+    unsigned int     i;       /* Compteur                 */
+    unsigned int     maximum; /* Frquence maximale       */
+    double           total;   /* Frquence totale         */
+    double           before;  /* Frquence avant le mdian */
+    tstree_index_t   index;   /* Noeud cr               */
+    tstree_node_t    node;    /* Noeud cr (pointeur)    */
+    tstree_group_t   group;   /* Frre mdian (donnes)   */
+    tstree_range_t   ranges;  /* Pile agrandie            */
+    tstree_t         tree;    /* Arbre construit          */
+
+    /* Vrification des paramtres */
+    assert( builder );
+    assert( first < last );
+    assert( range );
+    assert( link );
+
+    tree = builder->tree;
+
+    /* Choix du frre mdian, en nombre ou en frquence */
+    if (builder->weighted) {
+	total = 0.0;
+	for (i = first; i < last; i++)
+	    total += builder->groups[i].weight;
+	before = 0.0;
+	for (middle = first; middle < last - 1; middle++) {
+	    if (2.0 * before + builder->groups[middle].weight >= total)
+		break;
+	    before += builder->groups[middle].weight;
+	}
+    } else
+	middle = first + (last - first) / 2;
+    group = builder->groups + middle;
+
+    /* Cration du noeud, dont la frquence maximale couvre ses frres */
+    if (!(index = tstree_node_new( tree, range->parent, group->chr )))
+	return FALSE;
+    *link = index;
+
+    maximum = 0;
+    for (i = first; i < last; i++)
+	if (maximum < builder->groups[i].maximum)
+	    maximum = builder->groups[i].maximum;
+    COUNT( tree, index )   = group->count;
+    MAXIMUM( tree, index ) = maximum;
+    if (group->count != 0)
+	tree->count++;
+
+    /* Ajout  la pile de l'intervalle du fils */
+    if (group->first < group->last) {
+	if (builder->top == builder->size) {
+	    if (!(ranges = realloc( builder->ranges, 2 * builder->size *
+				    sizeof (tstree_range_s_t) )))
+		return FALSE;
+	    builder->ranges = ranges;
+	    builder->size  *= 2;
+	}
+	builder->ranges[builder->top].first  = group->first;
+	builder->ranges[builder->top].last   = group->last;
+	builder->ranges[builder->top].depth  = range->depth + 1;
+	builder->ranges[builder->top].parent = index;
+	builder->top++;
+    }
+
+    /* Cration des frres infrieurs et suprieurs */
+    node = NODE( tree, index );
+    if (first < middle &&
+	!tstree_build_brothers( builder, first, middle, range,
+				node->brothers ))
+	return FALSE;
+    if (middle + 1 < last &&
+	!tstree_build_brothers( builder, middle + 1, last, range,
+				node->brothers + 1 ))
+	return FALSE;
+
+    /* Pas d'erreur */
+    return TRUE;
+}
+
+/**
+ * Ajoute un lment  la pile d'une fusion, agrandie si ncessaire.
+ */
+static bool_t tstree_merge_push( tstree_merger_t merger,
+				 tstree_index_t source, tstree_index_t parent,
+				 tstree_index_t *link )
+{
+    /* Variables locales */
+    tstree_merge_t items; /* Pile agrandie */
+
+    /* Vrification des paramtres */
+    assert( merger );
+    assert( source );
+
+    /* Agrandissement de la pile si ncessaire */
+    if (merger->top == merger->size) {
+	if (!(items = realloc( merger->items, 2 * merger->size *
+			       sizeof (tstree_merge_s_t) )))
+	    return FALSE;
+	merger->items = items;
+	merger->size *= 2;
+    }
+
+    /* Ajout de l'lment */
+    merger->items[merger->top].source = source;
+    merger->items[merger->top].parent = parent;
+    merger->items[merger->top].link   = link;
+    merger->top++;
+
+    /* Pas d'erreur */
+    return TRUE;
+}
+
+/**
+ * Fusionne l'ensemble de frres de racine `source' de l'autre arbre avec
+ * celui, non vide, du noeud `parent' : chaque frre est cherch, puis ajout
+ * s'il est absent, dans l'ordre d'un parcours prfixe qui reproduit la forme
+ * de l'ensemble. Les frquences s'additionnent, limites  UINT_MAX, et les
+ * fils sont ajouts  la pile,  fusionner ou, sous un frre cr, 
+ * recopier.
+ */
+static bool_t tstree_merge_brothers( tstree_merger_t merger,
+				     tstree_index_t source,
+				     tstree_index_t parent )
+{
+    /* Variables locales */
+    unsigned int   top;                 /* Hauteur de la pile        */
+    unsigned int   count;               /* Frquence d'une cl       */
+    unsigned int   maximum;             /* Frquence maximale        */
+    tstree_index_t index;               /* Frre de l'autre arbre    */
+    tstree_index_t found;               /* Frre de l'arbre complt */
+    tstree_index_t child;               /* Fils de l'autre arbre     */
+    tstree_index_t *next;               /* Lien vers le frre suivant */
+    tstree_node_t  node;                /* Noeud courant (pointeur)  */
+    tstree_t       tree;                /* Arbre complt            */
+    tstree_t       other;               /* Arbre fusionn            */
+    tstree_index_t stack[MAX_BROTHERS]; /* Parcours des frres       */
+
+    /* Vrification des paramtres */
+    assert( merger );
+    assert( source );
+
+    tree  = merger->tree;
+    other = merger->other;
+
+    for (stack[0] = source, top = 1; top != 0; ) {
+	/* Frre suivant du parcours prfixe */
+	index = stack[--top];
+	node  = NODE( other, index );
+	if (node->brothers[1] != 0)
+	    stack[top++] = node->brothers[1];
+	if (node->brothers[0] != 0)
+	    stack[top++] = node->brothers[0];
+	child = node->child;
+
+	/* Recherche du caractre parmi les frres de l'arbre complt */
+	next = parent ? &NODE( tree, parent )->child : &tree->root;
+	while ((found = *next) != 0) {
+	    node = NODE( tree, found );
+	    if (node->chr == NODE( other, index )->chr)
+		break;
+	    next = node->brothers + (node->chr > NODE( other, index )->chr ?
+				     0 : 1);
+	}
+
+	count = COUNT( other, index );
+	if (found != 0) {
+	    /* Frre commun : ajout des frquences */
+	    if (count != 0) {
+		if (COUNT( tree, found ) == 0)
+		    tree->count++;
+		count = COUNT( tree, found ) > UINT_MAX - count ? UINT_MAX :
+		    COUNT( tree, found ) + count;
+		COUNT( tree, found ) = count;
+		tstree_raise_maxima( tree, found, count );
+	    }
+
+	    /* Les fils sont fusionns  leur tour */
+	    if (child != 0 && !tstree_merge_push( merger, child, found, NULL ))
+		return FALSE;
+	} else {
+	    /* Frre absent : cration, et recopie de ses fils */
+	    if (!(found = tstree_node_new( tree, parent,
+					   NODE( other, index )->chr )))
+		return FALSE;
+	    *next = found;
+	    tstree_wide_add( tree, parent, found );
+
+	    maximum = count;
+	    if (child != 0 && maximum < MAXIMUM( other, child ))
+		maximum = MAXIMUM( other, child );
+	    COUNT( tree, found )   = count;
+	    MAXIMUM( tree, found ) = maximum;
+	    if (count != 0)
+		tree->count++;
+	    tstree_raise_maxima( tree, found, maximum );
+
+	    if (child != 0 &&
+		!tstree_merge_push( merger, child, found,
+				    &NODE( tree, found )->child ))
+		return FALSE;
+	}
+    }
+
+    /* Pas d'erreur */
+    return TRUE;
+}
+
+/**
+ * Recopie un noeud de l'autre arbre, rattach par le lien de l'lment, et
+ * ajoute  la pile ses frres et son fils : la copie d'un sous-arbre garde
+ * ainsi ses frquences maximales.
+ */
+static bool_t tstree_merge_copy( tstree_merger_t merger,
+				 const tstree_merge_s_t *item )
+{
+    /* Variables locales */
+    tstree_index_t index; /* Noeud cr              */
+    tstree_node_t  node;  /* Noeud recopi (pointeur) */
+    tstree_t       tree;  /* Arbre complt          */
+
+    /* Vrification des paramtres */
+    assert( merger );
+    assert( item );
+    assert( item->link );
+
+    tree = merger->tree;
+    node = NODE( merger->other, item->source );
+
+    /* Cration du noeud */
+    if (!(index = tstree_node_new( tree, item->parent, node->chr )))
+	return FALSE;
+    *item->link = index;
+
+    COUNT( tree, index )   = COUNT( merger->other, item->source );
+    MAXIMUM( tree, index ) = MAXIMUM( merger->other, item->source );
+    if (COUNT( tree, index ) != 0)
+	tree->count++;
+
+    /* Ajout  la pile des frres et du fils */
+    if (node->brothers[0] != 0 &&
+	!tstree_merge_push( merger, node->brothers[0], item->parent,
+			    NODE( tree, index )->brothers ))
+	return FALSE;
+    if (node->brothers[1] != 0 &&
+	!tstree_merge_push( merger, node->brothers[1], item->parent,
+			    NODE( tree, index )->brothers + 1 ))
+	return FALSE;
+    if (node->child != 0 &&
+	!tstree_merge_push( merger, node->child, index,
+			    &NODE( tree, index )->child ))
+	return FALSE;
+
+    /* Pas d'erreur */
+    return TRUE;
+}
+
+/**
+ * Porte  au moins `count' la frquence maximale d'un noeud et de chacun
+ * des noeuds traverss pour l'atteindre depuis la racine : ensemble par
+ * ensemble, en remontant tant que la racine de l'ensemble tait infrieure
+ * (celles des noeuds plus haut sont toujours au moins gales).
+ */
+static void tstree_raise_maxima( tstree_t tree, tstree_index_t index,
+				 unsigned int count )
+{
+    /* Variables locales */
+    tstree_index_t parent;  /* Noeud du prfixe          */
+    tstree_index_t current; /* Noeud courant             */
+    tstree_node_t  node;    /* Noeud courant (pointeur)  */
+    bool_t         raised;  /* Racine de l'ensemble porte */
+    char           chr;     /* Caractre du noeud        */
+
+    /* Vrification des paramtres */
+    assert( tree );
+
+    for (; index != 0; index = parent) {
+	parent  = PARENT( tree, index );
+	chr     = NODE( tree, index )->chr;
+	current = parent ? NODE( tree, parent )->child : tree->root;
+	raised  = MAXIMUM( tree, current ) < count;
+
+	/* Descente de la racine de l'ensemble jusqu'au noeud */
+	for (;;) {
+	    if (MAXIMUM( tree, current ) < count)
+		MAXIMUM( tree, current ) = count;
+	    if (current == index)
+		break;
+	    node    = NODE( tree, current );
+	    current = node->brothers[node->chr > chr ? 0 : 1];
+	}
+
+	if (!raised)
+	    break;
+    }
+}
+
+/**
+ * Range dans un ensemble  rquilibrer les fils d'un noeud (ou la racine
+ * si `parent' est nul), dans l'ordre des caractres.
+ */
+static void tstree_rebalance_list( const tstree_t tree, tstree_level_t level,
+				   tstree_index_t parent )
+{
+    /* Variables locales */
+    unsigned int   top;                 /* Hauteur de la pile */
+    tstree_index_t index;               /* Frre courant      */
+    tstree_index_t stack[MAX_BROTHERS]; /* Parcours infixe    */
+
+    /* Vrification des paramtres */
+    assert( tree );
+    assert( level );
+
+    level->parent = parent;
+    level->number = 0;
+    level->next   = 0;
+    index = parent ? NODE( tree, parent )->child : tree->root;
+    for (top = 0; index != 0 || top != 0; ) {
+	while (index != 0) {
+	    stack[top++] = index;
+	    index        = NODE( tree, index )->brothers[0];
+	}
+	index = stack[--top];
+	level->totals[level->number]  = 0.0;
+	level->nodes[level->number++] = index;
+	index = NODE( tree, index )->brothers[1];
+    }
+}
+
+/**
+ * Relie les frres `first'  `last' (exclu) d'un ensemble, rangs dans
+ * l'ordre des caractres avec les frquences totales de leurs fils, en un
+ * arbre binaire coup au frre mdian en frquence totale, et retourne sa
+ * racine. Les frquences maximales sont recalcules, celles des fils tant
+ * supposes  jour.
+ */
+static tstree_index_t tstree_rebalance_brothers( tstree_t tree,
+						 const tstree_index_t *nodes,
+						 const double *totals,
+						 unsigned int first,
+						 unsigned int last )
+{
+    /* Variables locales */
+    unsigned int   middle;  /* Frre mdian              */
+    unsigned int   i;       /* Compteur                  */
+    unsigned int   maximum; /* Frquence maximale        */
+    double         total;   /* Frquence totale          */
+    double         before;  /* Frquence avant le mdian */
+    tstree_index_t index;   /* Frre mdian (index)      */
+    tstree_node_t  node;    /* Frre mdian (pointeur)   */
+
+    /* Vrification des paramtres */
+    assert( tree );
+    assert( nodes );
+    assert( totals );
+    assert( first < last );
+
+    /* Choix du frre mdian en frquence */
+    total = 0.0;
+    for (i = first; i < last; i++)
+	total += COUNT( tree, nodes[i] ) + totals[i];
+    before = 0.0;
+    for (middle = first; middle < last - 1; middle++) {
+	index = nodes[middle];
+	if (2.0 * before + COUNT( tree, index ) + totals[middle] >= total)
+	    break;
+	before += COUNT( tree, index ) + totals[middle];
+    }
+
+    /* Frres infrieurs et suprieurs */
+    index = nodes[middle];
+    node  = NODE( tree, index );
+    node->brothers[0] = first < middle ?
+	tstree_rebalance_brothers( tree, nodes, totals, first, middle ) : 0;
+    node->brothers[1] = middle + 1 < last ?
+	tstree_rebalance_brothers( tree, nodes, totals, middle + 1, last ) :
+	0;
+
+    /* Frquence maximale du sous-arbre */
+    maximum = COUNT( tree, index );
+    if (node->child != 0 && maximum < MAXIMUM( tree, node->child ))
+	maximum = MAXIMUM( tree, node->child );
+    for (i = 0; i < 2; i++)
+	if (node->brothers[i] != 0 &&
+	    maximum < MAXIMUM( tree, node->brothers[i] ))
+	    maximum = MAXIMUM( tree, node->brothers[i] );
+    MAXIMUM( tree, index ) = maximum;
+
+    return index;
+}
+
+/**
+ * Cherche parmi les frres larges d'une chane d'lments celui qui
+ * correspond  un caractre (0 s'il n'y en a pas).
+ */
+static tstree_index_t tstree_wide_find( const tstree_t tree,
+					unsigned int wide, char chr )
+{
+    /* Variables locales */
+    tstree_wide_t record; /* lment courant                  */
+#if defined( __SSE2__ ) && defined( __GNUC__ )
+    unsigned int  mask;   /* Frres de mme caractre         */
+    __m128i       key;    /* Caractre rpt dans le registre */
+
+    /* Comparaison des caractres de chaque lment en une instruction */
+    key = _mm_set1_epi8( chr );
+    do {
+	record = tree->wides + wide;
+	mask   = (unsigned int) _mm_movemask_epi8(
+	    _mm_cmpeq_epi8( _mm_loadu_si128( (const __m128i *) record->chrs ),
+			    key ) ) & ((1U << record->count) - 1);
+	if (mask != 0)
+	    return record->nodes[__builtin_ctz( mask )];
+    } while ((wide = record->next) != 0);
+#else /* __SSE2__ && __GNUC__ */
+    unsigned int  i;      /* Compteur                         */
+
+    /* Comparaison des caractres de chaque lment un  un */
+    do {
+	record = tree->wides + wide;
+	for (i = 0; i < record->count; i++)
+	    if (record->chrs[i] == chr)
+		return record->nodes[i];
+    } while ((wide = record->next) != 0);
+#endif /* !__SSE2__ || !__GNUC__ */
+
+    return 0;
+}
+
+/**
+ * Rpercute sur les frres larges la cration d'un noeud, fils de `parent' :
+ * il est ajout aux frres larges de son ensemble, ou celui-ci en est doubl
+ * s'il atteint le seuil. Si la mmoire manque, l'ensemble redevient un
+ * simple arbre binaire.
+ */
+static void tstree_wide_add( tstree_t tree, tstree_index_t parent,
+			     tstree_index_t index )
+{
+    /* Variables locales */
+    tstree_index_t root;   /* Racine de l'ensemble de frres */
+    unsigned int   wide;   /* Dernier lment de la chane   */
+    unsigned int   added;  /* lment ajout                 */
+    tstree_wide_t  record; /* lment complt               */
+
+    /* Vrification des paramtres */
+    assert( tree );
+    assert( index );
+
+    root = parent ? NODE( tree, parent )->child : tree->root;
+    if (tree->widening == 0 || root == index)
+	return;
+
+    /* Ensemble sans frres larges : doublement s'il est assez grand */
+    if ((wide = NODE( tree, root )->wide) == 0) {
+	tstree_wide_promote( tree, root );
+	return;
+    }
+
+    /* Ajout au dernier lment de la chane, ou  un nouvel lment */
+    while (tree->wides[wide].next != 0)
+	wide = tree->wides[wide].next;
+    if (tree->wides[wide].count == WIDE_CHARS) {
+	if (!(added = tstree_wide_new( tree, 1 ))) {
+	    NODE( tree, root )->wide = 0;
+	    return;
+	}
+	tree->wides[wide].next = added;
+	wide                   = added;
+    }
+
+    record = tree->wides + wide;
+    record->chrs[record->count]    = NODE( tree, index )->chr;
+    record->nodes[record->count++] = index;
+}
+
+/**
+ * Double de frres larges l'ensemble de frres de racine `root' s'il compte
+ * au moins autant de frres que le seuil de l'arbre (rien n'est fait si les
+ * lments ne peuvent plus tre dsigns par un noeud).
+ */
+static bool_t tstree_wide_promote( tstree_t tree, tstree_index_t root )
+{
+    /* Variables locales */
+    unsigned int   number;              /* Nombre de frres     */
+    unsigned int   top;                 /* Hauteur de la pile   */
+    unsigned int   first;               /* Premier lment      */
+    unsigned int   i;                   /* Compteur             */
+    tstree_index_t index;               /* Frre courant        */
+    tstree_wide_t  record;              /* lment courant      */
+    tstree_index_t nodes[MAX_BROTHERS]; /* Frres, dans l'ordre */
+    tstree_index_t stack[MAX_BROTHERS]; /* Parcours des frres  */
+
+    /* Vrification des paramtres */
+    assert( tree );
+    assert( root );
+
+    /* Liste des frres */
+    number = 0;
+    for (index = root, top = 0; index != 0 || top != 0; ) {
+	while (index != 0) {
+	    stack[top++] = index;
+	    index        = NODE( tree, index )->brothers[0];
+	}
+	index           = stack[--top];
+	nodes[number++] = index;
+	index           = NODE( tree, index )->brothers[1];
+    }
+    if (number < tree->widening)
+	return TRUE;
+
+    /* Remplissage d'une chane d'lments conscutifs */
+    if (tree->nwides > USHRT_MAX)
+	return TRUE;
+    if (!(first = tstree_wide_new( tree, (number + WIDE_CHARS - 1) /
+				   WIDE_CHARS )))
+	return FALSE;
+
+    for (i = 0; i < number; i++) {
+	record = tree->wides + first + i / WIDE_CHARS;
+	record->chrs[i % WIDE_CHARS]  = NODE( tree, nodes[i] )->chr;
+	record->nodes[i % WIDE_CHARS] = nodes[i];
+	record->count++;
+	if (i % WIDE_CHARS == WIDE_CHARS - 1 && i + 1 < number)
+	    record->next = first + i / WIDE_CHARS + 1;
+    }
+
+    NODE( tree, root )->wide = (unsigned short) first;
+    return TRUE;
+}
+
+/**
+ * Rserve `number' lments de frres larges conscutifs et vides (le
+ * premier est toujours rserv) ; retourne l'index du premier (0 en cas
+ * d'erreur).
+ */
+static unsigned int tstree_wide_new( tstree_t tree, unsigned int number )
+{
+    /* Variables locales */
+    unsigned int  size;  /* Nouvelle taille de la table */
+    unsigned int  first; /* Premier lment rserv     */
+    tstree_wide_t wides; /* Table agrandie              */
+
+    /* Vrification des paramtres */
+    assert( tree );
+    assert( number != 0 );
+
+    /* Agrandissement de la table si ncessaire */
+    if (tree->nwides == 0)
+	tree->nwides = 1;
+    if (tree->nwides + number > tree->maxwides) {
+	size = tree->maxwides ? tree->maxwides : WIDE_TABLE_SIZE;
+	while (tree->nwides + number > size)
+	    size *= 2;
+	if (!(wides = realloc( tree->wides,
+			       size * sizeof (tstree_wide_s_t) )))
+	    return 0;
+	tree->wides    = wides;
+	tree->maxwides = size;
+    }
+
+    first         = tree->nwides;
+    tree->nwides += number;
+    memset( tree->wides + first, 0, number * sizeof (tstree_wide_s_t) );
+    return first;
+}
+
+/**
+ * Reconstruit les frres larges de tous les ensembles de frres, dont les
+ * racines ont pu changer.
+ */
+static bool_t tstree_wide_rebuild( tstree_t tree )
+{
+    /* Variables locales */
+    tstree_index_t index;  /* Noeud courant */
+    bool_t         result; /* Rsultat      */
+
+    /* Vrification des paramtres */
+    assert( tree );
+
+    /* Oubli des anciens lments */
+    tree->nwides = 0;
+    for (index = 1; index < tree->next; index++)
+	if ((index & BLOCK_MASK) != 0)
+	    NODE( tree, index )->wide = 0;
+
+    if (tree->widening == 0 || tree->root == 0)
+	return TRUE;
+
+    /* Doublement de l'ensemble de la racine et de ceux de chaque fils */
+    result = tstree_wide_promote( tree, tree->root );
+    for (index = 1; result && index < tree->next; index++)
+	if ((index & BLOCK_MASK) != 0 && NODE( tree, index )->child != 0)
+	    result = tstree_wide_promote( tree, NODE( tree, index )->child );
+
+    return result;
+}
+
+/**
+ * Initialise un curseur pour l'numration des cls commenant par un
+ * prfixe (toutes les cls si celui-ci est vide).
+ */
+static void tstree_cursor_init( tstree_cursor_t cursor, const tstree_t tree,
+				const char *key )
+{
+    /* Variables locales */
+    tstree_index_t index; /* Noeud du prfixe */
+
+    /* Vrification des paramtres */
+    assert( cursor );
+    assert( tree );
+
+    /* Initialisation des champs */
+    cursor->tree         = tree;
+    cursor->prefix       = 0;
+    cursor->next         = tree->root;
+    cursor->min          = 0;
+    cursor->failed       = FALSE;
+    cursor->stack.top    = 0;
+    cursor->stack.size   = STACK_SIZE;
+    cursor->stack.frames = cursor->stack.local;
+
+    /* Recherche du noeud correspondant au prfixe */
+    if (key && key[0] != '\0') {
+	if ((index = tstree_get_node( tree, key )))
+	    tstree_cursor_start( cursor, index );
+	else
+	    cursor->next = 0;
+    }
+}
+
+/**
+ * Fait commencer l'numration d'un curseur au noeud d'un prfixe ( la
+ * racine si celui-ci est nul).
+ */
+static void tstree_cursor_start( tstree_cursor_t cursor,
+				 tstree_index_t prefix )
+{
+    /* Vrification des paramtres */
+    assert( cursor );
+
+    /* Le prfixe est signal en premier s'il est lui-mme une cl */
+    if (prefix) {
+	cursor->prefix = COUNT( cursor->tree, prefix ) != 0 ? prefix : 0;
+	cursor->next   = NODE( cursor->tree, prefix )->child;
+    } else {
+	cursor->prefix = 0;
+	cursor->next   = cursor->tree->root;
+    }
+}
+
+/**
+ * Avance un curseur jusqu' la prochaine cl et retourne l'index de son noeud
+ * (0 s'il n'y en a plus).
+ */
+static tstree_index_t tstree_cursor_step( tstree_cursor_t cursor )
+{
+    /* Variables locales */
+    tstree_t         tree;  /* Arbre parcouru    */
+    tstree_stack_t   stack; /* Pile de parcours  */
+    tstree_index_t   index; /* Noeud courant     */
+    tstree_frame_t   frame; /* Sommet de la pile */
+    tstree_node_t    node;  /* Noeud courant     */
+
+    /* Vrification des paramtres */
+    assert( cursor );
+
+    tree  = cursor->tree;
+    stack = &cursor->stack;
+
+    /* Le prfixe lui-mme est signal en premier */
+    if ((index = cursor->prefix)) {
+	cursor->prefix = 0;
+	return index;
+    }
+
+    index = cursor->next;
+    for (;;) {
+	/* Empile le noeud courant et tous ses frres infrieurs, sauf si
+	 * aucune cl de leurs sous-arbres n'a une frquence suffisante */
+	while (index && MAXIMUM( tree, index ) > cursor->min) {
+	    if (stack->top == stack->size && !tstree_stack_grow( stack )) {
+		cursor->failed = TRUE;
+		stack->top = 0;
+		return 0;
+	    }
+	    stack->frames[stack->top].index   = index;
+	    stack->frames[stack->top++].visit = FALSE;
+	    index = NODE( tree, index )->brothers[0];
+	}
+	if (stack->top == 0) {
+	    cursor->next = 0;
+	    return 0;
+	}
+
+	/* Traitement du noeud au sommet de la pile */
+	frame = stack->frames + stack->top - 1;
+	node  = NODE( tree, frame->index );
+
+	if (frame->visit) {
+	    /* Le fils a t parcouru : passe au frre suprieur */
+	    stack->top--;
+	    index = node->brothers[1];
+	} else if (MAXIMUM( tree, frame->index ) <= cursor->min) {
+	    /* La frquence  dpasser a augment depuis que le noeud a t
+	     * empil : le reste de son sous-arbre est ignor */
+	    stack->top--;
+	    index = 0;
+	} else {
+	    /* Parcourt le fils puis le frre suprieur ; le noeud n'est
+	     * conserv dans la pile que s'il a les deux */
+	    index = frame->index;
+	    if (node->child && node->brothers[1]) {
+		frame->visit = TRUE;
+		cursor->next = node->child;
+	    } else {
+		stack->top--;
+		cursor->next = node->child ? node->child : node->brothers[1];
+	    }
+
+	    /* Si une cl assez frquente correspond  ce noeud, la retourne */
+	    if (COUNT( tree, index ) > cursor->min)
+		return index;
+	    index = cursor->next;
+	}
+    }
+}
+
+/**
+ * Libre la pile d'un curseur si elle a t agrandie.
+ */
+static void tstree_cursor_free( tstree_cursor_t cursor )
+{
+    /* Vrification des paramtres */
+    assert( cursor );
+
+    /* Libration de la pile */
+    if (cursor->stack.frames != cursor->stack.local)
+	free( cursor->stack.frames );
+}
+
+/**
+ * Rpercute la nouvelle frquence d'une cl sur la frquence maximale de
+ * chacun des noeuds traverss pour l'atteindre.
+ */
+static void tstree_update_maxima( tstree_t tree, const char *key,
+				  unsigned int count )
+{
+    /* Variables locales */
+    unsigned int   pos;   /* Position dans la chane  */
+    tstree_index_t index; /* Noeud courant            */
+    tstree_node_t  node;  /* Noeud courant (pointeur) */
+
+    /* Vrification des paramtres */
+    assert( tree );
+    assert( key );
+
+    /* Parcourt les noeuds du chemin */
+    for (index = tree->root, pos = 0; index; ) {
+	if (MAXIMUM( tree, index ) < count)
+	    MAXIMUM( tree, index ) = count;
+
+	node = NODE( tree, index );
+	if (node->chr == key[pos]) {
+	    if (key[++pos] == '\0')
+		break;
+	    index = node->child;
+	} else
+	    index = node->brothers[node->chr > key[pos] ? 0 : 1];
+    }
+}
+
+/**
+ * Termine l'ajout de `number' occurences d'une cl de `pos' caractres,
+ * dont le noeud est `index' : met  jour sa frquence, limite  UINT_MAX,
+ * et les frquences maximales des `length' noeuds traverss (mmoriss
+ * dans `path' s'ils ne sont pas plus de `size'), puis les listes en cache.
+ */
+static tstree_node_t tstree_add_count( tstree_t tree, const char *key,
+				       unsigned int pos, tstree_index_t index,
+				       unsigned int number,
+				       const tstree_index_t *path,
+				       unsigned int length, unsigned int size )
+{
+    /* Variables locales */
+    unsigned int count; /* Frquence de la cl */
+
+    /* Vrification des paramtres */
+    assert( tree );
+    assert( key );
+    assert( index );
+    assert( path || length == 0 );
+
+    /* Ajout de la cl au compteur */
+    if (COUNT( tree, index ) == 0)
+	tree->count++;
+    count = COUNT( tree, index );
+    count = count > UINT_MAX - number ? UINT_MAX : count + number;
+    COUNT( tree, index ) = count;
+
+    /* Mise  jour des frquences maximales le long du chemin, en remontant
+     * tant qu'elles sont infrieures (celles des noeuds plus haut sont
+     * toujours au moins gales) ; si le chemin tait trop long pour tre
+     * mmoris, il est parcouru  nouveau depuis la racine */
+    if (length <= size) {
+	while (length != 0 && MAXIMUM( tree, path[length - 1] ) < count) {
+	    length--;
+	    MAXIMUM( tree, path[length] ) = count;
+	}
+    } else
+	tstree_update_maxima( tree, key, count );
+
+    /* Mise  jour des listes en cache des prfixes de la cl */
+    if (tree->cachevalid)
+	tstree_cache_update( tree, key, pos, index );
+
+    /* Mise  jour de la profondeur de l'arbre */
+    if (tree->depth < pos)
+	tree->depth = pos;
+
+    /* Retour du noeud de la cl */
+    return NODE( tree, index );
+}
+
+/**
+ * Rserve un noeud vide pendant les ajouts concurrents, en allouant son bloc
+ * sous le verrou si aucun thread ne l'a encore fait.
+ */
+static tstree_index_t tstree_shared_node_new( tstree_t tree )
+{
+    /* Variables locales */
+    tstree_index_t index;  /* Index du noeud rserv */
+    tstree_node_t  node;   /* Noeud rserv          */
+    tstree_cold_t  cold;   /* Donnes de son bloc    */
+    bool_t         result; /* Pas d'erreur           */
+
+    /* Vrification des paramtres */
+    assert( tree );
+    assert( tree->shared );
+
+    /* Rservation d'un index (le premier emplacement de chaque bloc est
+     * rserv  son en-tte, le dernier bloc possible n'est pas utilis) */
+    do
+	index = __atomic_fetch_add( &tree->next, 1, __ATOMIC_RELAXED );
+    while ((index & BLOCK_MASK) == 0 &&
+	   index >> BLOCK_SHIFT < UINT_MAX >> BLOCK_SHIFT);
+    if (index >> BLOCK_SHIFT >= UINT_MAX >> BLOCK_SHIFT)
+	return 0;
+
+    /* Allocation des blocs jusqu' celui du noeud */
+    if (index >> BLOCK_SHIFT >= __atomic_load_n( &tree->nblocks,
+						 __ATOMIC_ACQUIRE )) {
+	pthread_mutex_lock( &tree->shared->mutex );
+	result = TRUE;
+	while (result && tree->nblocks <= index >> BLOCK_SHIFT)
+	    result = tstree_block_new( tree );
+	pthread_mutex_unlock( &tree->shared->mutex );
+	if (!result)
+	    return 0;
+    }
+
+    /* Initialisation du noeud, qui n'est visible que de ce thread */
+    node = SHARED_NODE( tree, index );
+    node->brothers[0] = 0;
+    node->brothers[1] = 0;
+    node->child       = 0;
+    node->wide        = 0;
+
+    cold = SHARED_COLD( tree, index );
+    cold->counts[index & BLOCK_MASK] = 0;
+    cold->maxima[index & BLOCK_MASK] = 0;
+    if (tree->cachesize != 0)
+	cold->slots[index & BLOCK_MASK] = 0;
+
+    return index;
+}
+
+/**
+ * Porte de faon atomique la frquence maximale d'un noeud  `count' si elle
+ * est infrieure ; indique si c'tait le cas.
+ */
+static bool_t tstree_shared_raise( tstree_t tree, tstree_index_t index,
+				   unsigned int count )
+{
+    /* Variables locales */
+    unsigned int *maximum; /* Frquence maximale du noeud */
+    unsigned int old;      /* Ancienne valeur            */
+
+    maximum = SHARED_COLD( tree, index )->maxima + (index & BLOCK_MASK);
+    old     = __atomic_load_n( maximum, __ATOMIC_RELAXED );
+    while (old < count)
+	if (__atomic_compare_exchange_n( maximum, &old, count, 0,
+					 __ATOMIC_RELAXED, __ATOMIC_RELAXED ))
+	    return TRUE;
+
+    return FALSE;
+}
+
+/**
+ * Rpercute pendant les ajouts concurrents la nouvelle frquence d'une cl
+ * sur chacun des noeuds traverss pour l'atteindre, comme
+ * tstree_update_maxima().
+ */
+static void tstree_shared_maxima( tstree_t tree, const char *key,
+				  unsigned int count )
+{
+    /* Variables locales */
+    unsigned int   pos;   /* Position dans la chane  */
+    tstree_index_t index; /* Noeud courant            */
+    tstree_node_t  node;  /* Noeud courant (pointeur) */
+
+    /* Vrification des paramtres */
+    assert( tree );
+    assert( key );
+
+    /* Parcourt les noeuds du chemin */
+    index = __atomic_load_n( &tree->root, __ATOMIC_ACQUIRE );
+    for (pos = 0; index; ) {
+	tstree_shared_raise( tree, index, count );
+
+	node = SHARED_NODE( tree, index );
+	if (node->chr == key[pos]) {
+	    if (key[++pos] == '\0')
+		break;
+	    index = __atomic_load_n( &node->child, __ATOMIC_ACQUIRE );
+	} else
+	    index = __atomic_load_n( node->brothers +
+				     (node->chr > key[pos] ? 0 : 1),
+				     __ATOMIC_ACQUIRE );
+    }
+}
+
+/**
+ * Agrandit si ncessaire le chemin mmoris par un objet d'insertion pour
+ * qu'il puisse recevoir le caractre `pos' de la cl, le chemin comptant
+ * dj `length' noeuds.
+ */
+static bool_t tstree_inserter_grow( tstree_inserter_t inserter,
+				    unsigned int pos, unsigned int length )
+{
+    /* Variables locales */
+    unsigned int   size; /* Nouvelle taille */
+    tstree_index_t *path; /* Chemin agrandi  */
+    unsigned int   *ends; /* Fins agrandies  */
+
+    /* Vrification des paramtres */
+    assert( inserter );
+
+    if (length + MAX_BROTHERS > inserter->size) {
+	size = 2 * inserter->size > length + MAX_BROTHERS ?
+	    2 * inserter->size : length + MAX_BROTHERS;
+	if (!(path = realloc( inserter->path,
+			      size * sizeof (tstree_index_t) )))
+	    return FALSE;
+	inserter->path = path;
+	inserter->size = size;
+    }
+
+    if (pos >= inserter->maxdepth) {
+	size = 2 * inserter->maxdepth > pos ? 2 * inserter->maxdepth :
+	    pos + STACK_SIZE;
+	if (!(ends = realloc( inserter->ends, size * sizeof (unsigned int) )))
+	    return FALSE;
+	inserter->ends     = ends;
+	inserter->maxdepth = size;
+    }
+
+    /* Pas d'erreur */
+    return TRUE;
+}
+
+/**
+ * Compare deux cls retenues : la plus frquente, ou  dfaut la premire
+ * numre, est place avant l'autre (fonction de comparaison pour qsort()).
+ */
+static int tstree_entry_compare( const void *first, const void *second )
+{
+    /* Variables locales */
+    const tstree_entry_s_t *a = first;  /* Premire cl */
+    const tstree_entry_s_t *b = second; /* Seconde cl  */
+
+    if (a->count != b->count)
+	return a->count > b->count ? -1 : 1;
+    return a->order < b->order ? -1 : a->order > b->order;
+}
+
+/**
+ * Fait remonter un lment du tas de slection tant qu'il est moins bon que
+ * son parent (la racine est la moins bonne cl retenue).
+ */
+static void tstree_heap_up( tstree_entry_t heap, unsigned int pos )
+{
+    /* Variables locales */
+    unsigned int     parent; /* Position du parent  */
+    tstree_entry_s_t entry;  /* lment  remonter  */
+
+    /* Vrification des paramtres */
+    assert( heap );
+
+    entry = heap[pos];
+    while (pos > 0) {
+	parent = (pos - 1) / 2;
+	if (!WORSE( &entry, heap + parent ))
+	    break;
+	heap[pos] = heap[parent];
+	pos = parent;
+    }
+    heap[pos] = entry;
+}
+
+/**
+ * Fait descendre un lment du tas de slection tant qu'un de ses fils est
+ * moins bon que lui.
+ */
+static void tstree_heap_down( tstree_entry_t heap, unsigned int size,
+			      unsigned int pos )
+{
+    /* Variables locales */
+    unsigned int     child; /* Position du fils le moins bon */
+    tstree_entry_s_t entry; /* lment  descendre           */
+
+    /* Vrification des paramtres */
+    assert( heap );
+
+    entry = heap[pos];
+    while ((child = 2 * pos + 1) < size) {
+	if (child + 1 < size && WORSE( heap + child + 1, heap + child ))
+	    child++;
+	if (!WORSE( heap + child, &entry ))
+	    break;
+	heap[pos] = heap[child];
+	pos = child;
+    }
+    heap[pos] = entry;
+}
+
+/**
+ * Double la taille du tableau de cls retenues.
+ */
+static bool_t tstree_entries_grow( tstree_entry_t *entries,
+				   unsigned int *size, tstree_entry_t local )
+{
+    /* Variables locales */
+    tstree_entry_t grown; /* Nouveau tableau */
+
+    /* Vrification des paramtres */
+    assert( entries );
+    assert( size );
+
+    /* Allocation du nouveau tableau */
+    if (*entries == local) {
+	if (!(grown = malloc( 2 * *size * sizeof (tstree_entry_s_t) )))
+	    return FALSE;
+	memcpy( grown, local, *size * sizeof (tstree_entry_s_t) );
+    } else if (!(grown = realloc( *entries, 2 * *size *
+				  sizeof (tstree_entry_s_t) )))
+	return FALSE;
+
+    /* Mise  jour du tableau */
+    *entries = grown;
+    *size   *= 2;
+
+    /* Pas d'erreur */
+    return TRUE;
+}
+
+/**
+ * Compare la cl d'un noeud  une chane de longueur connue, dans l'ordre
+ * des caractres utilis par l'arbre (un prfixe est plac avant les cls
+ * qui le prolongent).
+ */
+static int tstree_compare_key( const tstree_t tree, tstree_index_t index,
+			       const char *key, unsigned int length )
+{
+    /* Variables locales */
+    unsigned int   depth;  /* Longueur de la cl du noeud */
+    unsigned int   pos;    /* Position dans la cl        */
+    int            result; /* Rsultat de la comparaison  */
+    tstree_index_t parent; /* Noeud courant               */
+    char           chr;    /* Caractre du noeud          */
+
+    /* Vrification des paramtres */
+    assert( tree );
+    assert( index );
+    assert( key );
+
+    /* Calcul de la longueur de la cl du noeud */
+    depth = 0;
+    for (parent = index; parent; parent = PARENT( tree, parent ))
+	depth++;
+
+    /* En remontant les parents, la dernire diffrence trouve est la
+     * premire dans l'ordre des caractres */
+    result = 0;
+    pos    = depth;
+    for (parent = index; parent; parent = PARENT( tree, parent )) {
+	pos--;
+	chr = NODE( tree, parent )->chr;
+	if (pos < length && chr != key[pos])
+	    result = chr < key[pos] ? -1 : 1;
+    }
+
+    /*  dfaut, la cl la plus courte est la premire */
+    if (result == 0 && depth != length)
+	result = depth < length ? -1 : 1;
+
+    return result;
+}
+
+/**
+ * Retourne la liste en cache d'un noeud, cre vide s'il n'en a pas encore
+ * (NULL en cas d'erreur d'allocation).
+ */
+static tstree_index_t *tstree_cache_get( tstree_t tree, tstree_index_t index )
+{
+    /* Variables locales */
+    unsigned int   size;   /* Nouveau nombre de listes */
+    tstree_index_t *lists; /* Listes agrandies         */
+
+    /* Vrification des paramtres */
+    assert( tree );
+    assert( tree->cachesize != 0 );
+    assert( index );
+
+    /* Cration de la liste (la liste 0 n'est pas utilise) */
+    if (SLOT( tree, index ) == 0) {
+	if (tree->nlists == 0)
+	    tree->nlists = 1;
+
+	/* Agrandissement de la table des listes si ncessaire */
+	if (tree->nlists >= tree->maxlists) {
+	    size = tree->maxlists ? tree->maxlists * 2 : CACHE_LISTS;
+	    if (!(lists = realloc( tree->lists, (size_t) size *
+				   tree->cachesize *
+				   sizeof (tstree_index_t) )))
+		return NULL;
+	    tree->lists    = lists;
+	    tree->maxlists = size;
+	}
+
+	SLOT( tree, index ) = tree->nlists++;
+	memset( LIST( tree, SLOT( tree, index ) ), 0,
+		tree->cachesize * sizeof (tstree_index_t) );
+    }
+
+    return LIST( tree, SLOT( tree, index ) );
+}
+
+/**
+ * Rpercute la nouvelle frquence d'une cl sur les listes en cache de ses
+ * prfixes. En cas d'erreur d'allocation, les listes sont marques comme
+ * primes et seront reconstruites plus tard.
+ */
+static void tstree_cache_update( tstree_t tree, const char *key,
+				 unsigned int length, tstree_index_t index )
+{
+    /* Variables locales */
+    unsigned int   i;      /* Position dans la liste      */
+    unsigned int   depth;  /* Longueur du prfixe courant */
+    unsigned int   count;  /* Frquence de la cl         */
+    unsigned int   other;  /* Frquence d'une autre cl   */
+    unsigned int   size;   /* Taille des listes           */
+    tstree_index_t prefix; /* Noeud du prfixe courant    */
+    tstree_index_t *list;  /* Liste du prfixe courant    */
+
+    /* Vrification des paramtres */
+    assert( tree );
+    assert( key );
+    assert( index );
+
+    size  = tree->cachesize;
+    count = COUNT( tree, index );
+
+    /* Remonte les prfixes de la cl,  partir de la cl elle-mme */
+    for (prefix = index, depth = length; prefix;
+	 prefix = PARENT( tree, prefix ), depth--) {
+	if (tree->cachedepth != 0 && depth > tree->cachedepth)
+	    continue;
+
+	if (!(list = tstree_cache_get( tree, prefix ))) {
+	    tree->cachevalid = FALSE;
+	    return;
+	}
+
+	/* Place actuelle de la cl, ou premire place libre */
+	for (i = 0; i < size && list[i] && list[i] != index; i++)
+	    ;
+
+	/* Si la liste est pleine, la cl doit passer devant la dernire */
+	if (i == size) {
+	    other = COUNT( tree, list[size - 1] );
+	    if (other > count || (other == count &&
+				  tstree_compare_key( tree, list[size - 1],
+						      key, length ) < 0))
+		continue;
+	    i = size - 1;
+	}
+
+	/* Remonte la cl tant qu'elle doit passer devant la prcdente */
+	while (i > 0) {
+	    other = COUNT( tree, list[i - 1] );
+	    if (other > count || (other == count &&
+				  tstree_compare_key( tree, list[i - 1],
+						      key, length ) < 0))
+		break;
+	    list[i] = list[i - 1];
+	    i--;
+	}
+	list[i] = index;
+    }
+}
+
+/**
+ * Reconstruit entirement les listes en cache.
+ */
+static bool_t tstree_cache_rebuild( tstree_t tree )
+{
+    /* Variables locales */
+    unsigned int   i;      /* Compteur                    */
+    unsigned int   depth;  /* Profondeur du noeud courant */
+    unsigned int   number; /* Nombre de cls de la liste  */
+    tstree_index_t index;  /* Noeud courant               */
+    tstree_index_t parent; /* Parent du noeud courant     */
+    tstree_index_t *list;  /* Liste du noeud courant      */
+    tstree_node_t  *nodes; /* Cls les plus frquentes    */
+    tstree_t       owner;  /* Arbre des noeuds            */
+
+    /* Vrification des paramtres */
+    assert( tree );
+
+    if (tree->cachesize == 0)
+	return FALSE;
+
+    /* Oubli des anciennes listes */
+    for (i = 0; i < tree->nblocks; i++)
+	memset( tree->colds[i]->slots, 0,
+		BLOCK_NODES * sizeof (unsigned int) );
+    tree->nlists = 0;
+
+    if (!(nodes = malloc( tree->cachesize * sizeof (tstree_node_t) )))
+	return FALSE;
+
+    /* Calcul de la liste de chaque noeud assez proche de la racine (le
+     * premier emplacement de chaque bloc est son en-tte) */
+    for (index = 1; index < tree->next; index++) {
+	if ((index & BLOCK_MASK) == 0)
+	    continue;
+
+	depth = 1;
+	for (parent = PARENT( tree, index ); parent &&
+		 (tree->cachedepth == 0 || depth <= tree->cachedepth);
+	     parent = PARENT( tree, parent ))
+	    depth++;
+	if (tree->cachedepth != 0 && depth > tree->cachedepth)
+	    continue;
+
+	number = tree->cachesize;
+	if (!tstree_select( tree, index, nodes, &number ) ||
+	    !(list = tstree_cache_get( tree, index ))) {
+	    free( nodes );
+	    return FALSE;
+	}
+	for (i = 0; i < number; i++)
+	    list[i] = tstree_node_index( nodes[i], &owner );
+    }
+
+    /* Les listes sont  jour */
+    free( nodes );
+    tree->cachevalid = TRUE;
+    return TRUE;
+}
+
+/**
+ * Double la taille de la pile de parcours.
+ */
+static bool_t tstree_stack_grow( tstree_stack_t stack )
+{
+    /* Variables locales */
+    tstree_frame_t frames; /* Nouveaux lments */
+
+    /* Vrification des paramtres */
+    assert( stack );
+
+    /* Allocation de la nouvelle pile */
+    if (stack->frames == stack->local) {
+	if (!(frames = malloc( 2 * stack->size * sizeof (tstree_frame_s_t) )))
+	    return FALSE;
+	memcpy( frames, stack->local,
+		stack->size * sizeof (tstree_frame_s_t) );
+    } else if (!(frames = realloc( stack->frames, 2 * stack->size *
+				   sizeof (tstree_frame_s_t) )))
 	return FALSE;
 
+    /* Mise  jour de la pile */
+    stack->frames = frames;
+    stack->size  *= 2;
+
     /* Pas d'erreur */
     return TRUE;
 }
@@ -50,21 +50,57 @@ extern "C"
 
 
 /* Types de donnes */
-typedef struct tstree      *tstree_t;      /* Objet arbre          */
-typedef struct tstree_node *tstree_node_t; /* Noeud de l'arbre     */
-                                           /* Fonction de callback */
-typedef bool_t            (*tstree_callback_t)( const tstree_node_t node,
-						void *data );
+typedef struct tstree        *tstree_t;        /* Objet arbre          */
+typedef struct tstree_node   *tstree_node_t;   /* Noeud de l'arbre     */
+typedef struct tstree_cursor *tstree_cursor_t; /* Curseur de parcours  */
+typedef struct tstree_inserter *tstree_inserter_t; /* Insertion trie */
+                                               /* Fonction de callback */
+typedef bool_t              (*tstree_callback_t)( const tstree_node_t node,
+						  void *data );
 
 /* Prototypes des fonctions externes */
 tstree_t      tstree_new( void );
 void          tstree_delete( tstree_t tree );
+tstree_t      tstree_clone( const tstree_t tree );
 tstree_node_t tstree_get_root( const tstree_t tree );
 unsigned int  tstree_get_depth( const tstree_t tree );
 unsigned int  tstree_get_key_number( const tstree_t tree );
+unsigned int  tstree_get_node_number( const tstree_t tree );
+void          tstree_get_memory_usage( const tstree_t tree,
+				       unsigned long *reserved,
+				       unsigned long *used );
+bool_t        tstree_set_cache( tstree_t tree, unsigned int size,
+				unsigned int depth );
+void          tstree_invalidate_cache( tstree_t tree );
+bool_t        tstree_update_cache( tstree_t tree );
+void          tstree_get_cache_memory_usage( const tstree_t tree,
+					     unsigned long *reserved,
+					     unsigned long *used );
 tstree_node_t tstree_add_key( tstree_t tree, const char *key );
+tstree_node_t tstree_add_key_count( tstree_t tree, const char *key,
+				    unsigned int number );
+bool_t        tstree_build_from_sorted( tstree_t tree,
+					char *const *keys,
+					const unsigned int *counts,
+					unsigned int number,
+					bool_t weighted );
+bool_t        tstree_merge( tstree_t tree, const tstree_t other );
+bool_t        tstree_rebalance( tstree_t tree );
+/* Le compactage dplace tous les noeuds : les noeuds obtenus auparavant et
+ * les curseurs en cours deviennent invalides */
+bool_t        tstree_compact( tstree_t tree );
+void          tstree_set_rebalance( tstree_t tree, unsigned int interval );
+void          tstree_suspend_rebalance( tstree_t tree );
+bool_t        tstree_resume_rebalance( tstree_t tree );
+void          tstree_set_direct( tstree_t tree, bool_t enabled );
+bool_t        tstree_set_wide( tstree_t tree, unsigned int threshold );
+bool_t        tstree_get_balance( const tstree_t tree, double *average,
+				  unsigned int *maximum );
 bool_t        tstree_get_keys( const tstree_t tree, const char *key,
 			       tstree_callback_t callback, void *data );
+bool_t        tstree_get_most_used( const tstree_t tree, const char *key,
+				    tstree_node_t *nodes,
+				    unsigned int *number );
 
 char         *tstree_node_get_key( const tstree_node_t node );
 bool_t        tstree_node_get_key_in_buffer( const tstree_node_t node,
@@ -73,6 +109,22 @@ bool_t        tstree_node_get_key_in_buffer( const tstree_node_t node,
 unsigned int  tstree_node_get_depth( const tstree_node_t node );
 unsigned int  tstree_node_get_count( const tstree_node_t node );
 
+tstree_cursor_t tstree_cursor_new( const tstree_t tree, const char *key );
+void            tstree_cursor_delete( tstree_cursor_t cursor );
+tstree_node_t   tstree_cursor_next( tstree_cursor_t cursor );
+bool_t          tstree_cursor_has_failed( const tstree_cursor_t cursor );
+
+tstree_inserter_t tstree_inserter_new( tstree_t tree );
+void              tstree_inserter_delete( tstree_inserter_t inserter );
+tstree_node_t     tstree_inserter_add( tstree_inserter_t inserter,
+				       const char *key, unsigned int shared,
+				       unsigned int number );
+
+bool_t        tstree_begin_concurrent( tstree_t tree );
+tstree_node_t tstree_add_key_concurrent( tstree_t tree, const char *key,
+					 unsigned int number );
+void          tstree_end_concurrent( tstree_t tree );
+
 
 /* Traitement spcial si utilisation dans un programme C++ (fin) */
 #ifdef __cplusplus